@@ -0,0 +1,126 @@
+#pragma once
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dxgi1_4.h>
+
+#include "com.h"
+
+/**
+  * \brief Video memory timeline
+  *
+  * Samples local and non-local memory usage and budget
+  * via IDXGIAdapter3::QueryVideoMemoryInfo at labeled
+  * points, so that allocations made by a test can be
+  * attributed to individual API calls.
+  */
+class MemoryTimeline {
+
+public:
+
+  MemoryTimeline() { }
+
+  MemoryTimeline(IUnknown* device) {
+    Com<IDXGIDevice> dxgiDevice;
+    Com<IDXGIAdapter> adapter;
+
+    if (FAILED(device->QueryInterface(IID_PPV_ARGS(&dxgiDevice)))
+     || FAILED(dxgiDevice->GetAdapter(&adapter))
+     || FAILED(adapter->QueryInterface(IID_PPV_ARGS(&m_adapter)))) {
+      std::cerr << "IDXGIAdapter3 not supported, memory info unavailable" << std::endl;
+      m_adapter = nullptr;
+    }
+  }
+
+  bool isAvailable() const {
+    return m_adapter != nullptr;
+  }
+
+  /**
+    * \brief Queries current memory info
+    *
+    * \param [out] local Local segment group info
+    * \param [out] nonLocal Non-local segment group info
+    * \returns \c true on success
+    */
+  bool query(DXGI_QUERY_VIDEO_MEMORY_INFO& local, DXGI_QUERY_VIDEO_MEMORY_INFO& nonLocal) const {
+    return m_adapter
+      && SUCCEEDED(m_adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &local))
+      && SUCCEEDED(m_adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL, &nonLocal));
+  }
+
+  /**
+    * \brief Records current memory info
+    * \param [in] label Name of the sample
+    */
+  void sample(const std::string& label) {
+    if (!m_adapter)
+      return;
+
+    Entry entry;
+    entry.label = label;
+
+    if (!query(entry.local, entry.nonLocal))
+      return;
+
+    m_entries.push_back(entry);
+  }
+
+  /**
+    * \brief Prints all samples
+    *
+    * Shows committed memory and budget per segment
+    * group in MiB, as well as the change in local
+    * memory usage relative to the previous sample.
+    */
+  void print(std::ostream& stream) const {
+    if (!m_adapter)
+      return;
+
+    stream << std::dec << std::fixed << std::setprecision(1)
+           << "Memory timeline (MiB):" << std::endl
+           << "  " << std::left << std::setw(LabelWidth) << "Event" << std::right
+           << std::setw(10) << "Local" << std::setw(10) << "Delta" << std::setw(10) << "Budget"
+           << std::setw(10) << "Sysmem" << std::setw(10) << "Budget" << std::endl;
+
+    for (size_t i = 0; i < m_entries.size(); i++) {
+      const auto& e = m_entries[i];
+
+      double delta = i ? toMiB(e.local.CurrentUsage) - toMiB(m_entries[i - 1].local.CurrentUsage) : 0.0;
+
+      stream << "  " << std::left << std::setw(LabelWidth) << e.label << std::right
+             << std::setw(10) << toMiB(e.local.CurrentUsage)
+             << std::setw(10) << std::showpos << delta << std::noshowpos
+             << std::setw(10) << toMiB(e.local.Budget)
+             << std::setw(10) << toMiB(e.nonLocal.CurrentUsage)
+             << std::setw(10) << toMiB(e.nonLocal.Budget) << std::endl;
+    }
+
+    stream << std::defaultfloat;
+  }
+
+  void clear() {
+    m_entries.clear();
+  }
+
+private:
+
+  constexpr static int LabelWidth = 32;
+
+  struct Entry {
+    std::string                   label;
+    DXGI_QUERY_VIDEO_MEMORY_INFO  local     = { };
+    DXGI_QUERY_VIDEO_MEMORY_INFO  nonLocal  = { };
+  };
+
+  Com<IDXGIAdapter3>  m_adapter;
+  std::vector<Entry>  m_entries;
+
+  static double toMiB(UINT64 bytes) {
+    return double(bytes) / double(1u << 20);
+  }
+
+};
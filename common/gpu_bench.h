@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+#include <d3d11.h>
+
+#include "gpu_timer.h"
+#include "timer.h"
+
+/**
+  * \brief Waits for all submitted work to complete
+  *
+  * Ends an event query and spins on it, so that thread
+  * wake-up latency does not show up in timings.
+  * \param [in] context Context to flush and wait for
+  * \param [in] query Event query used for the wait
+  */
+inline void waitForIdle(ID3D11DeviceContext* context, ID3D11Query* query) {
+  context->End(query);
+  context->Flush();
+
+  while (context->GetData(query, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+    continue;
+}
+
+
+struct GpuBenchResult {
+  double  callsPerSecond  = 0.0;
+  double  gpuMs           = 0.0;
+};
+
+
+/**
+  * \brief Measures throughput and GPU time of a workload
+  *
+  * Runs the workload a few times to warm up, then measures
+  * throughput on the CPU without timestamp queries in the
+  * way. Each call is then timed individually on the GPU,
+  * the reported GPU time is the median.
+  * \param [in] device Device to create queries on
+  * \param [in] context Context the workload is submitted to
+  * \param [in] query Event query used to wait for idle
+  * \param [in] warmupCount Number of warmup calls
+  * \param [in] measuredCount Number of measured calls
+  * \param [in] submit Submits one call, takes the call index
+  * \returns Calls per second and median GPU time per call
+  */
+template<typename Fn>
+GpuBenchResult measureGpuWork(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11Query* query,
+    uint32_t warmupCount, uint32_t measuredCount, const Fn& submit) {
+  GpuBenchResult result;
+
+  for (uint32_t i = 0; i < warmupCount; i++)
+    submit(i);
+
+  waitForIdle(context, query);
+
+  Timer timer;
+
+  for (uint32_t i = 0; i < measuredCount; i++)
+    submit(i);
+
+  waitForIdle(context, query);
+  result.callsPerSecond = double(measuredCount) / (timer.ms() / 1000.0);
+
+  GpuTimer gpuTimer(device);
+
+  for (uint32_t i = 0; i < measuredCount; i++) {
+    gpuTimer.begin(context);
+    submit(i);
+    gpuTimer.end(context);
+  }
+
+  gpuTimer.resolve(context, true);
+
+  result.gpuMs = gpuTimer.stats().percentile(50.0);
+  return result;
+}
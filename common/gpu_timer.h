@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+
+#include <d3d11.h>
+
+#include "com.h"
+#include "timer.h"
+
+/**
+  * \brief GPU timer for D3D11 contexts
+  *
+  * Uses a small ring of timestamp queries so that
+  * results can be read back without stalling the
+  * pipeline every frame. Measured GPU times are
+  * added to a \ref Stats object in milliseconds.
+  */
+class GpuTimer {
+  constexpr static uint32_t QueryCount = 8;
+public:
+
+  GpuTimer(ID3D11Device* device) {
+    D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT };
+    D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP };
+
+    for (auto& q : m_queries) {
+      if (FAILED(device->CreateQuery(&disjointDesc, &q.disjoint))
+       || FAILED(device->CreateQuery(&timestampDesc, &q.start))
+       || FAILED(device->CreateQuery(&timestampDesc, &q.end)))
+        return;
+    }
+
+    m_valid = true;
+  }
+
+  /**
+    * \brief Begins a timed section
+    *
+    * Waits for the oldest pending result
+    * if all queries are currently in use.
+    */
+  void begin(ID3D11DeviceContext* context) {
+    if (!m_valid)
+      return;
+
+    if (m_pending == QueryCount)
+      resolve(context, true, 1);
+
+    auto& q = m_queries[m_next];
+    context->Begin(q.disjoint.ptr());
+    context->End(q.start.ptr());
+  }
+
+  /**
+    * \brief Ends a timed section
+    */
+  void end(ID3D11DeviceContext* context) {
+    if (!m_valid)
+      return;
+
+    auto& q = m_queries[m_next];
+    context->End(q.end.ptr());
+    context->End(q.disjoint.ptr());
+
+    m_next = (m_next + 1) % QueryCount;
+    m_pending += 1;
+  }
+
+  /**
+    * \brief Reads back available results
+    *
+    * \param [in] context Context to query
+    * \param [in] wait Whether to wait for results
+    * \param [in] maxCount Maximum number of results to read
+    */
+  void resolve(ID3D11DeviceContext* context, bool wait, uint32_t maxCount = QueryCount) {
+    while (m_pending && maxCount) {
+      auto& q = m_queries[(m_next + QueryCount - m_pending) % QueryCount];
+
+      D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = { };
+      UINT64 start = 0;
+      UINT64 end = 0;
+
+      UINT flags = wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH;
+
+      while (context->GetData(q.disjoint.ptr(), &disjoint, sizeof(disjoint), flags) != S_OK) {
+        if (!wait)
+          return;
+      }
+
+      context->GetData(q.start.ptr(), &start, sizeof(start), 0);
+      context->GetData(q.end.ptr(), &end, sizeof(end), 0);
+
+      if (!disjoint.Disjoint && disjoint.Frequency)
+        m_stats.add(double(end - start) * 1000.0 / double(disjoint.Frequency));
+
+      m_pending -= 1;
+      maxCount -= 1;
+    }
+  }
+
+  Stats& stats() {
+    return m_stats;
+  }
+
+private:
+
+  struct QuerySet {
+    Com<ID3D11Query> disjoint;
+    Com<ID3D11Query> start;
+    Com<ID3D11Query> end;
+  };
+
+  std::array<QuerySet, QueryCount> m_queries;
+
+  uint32_t m_next    = 0;
+  uint32_t m_pending = 0;
+  bool     m_valid   = false;
+
+  Stats    m_stats;
+
+};
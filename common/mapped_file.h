@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+  * \brief Read-only memory-mapped file
+  *
+  * Maps a sliding window of the file rather than the whole
+  * file, so that files larger than the address space can
+  * be streamed on 32-bit builds. Pointers returned by
+  * \ref map are valid until the next call to \ref map.
+  */
+class MappedFile {
+  constexpr static size_t MinViewSize = 64u << 20;
+public:
+
+  MappedFile() { }
+
+  explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+    m_file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (m_file == INVALID_HANDLE_VALUE) {
+      m_file = nullptr;
+      return;
+    }
+
+    LARGE_INTEGER size = { };
+
+    if (!::GetFileSizeEx(m_file, &size) || !size.QuadPart)
+      return;
+
+    m_mapping = ::CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (!m_mapping)
+      return;
+
+    SYSTEM_INFO info = { };
+    ::GetSystemInfo(&info);
+
+    m_size = uint64_t(size.QuadPart);
+    m_granularity = info.dwAllocationGranularity;
+#else
+    m_fd = ::open(path.c_str(), O_RDONLY);
+
+    if (m_fd < 0)
+      return;
+
+    struct stat st = { };
+
+    if (::fstat(m_fd, &st) || !st.st_size)
+      return;
+
+    m_size = uint64_t(st.st_size);
+    m_granularity = uint64_t(::sysconf(_SC_PAGESIZE));
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator = (const MappedFile&) = delete;
+
+  ~MappedFile() {
+    unmap();
+
+#ifdef _WIN32
+    if (m_mapping)
+      ::CloseHandle(m_mapping);
+
+    if (m_file)
+      ::CloseHandle(m_file);
+#else
+    if (m_fd >= 0)
+      ::close(m_fd);
+#endif
+  }
+
+  bool valid() const {
+    return m_size != 0;
+  }
+
+  uint64_t size() const {
+    return m_size;
+  }
+
+  /**
+    * \brief Maps a range of the file
+    *
+    * Reuses the current view if it already contains
+    * the requested range, and otherwise replaces it.
+    * \param [in] offset Offset of the range, in bytes
+    * \param [in] size Size of the range, in bytes
+    * \returns Pointer to the range, or \c nullptr
+    */
+  const uint8_t* map(uint64_t offset, size_t size) {
+    if (!valid() || offset + size > m_size)
+      return nullptr;
+
+    if (m_view && offset >= m_viewOffset && offset + size <= m_viewOffset + m_viewSize)
+      return m_view + (offset - m_viewOffset);
+
+    unmap();
+
+    uint64_t viewOffset = offset - offset % m_granularity;
+    uint64_t viewSize = std::min<uint64_t>(
+      std::max<uint64_t>(offset + size - viewOffset, MinViewSize),
+      m_size - viewOffset);
+
+#ifdef _WIN32
+    void* view = ::MapViewOfFile(m_mapping, FILE_MAP_READ,
+      DWORD(viewOffset >> 32), DWORD(viewOffset), SIZE_T(viewSize));
+
+    if (!view)
+      return nullptr;
+#else
+    void* view = ::mmap(nullptr, size_t(viewSize), PROT_READ, MAP_SHARED, m_fd, off_t(viewOffset));
+
+    if (view == MAP_FAILED)
+      return nullptr;
+
+    ::madvise(view, size_t(viewSize), MADV_SEQUENTIAL);
+#endif
+
+    m_view = reinterpret_cast<const uint8_t*>(view);
+    m_viewOffset = viewOffset;
+    m_viewSize = size_t(viewSize);
+    return m_view + (offset - m_viewOffset);
+  }
+
+private:
+
+#ifdef _WIN32
+  HANDLE          m_file        = nullptr;
+  HANDLE          m_mapping     = nullptr;
+#else
+  int             m_fd          = -1;
+#endif
+
+  uint64_t        m_size        = 0;
+  uint64_t        m_granularity = 1;
+
+  const uint8_t*  m_view        = nullptr;
+  uint64_t        m_viewOffset  = 0;
+  size_t          m_viewSize    = 0;
+
+  void unmap() {
+    if (!m_view)
+      return;
+
+#ifdef _WIN32
+    ::UnmapViewOfFile(m_view);
+#else
+    ::munmap(const_cast<uint8_t*>(m_view), m_viewSize);
+#endif
+
+    m_view = nullptr;
+  }
+
+};
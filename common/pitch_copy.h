@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PITCH_COPY_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define PITCH_COPY_HAS_SSE2 0
+#endif
+
+enum class PitchCopyMethod : uint32_t {
+  Memcpy,
+  Streaming,
+};
+
+/**
+  * \brief Copies a single row with non-temporal stores
+  *
+  * Stores bypass the cache, which avoids reading the
+  * destination before writing it and keeps the source
+  * resident. Bytes before the first 16-byte boundary of
+  * the destination and after the last one are copied
+  * with regular stores.
+  */
+inline void streamRow(uint8_t* dst, const uint8_t* src, size_t size) {
+#if PITCH_COPY_HAS_SSE2
+  size_t head = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15;
+
+  if (head > size)
+    head = size;
+
+  std::memcpy(dst, src, head);
+
+  size_t i = head;
+
+  for (; i + 64 <= size; i += 64) {
+    __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i +  0));
+    __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+    __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+    __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i +  0), v0);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 16), v1);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 32), v2);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 48), v3);
+  }
+
+  for (; i + 16 <= size; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), v);
+  }
+
+  std::memcpy(dst + i, src + i, size - i);
+#else
+  std::memcpy(dst, src, size);
+#endif
+}
+
+/**
+  * \brief Copies rows between images with different pitches
+  *
+  * Streaming copies are meant for destinations that are not
+  * read back soon, such as mapped GPU resources, which are
+  * often write-combined. A fence after the last row makes
+  * the data visible before the caller unmaps the resource.
+  * \param [in] method Copy method
+  * \param [in] dst Destination pointer
+  * \param [in] dstPitch Destination row pitch
+  * \param [in] src Source pointer
+  * \param [in] srcPitch Source row pitch
+  * \param [in] rowSize Number of bytes to copy per row
+  * \param [in] rowCount Number of rows
+  */
+inline void copyPitchedRows(PitchCopyMethod method, void* dst, size_t dstPitch,
+    const void* src, size_t srcPitch, size_t rowSize, size_t rowCount) {
+  auto dstBytes = reinterpret_cast<uint8_t*>(dst);
+  auto srcBytes = reinterpret_cast<const uint8_t*>(src);
+
+  if (method == PitchCopyMethod::Memcpy) {
+    if (dstPitch == rowSize && srcPitch == rowSize) {
+      std::memcpy(dstBytes, srcBytes, rowSize * rowCount);
+      return;
+    }
+
+    for (size_t i = 0; i < rowCount; i++)
+      std::memcpy(&dstBytes[i * dstPitch], &srcBytes[i * srcPitch], rowSize);
+
+    return;
+  }
+
+  for (size_t i = 0; i < rowCount; i++)
+    streamRow(&dstBytes[i * dstPitch], &srcBytes[i * srcPitch], rowSize);
+
+#if PITCH_COPY_HAS_SSE2
+  _mm_sfence();
+#endif
+}
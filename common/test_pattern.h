@@ -0,0 +1,442 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "thread.h"
+#include "yuv_convert.h"
+
+namespace pattern {
+
+  enum class Type : uint32_t {
+    ColorBars,
+    Gradient,
+    ZonePlate,
+    Noise,
+  };
+
+  enum class Format : uint32_t {
+    RGBA,
+    BGRA,
+    NV12,
+    YUY2,
+    P010,
+  };
+
+  /**
+    * \brief Generator arguments
+    *
+    * YUV formats use the same layout as \ref yuv::convert,
+    * i.e. the chroma plane of planar formats immediately
+    * follows the luma plane. Output only depends on the
+    * arguments, not on the kernel or thread count used.
+    */
+  struct GenerateArgs {
+    Type        type        = Type::ColorBars;
+    Format      format      = Format::RGBA;
+    yuv::Matrix matrix      = yuv::Matrix::BT709;
+    yuv::Range  range       = yuv::Range::Limited;
+    uint32_t    width       = 0;
+    uint32_t    height      = 0;
+    uint32_t    seed        = 0;
+    void*       dst         = nullptr;
+    size_t      dstPitch    = 0;
+    yuv::Kernel kernel      = yuv::Kernel::Auto;
+    uint32_t    threadCount = 0;
+  };
+
+  inline bool isYuv(Format format) {
+    return format != Format::RGBA && format != Format::BGRA;
+  }
+
+  inline yuv::Format getYuvFormat(Format format) {
+    switch (format) {
+      case Format::YUY2: return yuv::Format::YUY2;
+      case Format::P010: return yuv::Format::P010;
+      default:           return yuv::Format::NV12;
+    }
+  }
+
+  /**
+    * \brief Minimum row pitch for the given format
+    */
+  inline size_t getMinPitch(Format format, uint32_t width) {
+    return isYuv(format)
+      ? yuv::getMinPitch(getYuvFormat(format), width)
+      : 4 * size_t(width);
+  }
+
+  /**
+    * \brief Total image size, including the chroma plane
+    */
+  inline size_t getImageSize(Format format, uint32_t height, size_t pitch) {
+    return isYuv(format)
+      ? yuv::getImageSize(getYuvFormat(format), height, pitch)
+      : pitch * height;
+  }
+
+  /**
+    * \brief Parses a pattern name
+    *
+    * \param [in] name One of \c bars, \c gradient, \c zoneplate or \c noise
+    * \param [out] type Pattern type
+    * \returns \c true on success
+    */
+  inline bool parseType(const std::string& name, Type& type) {
+    static const std::array<const char*, 4> s_names = {{ "bars", "gradient", "zoneplate", "noise" }};
+
+    for (uint32_t i = 0; i < s_names.size(); i++) {
+      if (name == s_names[i]) {
+        type = Type(i);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  /**
+    * \brief Pattern description for command lines
+    */
+  struct PatternDesc {
+    Type     type   = Type::ColorBars;
+    uint32_t width  = 0;
+    uint32_t height = 0;
+
+    /**
+      * \brief Parses pattern and size arguments
+      *
+      * \param [in] typeArg Pattern name, see \ref parseType
+      * \param [in] sizeArg Image size, e.g. \c 7680x4320
+      * \returns \c true on success
+      */
+    bool parse(const std::string& typeArg, const std::string& sizeArg) {
+      if (!parseType(typeArg, type))
+        return false;
+
+      std::stringstream stream(sizeArg);
+      char separator = '\0';
+
+      if (!(stream >> width >> separator >> height) || separator != 'x')
+        return false;
+
+      // Keep chroma blocks whole for all YUV formats
+      return width && height && !(width & 1) && !(height & 1);
+    }
+  };
+
+
+  // Branchless so that row loops can be vectorized by the compiler
+  inline uint32_t packPixel(uint32_t r, uint32_t g, uint32_t b, yuv::RgbOrder order) {
+    uint32_t rShift = order == yuv::RgbOrder::RGBA ? 0 : 16;
+    return (r << rShift) | (g << 8) | (b << (16 - rShift)) | 0xFF000000u;
+  }
+
+  /**
+    * \brief Integer hash used for noise
+    *
+    * Good avalanche behaviour with only shifts, xors and
+    * multiplies, which makes it easy to vectorize.
+    */
+  inline uint32_t hash(uint32_t v) {
+    v ^= v >> 16;
+    v *= 0x7feb352du;
+    v ^= v >> 15;
+    v *= 0x846ca68bu;
+    v ^= v >> 16;
+    return v;
+  }
+
+  inline uint32_t getNoiseRowKey(uint32_t seed, uint32_t y) {
+    return hash(y + seed * 0x9e3779b9u);
+  }
+
+
+  namespace scalar {
+
+    inline uint32_t noise(uint32_t rowKey, uint32_t x, uint32_t count, uint32_t* dst) {
+      for (uint32_t i = 0; i < count; i++)
+        dst[i] = hash(rowKey + x + i) | 0xFF000000u;
+
+      return count;
+    }
+
+  }
+
+#if YUV_HAS_X86
+  namespace sse2 {
+
+    inline __m128i mullo32(__m128i a, __m128i b) {
+      __m128i even = _mm_mul_epu32(a, b);
+      __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+      return _mm_unpacklo_epi32(
+        _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+        _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+
+    inline uint32_t noise(uint32_t rowKey, uint32_t x, uint32_t count, uint32_t* dst) {
+      const __m128i k0 = _mm_set1_epi32(int32_t(0x7feb352du));
+      const __m128i k1 = _mm_set1_epi32(int32_t(0x846ca68bu));
+      const __m128i alpha = _mm_set1_epi32(int32_t(0xFF000000u));
+      const __m128i step = _mm_set1_epi32(4);
+
+      __m128i v = _mm_add_epi32(_mm_set1_epi32(int32_t(rowKey + x)), _mm_setr_epi32(0, 1, 2, 3));
+
+      uint32_t i = 0;
+
+      for (; i + 4 <= count; i += 4) {
+        __m128i h = _mm_xor_si128(v, _mm_srli_epi32(v, 16));
+        h = mullo32(h, k0);
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+        h = mullo32(h, k1);
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), _mm_or_si128(h, alpha));
+        v = _mm_add_epi32(v, step);
+      }
+
+      return i;
+    }
+
+  }
+
+  namespace avx2 {
+
+    YUV_TARGET_AVX2 inline uint32_t noise(uint32_t rowKey, uint32_t x, uint32_t count, uint32_t* dst) {
+      const __m256i k0 = _mm256_set1_epi32(int32_t(0x7feb352du));
+      const __m256i k1 = _mm256_set1_epi32(int32_t(0x846ca68bu));
+      const __m256i alpha = _mm256_set1_epi32(int32_t(0xFF000000u));
+      const __m256i step = _mm256_set1_epi32(8);
+
+      __m256i v = _mm256_add_epi32(_mm256_set1_epi32(int32_t(rowKey + x)),
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+      uint32_t i = 0;
+
+      for (; i + 8 <= count; i += 8) {
+        __m256i h = _mm256_xor_si256(v, _mm256_srli_epi32(v, 16));
+        h = _mm256_mullo_epi32(h, k0);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        h = _mm256_mullo_epi32(h, k1);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dst[i]), _mm256_or_si256(h, alpha));
+        v = _mm256_add_epi32(v, step);
+      }
+
+      return i;
+    }
+
+  }
+#endif
+
+  using NoiseKernel = uint32_t (*)(uint32_t, uint32_t, uint32_t, uint32_t*);
+
+  inline NoiseKernel getNoiseKernel(yuv::Kernel kernel) {
+    if (kernel == yuv::Kernel::Auto)
+      kernel = yuv::getBestKernel();
+
+    switch (kernel) {
+#if YUV_HAS_X86
+      case yuv::Kernel::SSE2: return &sse2::noise;
+      case yuv::Kernel::AVX2: return &avx2::noise;
+#endif
+      default: return &scalar::noise;
+    }
+  }
+
+
+  /**
+    * \brief Cosine table for zone plates
+    *
+    * One full period, scaled to the 8-bit range.
+    */
+  inline const std::array<uint8_t, 1024>& getCosineTable() {
+    static const std::array<uint8_t, 1024> s_table = [] {
+      std::array<uint8_t, 1024> table = { };
+
+      for (uint32_t i = 0; i < table.size(); i++) {
+        double phase = 2.0 * 3.14159265358979323846 * double(i) / double(table.size());
+        table[i] = uint8_t(std::lround(127.5 + 127.5 * std::cos(phase)));
+      }
+
+      return table;
+    }();
+
+    return s_table;
+  }
+
+  /**
+    * \brief Generates a single row of RGB pixels
+    *
+    * Color bars are 75% bars over a full-range gray ramp.
+    * The zone plate is centered, and its frequency reaches
+    * Nyquist at the middle of the longer image edge.
+    */
+  inline void generateRow(const GenerateArgs& args, yuv::RgbOrder order,
+      NoiseKernel noiseKernel, uint32_t y, uint32_t* dst) {
+    uint32_t width = args.width;
+
+    switch (args.type) {
+      case Type::ColorBars: {
+        static const std::array<std::array<uint32_t, 3>, 8> s_bars = {{
+          {{ 191, 191, 191 }}, {{ 191, 191,   0 }}, {{   0, 191, 191 }}, {{   0, 191,   0 }},
+          {{ 191,   0, 191 }}, {{ 191,   0,   0 }}, {{   0,   0, 191 }}, {{   0,   0,   0 }},
+        }};
+
+        if (y < (args.height * 3) / 4) {
+          for (uint32_t i = 0; i < s_bars.size(); i++) {
+            uint32_t x0 = (width * i) / s_bars.size();
+            uint32_t x1 = (width * (i + 1)) / s_bars.size();
+
+            std::fill(dst + x0, dst + x1, packPixel(s_bars[i][0], s_bars[i][1], s_bars[i][2], order));
+          }
+        } else {
+          uint32_t step = (255u << 16) / std::max(width - 1, 1u);
+
+          for (uint32_t x = 0; x < width; x++) {
+            uint32_t v = (x * step + 0x8000) >> 16;
+            dst[x] = packPixel(v, v, v, order);
+          }
+        }
+      } break;
+
+      case Type::Gradient: {
+        uint32_t step = (255u << 16) / std::max(width - 1, 1u);
+        uint32_t g = (y * 255u) / std::max(args.height - 1, 1u);
+
+        for (uint32_t x = 0; x < width; x++) {
+          uint32_t r = (x * step + 0x8000) >> 16;
+          dst[x] = packPixel(r, g, 255 - r, order);
+        }
+      } break;
+
+      case Type::ZonePlate: {
+        // Coordinates are doubled so that the center can sit between
+        // pixels. With r measured in pixels and R being half the
+        // longer edge, the phase in table entries is 256 * r^2 / R,
+        // or 64 * d^2 / R in terms of doubled coordinates.
+        const auto& table = getCosineTable();
+
+        uint64_t radius = std::max(std::max(width, args.height) / 2, 1u);
+        uint64_t step = (uint64_t(64) << 32) / radius;
+
+        int64_t dy = 2 * int64_t(y) + 1 - int64_t(args.height);
+
+        for (uint32_t x = 0; x < width; x++) {
+          int64_t dx = 2 * int64_t(x) + 1 - int64_t(width);
+          uint64_t d2 = uint64_t(dx * dx + dy * dy);
+
+          uint32_t v = table[uint32_t((d2 * step) >> 32) & 1023];
+          dst[x] = packPixel(v, v, v, order);
+        }
+      } break;
+
+      case Type::Noise: {
+        // Channel order is irrelevant for random data
+        uint32_t rowKey = getNoiseRowKey(args.seed, y);
+        uint32_t done = noiseKernel(rowKey, 0, width, dst);
+        scalar::noise(rowKey, done, width - done, dst + done);
+      } break;
+    }
+  }
+
+  /**
+    * \brief Generates a range of rows
+    *
+    * For YUV formats, rows are generated in small batches
+    * into a scratch buffer that stays in cache, and then
+    * converted. \c rowBegin must be even for those.
+    */
+  inline void generateRows(const GenerateArgs& args, uint32_t rowBegin, uint32_t rowEnd) {
+    constexpr uint32_t BatchRows = 16;
+
+    NoiseKernel noiseKernel = getNoiseKernel(args.kernel);
+    auto dstBytes = reinterpret_cast<uint8_t*>(args.dst);
+
+    if (!isYuv(args.format)) {
+      auto order = args.format == Format::BGRA ? yuv::RgbOrder::BGRA : yuv::RgbOrder::RGBA;
+
+      for (uint32_t y = rowBegin; y < rowEnd; y++)
+        generateRow(args, order, noiseKernel, y, reinterpret_cast<uint32_t*>(dstBytes + y * args.dstPitch));
+
+      return;
+    }
+
+    yuv::Format yuvFormat = getYuvFormat(args.format);
+    std::vector<uint32_t> scratch(size_t(args.width) * BatchRows);
+
+    for (uint32_t batch = rowBegin; batch < rowEnd; batch += BatchRows) {
+      uint32_t batchRows = std::min(BatchRows, rowEnd - batch);
+
+      for (uint32_t i = 0; i < batchRows; i++)
+        generateRow(args, yuv::RgbOrder::RGBA, noiseKernel, batch + i, &scratch[size_t(args.width) * i]);
+
+      yuv::ConvertArgs convertArgs;
+      convertArgs.format = yuvFormat;
+      convertArgs.matrix = args.matrix;
+      convertArgs.range = args.range;
+      convertArgs.rgbOrder = yuv::RgbOrder::RGBA;
+      convertArgs.width = args.width;
+      convertArgs.height = batchRows;
+      convertArgs.src = scratch.data();
+      convertArgs.srcPitch = 4 * size_t(args.width);
+      convertArgs.dst = dstBytes + batch * args.dstPitch;
+      convertArgs.dstPitch = args.dstPitch;
+      convertArgs.kernel = args.kernel;
+      convertArgs.threadCount = 1;
+
+      if (yuv::isSubsampledY(yuvFormat))
+        convertArgs.dstChroma = dstBytes + args.height * args.dstPitch + (batch / 2) * args.dstPitch;
+
+      yuv::convert(convertArgs);
+    }
+  }
+
+  /**
+    * \brief Generates a test pattern
+    *
+    * Rows are distributed across threads in the same
+    * way as \ref yuv::convert does.
+    */
+  inline void generate(const GenerateArgs& args) {
+    if (!args.width || !args.height)
+      return;
+
+    // Keep thread boundaries on even rows so that no thread
+    // has to generate rows belonging to another's chroma
+    constexpr uint32_t MinRowsPerThread = 32;
+
+    uint32_t threadCount = args.threadCount ? args.threadCount : Thread::hardwareConcurrency();
+    threadCount = std::max(1u, std::min(threadCount, args.height / MinRowsPerThread));
+
+    if (threadCount == 1) {
+      generateRows(args, 0, args.height);
+      return;
+    }
+
+    uint32_t pairCount = (args.height + 1) / 2;
+    std::vector<Thread> threads;
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+      uint32_t rowBegin = 2 * ((pairCount * i) / threadCount);
+      uint32_t rowEnd = std::min(2 * ((pairCount * (i + 1)) / threadCount), args.height);
+
+      threads.emplace_back([&args, rowBegin, rowEnd] {
+        generateRows(args, rowBegin, rowEnd);
+      });
+    }
+
+    for (auto& t : threads)
+      t.join();
+  }
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <thread>
+#endif
+
+/**
+  * \brief Simple thread wrapper
+  *
+  * MinGW builds using the win32 thread model do not
+  * provide \c std::thread, so use native threads on
+  * Windows. The thread is joined on destruction.
+  */
+class Thread {
+
+public:
+
+  using Proc = std::function<void()>;
+
+  Thread() { }
+
+  explicit Thread(Proc&& proc)
+  : m_proc(std::make_unique<Proc>(std::move(proc))) {
+#ifdef _WIN32
+    m_handle = ::CreateThread(nullptr, 0, threadProc, m_proc.get(), 0, nullptr);
+#else
+    m_thread = std::thread(*m_proc);
+#endif
+  }
+
+  Thread(Thread&& other) {
+    *this = std::move(other);
+  }
+
+  Thread& operator = (Thread&& other) {
+    join();
+#ifdef _WIN32
+    m_handle = other.m_handle;
+    other.m_handle = nullptr;
+#else
+    m_thread = std::move(other.m_thread);
+#endif
+    m_proc = std::move(other.m_proc);
+    return *this;
+  }
+
+  ~Thread() {
+    join();
+  }
+
+  void join() {
+#ifdef _WIN32
+    if (m_handle) {
+      ::WaitForSingleObject(m_handle, INFINITE);
+      ::CloseHandle(m_handle);
+      m_handle = nullptr;
+    }
+#else
+    if (m_thread.joinable())
+      m_thread.join();
+#endif
+  }
+
+  static uint32_t hardwareConcurrency() {
+#ifdef _WIN32
+    SYSTEM_INFO info = { };
+    ::GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    uint32_t count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+#endif
+  }
+
+private:
+
+  std::unique_ptr<Proc> m_proc;
+
+#ifdef _WIN32
+  HANDLE m_handle = nullptr;
+
+  static DWORD WINAPI threadProc(void* arg) {
+    (*reinterpret_cast<Proc*>(arg))();
+    return 0;
+  }
+#else
+  std::thread m_thread;
+#endif
+
+};
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+  * \brief CPU implementation of the D3D11 tiled resource layout rules
+  *
+  * Computes standard tile shapes, per-subresource tilings
+  * and packed mip info the same way GetResourceTiling
+  * reports them. This does not depend on any Windows
+  * headers, formats are passed as raw DXGI_FORMAT values.
+  */
+namespace tiling {
+
+constexpr uint32_t TileSize   = 65536;
+constexpr uint32_t PackedTile = ~0u;
+
+enum class Dimension : uint32_t {
+  Buffer,
+  Texture2D,
+  Texture3D,
+};
+
+
+/**
+  * \brief Format properties relevant to tiling
+  *
+  * Formats that cannot be used with tiled
+  * resources have a block size of zero.
+  */
+struct FormatInfo {
+  uint32_t bitsPerBlock = 0;
+  uint32_t blockWidth   = 1;
+  uint32_t blockHeight  = 1;
+};
+
+
+struct ResourceDesc {
+  Dimension dimension = Dimension::Buffer;
+  uint32_t  format    = 0;
+  uint32_t  width     = 1;
+  uint32_t  height    = 1;
+  uint32_t  depth     = 1;
+  uint32_t  mipLevels = 1;
+  uint32_t  arraySize = 1;
+  uint32_t  sampleCount = 1;
+};
+
+
+struct TileShape {
+  uint32_t widthInTexels  = 0;
+  uint32_t heightInTexels = 0;
+  uint32_t depthInTexels  = 0;
+};
+
+
+struct SubresourceTiling {
+  uint32_t widthInTiles                   = 0;
+  uint32_t heightInTiles                  = 0;
+  uint32_t depthInTiles                   = 0;
+  uint32_t startTileIndexInOverallResource = 0;
+};
+
+
+struct PackedMipDesc {
+  uint32_t numStandardMips                 = 0;
+  uint32_t numPackedMips                   = 0;
+  uint32_t numTilesForPackedMips           = 0;
+  uint32_t startTileIndexInOverallResource = 0;
+};
+
+
+struct ResourceTiling {
+  uint32_t                        tileCount = 0;
+  TileShape                       tileShape;
+  PackedMipDesc                   packedMips;
+  std::vector<SubresourceTiling>  subresources;
+};
+
+
+/**
+  * \brief Layout options
+  *
+  * Packing of small mips is implementation-defined
+  * to some degree, so these let the caller pick the
+  * rule that applies to the device being compared.
+  */
+struct Options {
+  /// Pack any mip whose extent is not a multiple of
+  /// the tile shape, rather than only mips that are
+  /// smaller than one tile. Tier 1 devices may do this.
+  bool     alignedMipSize = false;
+  /// Number of tiles per array layer used for packed
+  /// mips. If zero, the packed mips are assumed to be
+  /// stored linearly, which is a lower bound.
+  uint32_t packedMipTiles = 0;
+};
+
+
+/**
+  * \brief Queries tiling properties of a DXGI format
+  *
+  * \param [in] format Raw DXGI_FORMAT value
+  * \returns Format info, or a zero block size
+  *    if the format does not support tiling
+  */
+inline FormatInfo getFormatInfo(uint32_t format) {
+  // R32G32B32A32
+  if (format >= 1 && format <= 4)
+    return { 128, 1, 1 };
+
+  // R16G16B16A16, R32G32, R32G8X24 and depth variants
+  if (format >= 9 && format <= 22)
+    return { 64, 1, 1 };
+
+  // R10G10B10A2, R11G11B10, R8G8B8A8, R16G16, R32, R24G8
+  if (format >= 23 && format <= 47)
+    return { 32, 1, 1 };
+
+  // R8G8, R16, D16
+  if (format >= 48 && format <= 59)
+    return { 16, 1, 1 };
+
+  // R8, A8
+  if (format >= 60 && format <= 65)
+    return { 8, 1, 1 };
+
+  switch (format) {
+    // R9G9B9E5_SHAREDEXP
+    case 67:
+      return { 32, 1, 1 };
+
+    // BC1, BC4
+    case 70: case 71: case 72:
+    case 79: case 80: case 81:
+      return { 64, 4, 4 };
+
+    // BC2, BC3, BC5
+    case 73: case 74: case 75:
+    case 76: case 77: case 78:
+    case 82: case 83: case 84:
+      return { 128, 4, 4 };
+
+    // B5G6R5, B5G5R5A1
+    case 85: case 86:
+      return { 16, 1, 1 };
+
+    // B8G8R8A8, B8G8R8X8, R10G10B10_XR_BIAS_A2
+    case 87: case 88: case 89: case 90:
+    case 91: case 92: case 93:
+      return { 32, 1, 1 };
+
+    // BC6H, BC7
+    case 94: case 95: case 96:
+    case 97: case 98: case 99:
+      return { 128, 4, 4 };
+
+    // B4G4R4A4
+    case 115:
+      return { 16, 1, 1 };
+
+    // 96-bit, R1, packed 4:2:2 and video formats
+    default:
+      return { 0, 1, 1 };
+  }
+}
+
+
+/**
+  * \brief Computes the standard tile shape
+  *
+  * Multisampled 2D tiles keep the tile at 64 kB by
+  * shrinking the shape as the sample count grows.
+  * \param [in] dimension Resource dimension
+  * \param [in] format Raw DXGI_FORMAT value
+  * \param [in] sampleCount Number of samples, 2D only
+  * \returns Tile shape in texels, or all zeroes if the
+  *    format or sample count does not support tiling
+  */
+inline TileShape getStandardTileShape(Dimension dimension, uint32_t format, uint32_t sampleCount = 1) {
+  if (dimension == Dimension::Buffer)
+    return { TileSize, 1, 1 };
+
+  FormatInfo info = getFormatInfo(format);
+
+  // Tile shapes in blocks, indexed by log2(bytesPerBlock)
+  // and, for 2D textures, by log2(sampleCount)
+  static const TileShape shapes2D[5][5] = {
+    { { 256, 256, 1 }, { 128, 256, 1 }, { 128, 128, 1 }, {  64, 128, 1 }, {  64,  64, 1 } },
+    { { 256, 128, 1 }, { 128, 128, 1 }, { 128,  64, 1 }, {  64,  64, 1 }, {  64,  32, 1 } },
+    { { 128, 128, 1 }, { 128,  64, 1 }, {  64,  64, 1 }, {  64,  32, 1 }, {  32,  32, 1 } },
+    { { 128,  64, 1 }, {  64,  64, 1 }, {  64,  32, 1 }, {  32,  32, 1 }, {  32,  16, 1 } },
+    { {  64,  64, 1 }, {  64,  32, 1 }, {  32,  32, 1 }, {  32,  16, 1 }, {  16,  16, 1 } },
+  };
+
+  static const TileShape shapes3D[] = {
+    {  64,  32, 32 },
+    {  32,  32, 32 },
+    {  32,  32, 16 },
+    {  32,  16, 16 },
+    {  16,  16, 16 },
+  };
+
+  uint32_t index = 0;
+
+  switch (info.bitsPerBlock) {
+    case   8: index = 0; break;
+    case  16: index = 1; break;
+    case  32: index = 2; break;
+    case  64: index = 3; break;
+    case 128: index = 4; break;
+    default: return TileShape();
+  }
+
+  uint32_t sampleIndex = 0;
+
+  switch (sampleCount) {
+    case  1: sampleIndex = 0; break;
+    case  2: sampleIndex = 1; break;
+    case  4: sampleIndex = 2; break;
+    case  8: sampleIndex = 3; break;
+    case 16: sampleIndex = 4; break;
+    default: return TileShape();
+  }
+
+  if (dimension == Dimension::Texture3D && sampleIndex)
+    return TileShape();
+
+  TileShape shape = dimension == Dimension::Texture3D
+    ? shapes3D[index] : shapes2D[index][sampleIndex];
+
+  shape.widthInTexels  *= info.blockWidth;
+  shape.heightInTexels *= info.blockHeight;
+  return shape;
+}
+
+
+/**
+  * \brief Computes number of mip levels in a full chain
+  */
+inline uint32_t getFullMipCount(const ResourceDesc& desc) {
+  uint32_t maxExtent = std::max(desc.width, desc.height);
+
+  if (desc.dimension == Dimension::Texture3D)
+    maxExtent = std::max(maxExtent, desc.depth);
+
+  uint32_t count = 1;
+
+  while (maxExtent > 1) {
+    maxExtent >>= 1;
+    count += 1;
+  }
+
+  return count;
+}
+
+
+/**
+  * \brief Computes the full tiling layout of a resource
+  *
+  * Tiles are ordered by array layer first. Within each
+  * layer, all standard mips come first, followed by the
+  * tiles used to store the packed mips of that layer.
+  * \param [in] desc Resource description
+  * \param [in] options Layout options
+  * \param [out] result Resource tiling
+  * \returns \c false if the resource cannot be tiled
+  */
+inline bool computeResourceTiling(
+  const ResourceDesc&   desc,
+  const Options&        options,
+        ResourceTiling& result) {
+  result = ResourceTiling();
+
+  if (desc.dimension == Dimension::Buffer) {
+    result.tileCount = (desc.width + TileSize - 1) / TileSize;
+    result.tileShape = getStandardTileShape(desc.dimension, 0);
+
+    SubresourceTiling subresource;
+    subresource.widthInTiles  = result.tileCount;
+    subresource.heightInTiles = 1;
+    subresource.depthInTiles  = 1;
+    subresource.startTileIndexInOverallResource = 0;
+
+    result.subresources.push_back(subresource);
+    return true;
+  }
+
+  FormatInfo info = getFormatInfo(desc.format);
+  TileShape shape = getStandardTileShape(desc.dimension, desc.format, desc.sampleCount);
+
+  if (!shape.widthInTexels)
+    return false;
+
+  bool is3D = desc.dimension == Dimension::Texture3D;
+
+  uint32_t mipCount = desc.mipLevels ? desc.mipLevels : getFullMipCount(desc);
+  uint32_t layerCount = is3D ? 1 : desc.arraySize;
+  uint32_t depth = is3D ? desc.depth : 1;
+
+  // Find the first mip that needs to be packed
+  uint32_t standardMips = 0;
+
+  for (uint32_t mip = 0; mip < mipCount; mip++) {
+    uint32_t w = std::max(desc.width  >> mip, 1u);
+    uint32_t h = std::max(desc.height >> mip, 1u);
+    uint32_t d = std::max(depth       >> mip, 1u);
+
+    bool packed = w < shape.widthInTexels
+               || h < shape.heightInTexels
+               || d < shape.depthInTexels;
+
+    if (options.alignedMipSize) {
+      packed |= (w % shape.widthInTexels)
+             || (h % shape.heightInTexels)
+             || (d % shape.depthInTexels);
+    }
+
+    if (packed)
+      break;
+
+    standardMips += 1;
+  }
+
+  uint32_t packedMips = mipCount - standardMips;
+  uint32_t packedTiles = 0;
+
+  if (packedMips) {
+    packedTiles = options.packedMipTiles;
+
+    if (!packedTiles) {
+      uint64_t packedSize = 0;
+
+      for (uint32_t mip = standardMips; mip < mipCount; mip++) {
+        uint64_t w = std::max(desc.width  >> mip, 1u);
+        uint64_t h = std::max(desc.height >> mip, 1u);
+        uint64_t d = std::max(depth       >> mip, 1u);
+
+        uint64_t blocksW = (w + info.blockWidth  - 1) / info.blockWidth;
+        uint64_t blocksH = (h + info.blockHeight - 1) / info.blockHeight;
+
+        packedSize += blocksW * blocksH * d * desc.sampleCount * info.bitsPerBlock / 8;
+      }
+
+      packedTiles = uint32_t(std::max<uint64_t>((packedSize + TileSize - 1) / TileSize, 1));
+    }
+  }
+
+  result.tileShape = shape;
+  result.packedMips.numStandardMips = standardMips;
+  result.packedMips.numPackedMips = packedMips;
+  result.packedMips.numTilesForPackedMips = packedTiles;
+  result.subresources.resize(mipCount * layerCount);
+
+  uint32_t tileIndex = 0;
+
+  for (uint32_t layer = 0; layer < layerCount; layer++) {
+    for (uint32_t mip = 0; mip < mipCount; mip++) {
+      SubresourceTiling& subresource = result.subresources[mip + mipCount * layer];
+
+      if (mip < standardMips) {
+        uint32_t w = std::max(desc.width  >> mip, 1u);
+        uint32_t h = std::max(desc.height >> mip, 1u);
+        uint32_t d = std::max(depth       >> mip, 1u);
+
+        subresource.widthInTiles  = (w + shape.widthInTexels  - 1) / shape.widthInTexels;
+        subresource.heightInTiles = (h + shape.heightInTexels - 1) / shape.heightInTexels;
+        subresource.depthInTiles  = (d + shape.depthInTexels  - 1) / shape.depthInTexels;
+        subresource.startTileIndexInOverallResource = tileIndex;
+
+        tileIndex += subresource.widthInTiles
+                   * subresource.heightInTiles
+                   * subresource.depthInTiles;
+      } else {
+        subresource.startTileIndexInOverallResource = PackedTile;
+      }
+    }
+
+    if (packedMips) {
+      if (!layer)
+        result.packedMips.startTileIndexInOverallResource = tileIndex;
+
+      tileIndex += packedTiles;
+    }
+  }
+
+  result.tileCount = tileIndex;
+  return true;
+}
+
+}
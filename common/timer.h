@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/**
+  * \brief High resolution CPU timer
+  *
+  * Measures wall clock time since
+  * creation or the last reset.
+  */
+class Timer {
+  using Clock = std::chrono::high_resolution_clock;
+public:
+
+  Timer()
+  : m_start(Clock::now()) { }
+
+  void reset() {
+    m_start = Clock::now();
+  }
+
+  double us() const {
+    return std::chrono::duration<double, std::micro>(Clock::now() - m_start).count();
+  }
+
+  double ms() const {
+    return std::chrono::duration<double, std::milli>(Clock::now() - m_start).count();
+  }
+
+private:
+
+  Clock::time_point m_start;
+
+};
+
+
+/**
+  * \brief Sample statistics
+  *
+  * Collects raw samples so that percentiles
+  * can be computed after the measurement.
+  */
+class Stats {
+
+public:
+
+  void add(double sample) {
+    m_samples.push_back(sample);
+    m_sorted = false;
+  }
+
+  void clear() {
+    m_samples.clear();
+  }
+
+  void merge(const Stats& other) {
+    m_samples.insert(m_samples.end(), other.m_samples.begin(), other.m_samples.end());
+    m_sorted = false;
+  }
+
+  size_t count() const {
+    return m_samples.size();
+  }
+
+  double sum() const {
+    double result = 0.0;
+
+    for (double s : m_samples)
+      result += s;
+
+    return result;
+  }
+
+  double avg() const {
+    return m_samples.empty() ? 0.0 : sum() / double(m_samples.size());
+  }
+
+  double min() {
+    return percentile(0.0);
+  }
+
+  double max() {
+    return percentile(100.0);
+  }
+
+  double percentile(double p) {
+    if (m_samples.empty())
+      return 0.0;
+
+    if (!m_sorted) {
+      std::sort(m_samples.begin(), m_samples.end());
+      m_sorted = true;
+    }
+
+    size_t index = size_t(std::round(p / 100.0 * double(m_samples.size() - 1)));
+    return m_samples[std::min(index, m_samples.size() - 1)];
+  }
+
+private:
+
+  std::vector<double> m_samples;
+  bool                m_sorted = false;
+
+};
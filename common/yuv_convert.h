@@ -0,0 +1,800 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "thread.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define YUV_HAS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define YUV_HAS_X86 0
+#endif
+
+#if YUV_HAS_X86 && defined(__GNUC__)
+#define YUV_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define YUV_TARGET_AVX2
+#endif
+
+namespace yuv {
+
+  enum class Format : uint32_t {
+    NV12,
+    YUY2,
+    P010,
+    AYUV,
+  };
+
+  enum class Matrix : uint32_t {
+    BT601,
+    BT709,
+    BT2020,
+  };
+
+  enum class Range : uint32_t {
+    Full,
+    Limited,
+  };
+
+  enum class RgbOrder : uint32_t {
+    RGBA,
+    BGRA,
+  };
+
+  enum class Kernel : uint32_t {
+    Scalar,
+    SSE2,
+    AVX2,
+    Auto,
+  };
+
+  /**
+    * \brief Conversion arguments
+    *
+    * The source image is 8-bit RGBA or BGRA. For planar formats,
+    * the interleaved chroma plane immediately follows the luma
+    * plane, i.e. it starts at \c dstPitch * \c height bytes, which
+    * matches the layout of mapped D3D11 and D3D9 NV12 surfaces,
+    * unless \c dstChroma is set. AYUV is stored as V, U, Y, A
+    * bytes with opaque alpha.
+    */
+  struct ConvertArgs {
+    Format      format      = Format::NV12;
+    Matrix      matrix      = Matrix::BT601;
+    Range       range       = Range::Limited;
+    RgbOrder    rgbOrder    = RgbOrder::RGBA;
+    uint32_t    width       = 0;
+    uint32_t    height      = 0;
+    const void* src         = nullptr;
+    size_t      srcPitch    = 0;
+    void*       dst         = nullptr;
+    size_t      dstPitch    = 0;
+    void*       dstChroma   = nullptr;
+    Kernel      kernel      = Kernel::Auto;
+    uint32_t    threadCount = 0;
+  };
+
+  /**
+    * \brief Fixed-point coefficients
+    *
+    * Computes <tt>(r * R + g * G + b * B + offset) >> shift</tt>
+    * for 8-bit inputs, where R, G and B may be sums of up to
+    * four pixels. The offset includes the rounding term.
+    */
+  struct Coeffs {
+    int16_t r;
+    int16_t g;
+    int16_t b;
+    int32_t offset;
+    int32_t shift;
+  };
+
+  struct CoeffSet {
+    Coeffs y;
+    Coeffs u;
+    Coeffs v;
+  };
+
+  inline bool isSubsampledX(Format format) {
+    return format != Format::AYUV;
+  }
+
+  inline bool isSubsampledY(Format format) {
+    return format == Format::NV12 || format == Format::P010;
+  }
+
+  inline uint32_t getBitDepth(Format format) {
+    return format == Format::P010 ? 10 : 8;
+  }
+
+  /**
+    * \brief Minimum row pitch for the given format
+    */
+  inline size_t getMinPitch(Format format, uint32_t width) {
+    switch (format) {
+      case Format::NV12: return (width + 1) & ~1u;
+      case Format::YUY2: return 2 * ((width + 1) & ~1u);
+      case Format::P010: return 2 * ((width + 1) & ~1u);
+      case Format::AYUV: return 4 * width;
+    }
+
+    return 0;
+  }
+
+  /**
+    * \brief Total image size, including the chroma plane
+    */
+  inline size_t getImageSize(Format format, uint32_t height, size_t pitch) {
+    return isSubsampledY(format)
+      ? pitch * (height + (height + 1) / 2)
+      : pitch * height;
+  }
+
+  inline void getLumaWeights(Matrix matrix, float& kr, float& kb) {
+    kr = 0.299f;
+    kb = 0.114f;
+
+    if (matrix == Matrix::BT709) {
+      kr = 0.2126f; kb = 0.0722f;
+    } else if (matrix == Matrix::BT2020) {
+      kr = 0.2627f; kb = 0.0593f;
+    }
+  }
+
+  /**
+    * \brief Computes floating point conversion factors
+    *
+    * Maps 8-bit RGB values to output code values, such that
+    * <tt>Y = ky[0] * R + ky[1] * G + ky[2] * B + ky[3]</tt>,
+    * and likewise for U (Cb) and V (Cr).
+    */
+  inline void getFactors(Matrix matrix, Range range, uint32_t bitDepth,
+      float ky[4], float ku[4], float kv[4]) {
+    float kr, kb;
+    getLumaWeights(matrix, kr, kb);
+
+    float kg = 1.0f - kr - kb;
+    float mul = float(1u << (bitDepth - 8));
+    float maxValue = float((1u << bitDepth) - 1);
+
+    float yScale = range == Range::Full ? maxValue : 219.0f * mul;
+    float cScale = range == Range::Full ? maxValue : 224.0f * mul;
+    float yOffset = range == Range::Full ? 0.0f : 16.0f * mul;
+    float cOffset = 128.0f * mul;
+
+    // Normalized Y' and Cb/Cr in terms of R, G, B
+    float y[3] = { kr, kg, kb };
+    float u[3] = { -kr / (2.0f * (1.0f - kb)), -kg / (2.0f * (1.0f - kb)), 0.5f };
+    float v[3] = { 0.5f, -kg / (2.0f * (1.0f - kr)), -kb / (2.0f * (1.0f - kr)) };
+
+    for (uint32_t i = 0; i < 3; i++) {
+      ky[i] = y[i] * yScale / 255.0f;
+      ku[i] = u[i] * cScale / 255.0f;
+      kv[i] = v[i] * cScale / 255.0f;
+    }
+
+    ky[3] = yOffset;
+    ku[3] = cOffset;
+    kv[3] = cOffset;
+  }
+
+  /**
+    * \brief Converts a single YUV value to RGB
+    *
+    * Reference implementation for verifying GPU results,
+    * not meant to be fast. Returns normalized RGB values,
+    * clamped to the [0, 1] range.
+    * \param [in] y Luma code value
+    * \param [in] u Cb code value
+    * \param [in] v Cr code value
+    * \param [out] rgb Normalized RGB values
+    */
+  inline void toRgb(Matrix matrix, Range range, uint32_t bitDepth,
+      int32_t y, int32_t u, int32_t v, float rgb[3]) {
+    float kr, kb;
+    getLumaWeights(matrix, kr, kb);
+
+    float mul = float(1u << (bitDepth - 8));
+    float maxValue = float((1u << bitDepth) - 1);
+
+    float yScale = range == Range::Full ? maxValue : 219.0f * mul;
+    float cScale = range == Range::Full ? maxValue : 224.0f * mul;
+    float yOffset = range == Range::Full ? 0.0f : 16.0f * mul;
+    float cOffset = 128.0f * mul;
+
+    float yn = (float(y) - yOffset) / yScale;
+    float cb = (float(u) - cOffset) / cScale;
+    float cr = (float(v) - cOffset) / cScale;
+
+    float r = yn + 2.0f * (1.0f - kr) * cr;
+    float b = yn + 2.0f * (1.0f - kb) * cb;
+    float g = (yn - kr * r - kb * b) / (1.0f - kr - kb);
+
+    rgb[0] = std::clamp(r, 0.0f, 1.0f);
+    rgb[1] = std::clamp(g, 0.0f, 1.0f);
+    rgb[2] = std::clamp(b, 0.0f, 1.0f);
+  }
+
+  inline Coeffs makeCoeffs(const float k[4], RgbOrder order, uint32_t sampleCountLog2) {
+    constexpr int32_t Precision = 12;
+
+    Coeffs result;
+    result.shift = Precision + int32_t(sampleCountLog2);
+
+    float scale = float(1u << Precision);
+    int16_t r = int16_t(std::lround(k[0] * scale));
+    int16_t g = int16_t(std::lround(k[1] * scale));
+    int16_t b = int16_t(std::lround(k[2] * scale));
+
+    result.r = order == RgbOrder::RGBA ? r : b;
+    result.g = g;
+    result.b = order == RgbOrder::RGBA ? b : r;
+    result.offset = int32_t(std::lround(k[3] * float(1 << result.shift))) + (1 << (result.shift - 1));
+    return result;
+  }
+
+  inline CoeffSet getCoeffs(Format format, Matrix matrix, Range range, RgbOrder order) {
+    float ky[4], ku[4], kv[4];
+    getFactors(matrix, range, getBitDepth(format), ky, ku, kv);
+
+    uint32_t chromaLog2 = (isSubsampledX(format) ? 1 : 0) + (isSubsampledY(format) ? 1 : 0);
+
+    CoeffSet result;
+    result.y = makeCoeffs(ky, order, 0);
+    result.u = makeCoeffs(ku, order, chromaLog2);
+    result.v = makeCoeffs(kv, order, chromaLog2);
+    return result;
+  }
+
+  inline int32_t applyCoeffs(const Coeffs& c, int32_t r, int32_t g, int32_t b) {
+    return (c.r * r + c.g * g + c.b * b + c.offset) >> c.shift;
+  }
+
+  inline int16_t saturate16(int32_t v) {
+    return int16_t(std::clamp(v, -32768, 32767));
+  }
+
+
+  /**
+    * \brief Row kernels
+    *
+    * \c luma computes one value per pixel. \c chroma computes
+    * one U and V value per pixel pair, from one or two rows,
+    * and returns the number of samples it processed, so that
+    * the caller can handle the remainder. Pack functions turn
+    * 16-bit intermediate values into the output format.
+    */
+  struct Kernels {
+    uint32_t (*luma)   (const uint8_t* src, uint32_t width, const Coeffs& c, int16_t* dst);
+    uint32_t (*chroma) (const uint8_t* src0, const uint8_t* src1, uint32_t count,
+                        const Coeffs& cu, const Coeffs& cv, int16_t* dstU, int16_t* dstV);
+  };
+
+
+  namespace scalar {
+
+    inline uint32_t luma(const uint8_t* src, uint32_t width, const Coeffs& c, int16_t* dst) {
+      for (uint32_t x = 0; x < width; x++)
+        dst[x] = saturate16(applyCoeffs(c, src[4 * x + 0], src[4 * x + 1], src[4 * x + 2]));
+
+      return width;
+    }
+
+    inline uint32_t chroma(const uint8_t* src0, const uint8_t* src1, uint32_t count,
+        const Coeffs& cu, const Coeffs& cv, int16_t* dstU, int16_t* dstV) {
+      for (uint32_t x = 0; x < count; x++) {
+        int32_t rgb[3];
+
+        for (uint32_t i = 0; i < 3; i++) {
+          rgb[i] = src0[8 * x + i] + src0[8 * x + 4 + i];
+
+          if (src1)
+            rgb[i] += src1[8 * x + i] + src1[8 * x + 4 + i];
+        }
+
+        dstU[x] = saturate16(applyCoeffs(cu, rgb[0], rgb[1], rgb[2]));
+        dstV[x] = saturate16(applyCoeffs(cv, rgb[0], rgb[1], rgb[2]));
+      }
+
+      return count;
+    }
+
+  }
+
+
+#if YUV_HAS_X86
+  namespace sse2 {
+
+    inline __m128i dot4(__m128i pixels, __m128i c, __m128i offset, __m128i shift) {
+      __m128i zero = _mm_setzero_si128();
+      __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), c);
+      __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), c);
+
+      __m128i a = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+      __m128i b = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)));
+      return _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(a, b), offset), shift);
+    }
+
+    inline __m128i dot2x2(__m128i sums0, __m128i sums1, __m128i c, __m128i offset, __m128i shift) {
+      __m128i lo = _mm_madd_epi16(sums0, c);
+      __m128i hi = _mm_madd_epi16(sums1, c);
+
+      __m128i a = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+      __m128i b = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)));
+      return _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(a, b), offset), shift);
+    }
+
+    inline __m128i sumPairs(__m128i pixels) {
+      __m128i zero = _mm_setzero_si128();
+      __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+      __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+      lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+      hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+      return _mm_unpacklo_epi64(lo, hi);
+    }
+
+    inline __m128i loadCoeffs(const Coeffs& c) {
+      return _mm_setr_epi16(c.r, c.g, c.b, 0, c.r, c.g, c.b, 0);
+    }
+
+    inline uint32_t luma(const uint8_t* src, uint32_t width, const Coeffs& c, int16_t* dst) {
+      __m128i coeffs = loadCoeffs(c);
+      __m128i offset = _mm_set1_epi32(c.offset);
+      __m128i shift = _mm_cvtsi32_si128(c.shift);
+
+      uint32_t x = 0;
+
+      for ( ; x + 8 <= width; x += 8) {
+        __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[4 * x]));
+        __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[4 * x + 16]));
+
+        __m128i y = _mm_packs_epi32(
+          dot4(p0, coeffs, offset, shift),
+          dot4(p1, coeffs, offset, shift));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[x]), y);
+      }
+
+      return x;
+    }
+
+    inline uint32_t chroma(const uint8_t* src0, const uint8_t* src1, uint32_t count,
+        const Coeffs& cu, const Coeffs& cv, int16_t* dstU, int16_t* dstV) {
+      __m128i coeffsU = loadCoeffs(cu);
+      __m128i coeffsV = loadCoeffs(cv);
+      __m128i offsetU = _mm_set1_epi32(cu.offset);
+      __m128i offsetV = _mm_set1_epi32(cv.offset);
+      __m128i shift = _mm_cvtsi32_si128(cu.shift);
+
+      uint32_t x = 0;
+
+      for ( ; x + 4 <= count; x += 4) {
+        __m128i s0 = sumPairs(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&src0[8 * x])));
+        __m128i s1 = sumPairs(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&src0[8 * x + 16])));
+
+        if (src1) {
+          s0 = _mm_add_epi16(s0, sumPairs(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&src1[8 * x]))));
+          s1 = _mm_add_epi16(s1, sumPairs(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&src1[8 * x + 16]))));
+        }
+
+        __m128i uv = _mm_packs_epi32(
+          dot2x2(s0, s1, coeffsU, offsetU, shift),
+          dot2x2(s0, s1, coeffsV, offsetV, shift));
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&dstU[x]), uv);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&dstV[x]), _mm_srli_si128(uv, 8));
+      }
+
+      return x;
+    }
+
+  }
+
+
+  namespace avx2 {
+
+    YUV_TARGET_AVX2 inline __m256i dot8(__m256i lo, __m256i hi, __m256i offset, __m128i shift) {
+      __m256i a = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+      __m256i b = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)));
+      return _mm256_sra_epi32(_mm256_add_epi32(_mm256_add_epi32(a, b), offset), shift);
+    }
+
+    YUV_TARGET_AVX2 inline __m256i sumPairs(__m256i pixels) {
+      __m256i zero = _mm256_setzero_si256();
+      __m256i lo = _mm256_unpacklo_epi8(pixels, zero);
+      __m256i hi = _mm256_unpackhi_epi8(pixels, zero);
+      lo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+      hi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+      return _mm256_unpacklo_epi64(lo, hi);
+    }
+
+    YUV_TARGET_AVX2 inline __m256i loadCoeffs(const Coeffs& c) {
+      return _mm256_setr_epi16(
+        c.r, c.g, c.b, 0, c.r, c.g, c.b, 0,
+        c.r, c.g, c.b, 0, c.r, c.g, c.b, 0);
+    }
+
+    YUV_TARGET_AVX2 inline uint32_t luma(const uint8_t* src, uint32_t width, const Coeffs& c, int16_t* dst) {
+      __m256i coeffs = loadCoeffs(c);
+      __m256i offset = _mm256_set1_epi32(c.offset);
+      __m128i shift = _mm_cvtsi32_si128(c.shift);
+      __m256i zero = _mm256_setzero_si256();
+
+      uint32_t x = 0;
+
+      for ( ; x + 16 <= width; x += 16) {
+        __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[4 * x]));
+        __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[4 * x + 32]));
+
+        // Each 128-bit lane holds four pixels, so results
+        // need to be reordered after packing
+        __m256i y0 = dot8(
+          _mm256_madd_epi16(_mm256_unpacklo_epi8(p0, zero), coeffs),
+          _mm256_madd_epi16(_mm256_unpackhi_epi8(p0, zero), coeffs), offset, shift);
+        __m256i y1 = dot8(
+          _mm256_madd_epi16(_mm256_unpacklo_epi8(p1, zero), coeffs),
+          _mm256_madd_epi16(_mm256_unpackhi_epi8(p1, zero), coeffs), offset, shift);
+
+        __m256i y = _mm256_permute4x64_epi64(_mm256_packs_epi32(y0, y1), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dst[x]), y);
+      }
+
+      return x + sse2::luma(src + 4 * x, width - x, c, dst + x);
+    }
+
+    YUV_TARGET_AVX2 inline uint32_t chroma(const uint8_t* src0, const uint8_t* src1, uint32_t count,
+        const Coeffs& cu, const Coeffs& cv, int16_t* dstU, int16_t* dstV) {
+      __m256i coeffsU = loadCoeffs(cu);
+      __m256i coeffsV = loadCoeffs(cv);
+      __m256i offsetU = _mm256_set1_epi32(cu.offset);
+      __m256i offsetV = _mm256_set1_epi32(cv.offset);
+      __m128i shift = _mm_cvtsi32_si128(cu.shift);
+      __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+
+      uint32_t x = 0;
+
+      for ( ; x + 8 <= count; x += 8) {
+        __m256i s0 = sumPairs(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src0[8 * x])));
+        __m256i s1 = sumPairs(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src0[8 * x + 32])));
+
+        if (src1) {
+          s0 = _mm256_add_epi16(s0, sumPairs(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src1[8 * x]))));
+          s1 = _mm256_add_epi16(s1, sumPairs(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src1[8 * x + 32]))));
+        }
+
+        __m256i u = _mm256_permutevar8x32_epi32(dot8(
+          _mm256_madd_epi16(s0, coeffsU),
+          _mm256_madd_epi16(s1, coeffsU), offsetU, shift), order);
+        __m256i v = _mm256_permutevar8x32_epi32(dot8(
+          _mm256_madd_epi16(s0, coeffsV),
+          _mm256_madd_epi16(s1, coeffsV), offsetV, shift), order);
+
+        __m256i uv = _mm256_permute4x64_epi64(_mm256_packs_epi32(u, v), _MM_SHUFFLE(3, 1, 2, 0));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dstU[x]), _mm256_castsi256_si128(uv));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dstV[x]), _mm256_extracti128_si256(uv, 1));
+      }
+
+      return x + sse2::chroma(
+        src0 + 8 * x, src1 ? src1 + 8 * x : nullptr,
+        count - x, cu, cv, dstU + x, dstV + x);
+    }
+
+  }
+
+  inline bool isAvx2Supported() {
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4] = { };
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+  }
+#endif
+
+
+  inline Kernel getBestKernel() {
+#if YUV_HAS_X86
+    return isAvx2Supported() ? Kernel::AVX2 : Kernel::SSE2;
+#else
+    return Kernel::Scalar;
+#endif
+  }
+
+  inline Kernels getKernels(Kernel kernel) {
+    if (kernel == Kernel::Auto)
+      kernel = getBestKernel();
+
+    switch (kernel) {
+#if YUV_HAS_X86
+      case Kernel::SSE2: return { &sse2::luma, &sse2::chroma };
+      case Kernel::AVX2: return { &avx2::luma, &avx2::chroma };
+#endif
+      default: return { &scalar::luma, &scalar::chroma };
+    }
+  }
+
+
+  /**
+    * \brief Packs 16-bit intermediate values
+    *
+    * Values are clamped to the valid range of the output
+    * format. \c count is the number of output elements
+    * for \c interleave2, and the number of pixel pairs
+    * for \c packYuy2 and pixels for \c packAyuv.
+    */
+  inline void pack8(const int16_t* src, uint32_t count, uint8_t* dst) {
+    uint32_t x = 0;
+#if YUV_HAS_X86
+    for ( ; x + 16 <= count; x += 16) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x]));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x + 8]));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[x]), _mm_packus_epi16(a, b));
+    }
+#endif
+    for ( ; x < count; x++)
+      dst[x] = uint8_t(std::clamp<int16_t>(src[x], 0, 255));
+  }
+
+  inline void pack10(const int16_t* src, uint32_t count, uint16_t* dst) {
+    uint32_t x = 0;
+#if YUV_HAS_X86
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_set1_epi16(1023);
+
+    for ( ; x + 8 <= count; x += 8) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x]));
+      a = _mm_slli_epi16(_mm_min_epi16(_mm_max_epi16(a, lo), hi), 6);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[x]), a);
+    }
+#endif
+    for ( ; x < count; x++)
+      dst[x] = uint16_t(std::clamp<int16_t>(src[x], 0, 1023) << 6);
+  }
+
+  inline void interleave2(const int16_t* a, const int16_t* b, uint32_t count, int16_t* dst) {
+    uint32_t x = 0;
+#if YUV_HAS_X86
+    for ( ; x + 8 <= count; x += 8) {
+      __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&a[x]));
+      __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&b[x]));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[2 * x + 0]), _mm_unpacklo_epi16(va, vb));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[2 * x + 8]), _mm_unpackhi_epi16(va, vb));
+    }
+#endif
+    for ( ; x < count; x++) {
+      dst[2 * x + 0] = a[x];
+      dst[2 * x + 1] = b[x];
+    }
+  }
+
+  inline void packYuy2(const int16_t* y, const int16_t* u, const int16_t* v, uint32_t count, uint8_t* dst) {
+    uint32_t x = 0;
+#if YUV_HAS_X86
+    for ( ; x + 4 <= count; x += 4) {
+      __m128i vy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&y[2 * x]));
+      __m128i vuv = _mm_unpacklo_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&u[x])),
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&v[x])));
+
+      // Y0 U0 Y1 V0, with U and V shared by both pixels
+      __m128i lo = _mm_unpacklo_epi16(vy, vuv);
+      __m128i hi = _mm_unpackhi_epi16(vy, vuv);
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[4 * x]), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for ( ; x < count; x++) {
+      dst[4 * x + 0] = uint8_t(std::clamp<int16_t>(y[2 * x + 0], 0, 255));
+      dst[4 * x + 1] = uint8_t(std::clamp<int16_t>(u[x], 0, 255));
+      dst[4 * x + 2] = uint8_t(std::clamp<int16_t>(y[2 * x + 1], 0, 255));
+      dst[4 * x + 3] = uint8_t(std::clamp<int16_t>(v[x], 0, 255));
+    }
+  }
+
+  inline void packAyuv(const int16_t* y, const int16_t* u, const int16_t* v, uint32_t count, uint8_t* dst) {
+    uint32_t x = 0;
+#if YUV_HAS_X86
+    __m128i alpha = _mm_set1_epi16(255);
+
+    for ( ; x + 8 <= count; x += 8) {
+      __m128i vy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&y[x]));
+      __m128i vu = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&u[x]));
+      __m128i vv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&v[x]));
+
+      __m128i vuLo = _mm_unpacklo_epi16(vv, vu);
+      __m128i vuHi = _mm_unpackhi_epi16(vv, vu);
+      __m128i yaLo = _mm_unpacklo_epi16(vy, alpha);
+      __m128i yaHi = _mm_unpackhi_epi16(vy, alpha);
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[4 * x + 0]), _mm_packus_epi16(
+        _mm_unpacklo_epi32(vuLo, yaLo), _mm_unpackhi_epi32(vuLo, yaLo)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[4 * x + 16]), _mm_packus_epi16(
+        _mm_unpacklo_epi32(vuHi, yaHi), _mm_unpackhi_epi32(vuHi, yaHi)));
+    }
+#endif
+    for ( ; x < count; x++) {
+      dst[4 * x + 0] = uint8_t(std::clamp<int16_t>(v[x], 0, 255));
+      dst[4 * x + 1] = uint8_t(std::clamp<int16_t>(u[x], 0, 255));
+      dst[4 * x + 2] = uint8_t(std::clamp<int16_t>(y[x], 0, 255));
+      dst[4 * x + 3] = 0xFF;
+    }
+  }
+
+
+  /**
+    * \brief Converts a range of rows
+    *
+    * For vertically subsampled formats, \c rowBegin and
+    * \c rowEnd are in units of chroma rows.
+    */
+  inline void convertRows(const ConvertArgs& args, const CoeffSet& coeffs,
+      const Kernels& kernels, uint32_t rowBegin, uint32_t rowEnd) {
+    uint32_t chromaWidth = isSubsampledX(args.format) ? (args.width + 1) / 2 : args.width;
+
+    std::vector<int16_t> y0(2 * chromaWidth + 16);
+    std::vector<int16_t> y1(2 * chromaWidth + 16);
+    std::vector<int16_t> u(chromaWidth + 16);
+    std::vector<int16_t> v(chromaWidth + 16);
+    std::vector<int16_t> uv(2 * chromaWidth + 16);
+
+    // Padded copy of the last pixel column for odd widths
+    std::vector<uint8_t> edge(16);
+
+    auto srcBytes = reinterpret_cast<const uint8_t*>(args.src);
+    auto dstBytes = reinterpret_cast<uint8_t*>(args.dst);
+
+    auto srcRow = [&] (uint32_t row) {
+      return &srcBytes[std::min(row, args.height - 1) * args.srcPitch];
+    };
+
+    auto computeLuma = [&] (const uint8_t* src, int16_t* dst) {
+      uint32_t done = kernels.luma(src, args.width, coeffs.y, dst);
+      scalar::luma(src + 4 * done, args.width - done, coeffs.y, dst + done);
+
+      // Duplicate the last pixel so that packing can work on pairs
+      if (args.width & 1)
+        dst[args.width] = dst[args.width - 1];
+    };
+
+    auto computeChroma = [&] (const uint8_t* src0, const uint8_t* src1) {
+      uint32_t pairs = args.width / 2;
+      uint32_t done = kernels.chroma(src0, src1, pairs, coeffs.u, coeffs.v, u.data(), v.data());
+      scalar::chroma(src0 + 8 * done, src1 ? src1 + 8 * done : nullptr,
+        pairs - done, coeffs.u, coeffs.v, u.data() + done, v.data() + done);
+
+      if (args.width & 1) {
+        const uint8_t* last0 = src0 + 4 * (args.width - 1);
+        const uint8_t* last1 = src1 ? src1 + 4 * (args.width - 1) : nullptr;
+
+        std::memcpy(&edge[0], last0, 4);
+        std::memcpy(&edge[4], last0, 4);
+
+        if (last1) {
+          std::memcpy(&edge[8], last1, 4);
+          std::memcpy(&edge[12], last1, 4);
+        }
+
+        scalar::chroma(&edge[0], last1 ? &edge[8] : nullptr, 1,
+          coeffs.u, coeffs.v, u.data() + pairs, v.data() + pairs);
+      }
+    };
+
+    switch (args.format) {
+      case Format::NV12:
+      case Format::P010: {
+        uint8_t* chromaPlane = args.dstChroma
+          ? reinterpret_cast<uint8_t*>(args.dstChroma)
+          : dstBytes + args.dstPitch * args.height;
+
+        for (uint32_t row = rowBegin; row < rowEnd; row++) {
+          const uint8_t* src0 = srcRow(2 * row + 0);
+          const uint8_t* src1 = srcRow(2 * row + 1);
+
+          computeLuma(src0, y0.data());
+          computeLuma(src1, y1.data());
+          computeChroma(src0, src1);
+          interleave2(u.data(), v.data(), chromaWidth, uv.data());
+
+          uint8_t* dstY0 = dstBytes + (2 * row + 0) * args.dstPitch;
+          uint8_t* dstY1 = dstBytes + (2 * row + 1) * args.dstPitch;
+          uint8_t* dstUV = chromaPlane + row * args.dstPitch;
+
+          bool hasRow1 = 2 * row + 1 < args.height;
+
+          if (args.format == Format::NV12) {
+            pack8(y0.data(), args.width, dstY0);
+            if (hasRow1) pack8(y1.data(), args.width, dstY1);
+            pack8(uv.data(), 2 * chromaWidth, dstUV);
+          } else {
+            pack10(y0.data(), args.width, reinterpret_cast<uint16_t*>(dstY0));
+            if (hasRow1) pack10(y1.data(), args.width, reinterpret_cast<uint16_t*>(dstY1));
+            pack10(uv.data(), 2 * chromaWidth, reinterpret_cast<uint16_t*>(dstUV));
+          }
+        }
+      } break;
+
+      case Format::YUY2: {
+        for (uint32_t row = rowBegin; row < rowEnd; row++) {
+          const uint8_t* src = srcRow(row);
+
+          computeLuma(src, y0.data());
+          computeChroma(src, nullptr);
+          packYuy2(y0.data(), u.data(), v.data(), chromaWidth, dstBytes + row * args.dstPitch);
+        }
+      } break;
+
+      case Format::AYUV: {
+        for (uint32_t row = rowBegin; row < rowEnd; row++) {
+          const uint8_t* src = srcRow(row);
+
+          computeLuma(src, y0.data());
+
+          uint32_t done = kernels.luma(src, args.width, coeffs.u, u.data());
+          scalar::luma(src + 4 * done, args.width - done, coeffs.u, u.data() + done);
+
+          done = kernels.luma(src, args.width, coeffs.v, v.data());
+          scalar::luma(src + 4 * done, args.width - done, coeffs.v, v.data() + done);
+
+          packAyuv(y0.data(), u.data(), v.data(), args.width, dstBytes + row * args.dstPitch);
+        }
+      } break;
+    }
+  }
+
+  /**
+    * \brief Converts an RGB image to the given YUV format
+    *
+    * Chroma is sited at the center of each 2x1 or 2x2 block.
+    * Rows are distributed across threads if the image is
+    * large enough for this to be worthwhile.
+    */
+  inline void convert(const ConvertArgs& args) {
+    if (!args.width || !args.height)
+      return;
+
+    CoeffSet coeffs = getCoeffs(args.format, args.matrix, args.range, args.rgbOrder);
+    Kernels kernels = getKernels(args.kernel);
+
+    uint32_t rowCount = isSubsampledY(args.format)
+      ? (args.height + 1) / 2
+      : args.height;
+
+    constexpr uint32_t MinRowsPerThread = 32;
+
+    uint32_t threadCount = args.threadCount ? args.threadCount : Thread::hardwareConcurrency();
+    threadCount = std::max(1u, std::min(threadCount, rowCount / MinRowsPerThread));
+
+    if (threadCount == 1) {
+      convertRows(args, coeffs, kernels, 0, rowCount);
+      return;
+    }
+
+    std::vector<Thread> threads;
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+      uint32_t rowBegin = (rowCount * i) / threadCount;
+      uint32_t rowEnd = (rowCount * (i + 1)) / threadCount;
+
+      threads.emplace_back([&args, &coeffs, &kernels, rowBegin, rowEnd] {
+        convertRows(args, coeffs, kernels, rowBegin, rowEnd);
+      });
+    }
+
+    for (auto& t : threads)
+      t.join();
+  }
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "mapped_file.h"
+#include "yuv_convert.h"
+
+/**
+  * \brief Raw YUV sequence description
+  *
+  * Describes a headerless file of back-to-back frames
+  * with tightly packed rows, as written by most tools.
+  */
+struct YuvSequenceDesc {
+  std::string path;
+  yuv::Format format = yuv::Format::NV12;
+  uint32_t    width  = 0;
+  uint32_t    height = 0;
+
+  /**
+    * \brief Parses format and size arguments
+    *
+    * \param [in] formatArg One of \c nv12, \c yuy2 or \c p010
+    * \param [in] sizeArg Frame size, e.g. \c 1920x1080
+    * \returns \c true on success
+    */
+  bool parse(const std::string& formatArg, const std::string& sizeArg) {
+    if (formatArg == "nv12")
+      format = yuv::Format::NV12;
+    else if (formatArg == "yuy2")
+      format = yuv::Format::YUY2;
+    else if (formatArg == "p010")
+      format = yuv::Format::P010;
+    else
+      return false;
+
+    std::stringstream stream(sizeArg);
+    char separator = '\0';
+
+    if (!(stream >> width >> separator >> height) || separator != 'x')
+      return false;
+
+    // All supported formats use 2x1 or 2x2 chroma blocks
+    return width && height && !(width & 1) && !(height & 1);
+  }
+};
+
+
+/**
+  * \brief Memory-mapped raw YUV sequence
+  *
+  * Frames are read straight from the mapped file, so
+  * only frames that are actually played get paged in.
+  */
+class YuvSequence {
+
+public:
+
+  YuvSequence(const YuvSequenceDesc& desc)
+  : m_desc(desc), m_file(desc.path) {
+    m_rowSize = yuv::getMinPitch(desc.format, desc.width);
+    m_frameSize = yuv::getImageSize(desc.format, desc.height, m_rowSize);
+
+    if (m_file.valid())
+      m_frameCount = uint32_t(m_file.size() / m_frameSize);
+  }
+
+  bool valid() const {
+    return m_frameCount != 0;
+  }
+
+  const YuvSequenceDesc& desc() const {
+    return m_desc;
+  }
+
+  uint32_t frameCount() const {
+    return m_frameCount;
+  }
+
+  size_t frameSize() const {
+    return m_frameSize;
+  }
+
+  /**
+    * \brief Copies a frame to a mapped image
+    *
+    * For planar formats, the chroma plane is expected
+    * to start right after the last luma row, which is
+    * the layout D3D9 and D3D11 use for mapped surfaces.
+    * \param [in] index Frame index, wraps around
+    * \param [in] dst Destination pointer
+    * \param [in] dstPitch Destination row pitch
+    * \returns \c true on success
+    */
+  bool copyFrame(uint32_t index, void* dst, size_t dstPitch) {
+    auto src = m_file.map(uint64_t(index % m_frameCount) * m_frameSize, m_frameSize);
+
+    if (!src)
+      return false;
+
+    auto dstBytes = reinterpret_cast<uint8_t*>(dst);
+
+    if (dstPitch == m_rowSize) {
+      std::memcpy(dstBytes, src, m_frameSize);
+      return true;
+    }
+
+    size_t rowCount = m_frameSize / m_rowSize;
+
+    for (size_t i = 0; i < rowCount; i++)
+      std::memcpy(&dstBytes[i * dstPitch], &src[i * m_rowSize], m_rowSize);
+
+    return true;
+  }
+
+private:
+
+  YuvSequenceDesc m_desc;
+  MappedFile      m_file;
+
+  size_t          m_rowSize     = 0;
+  size_t          m_frameSize   = 0;
+  uint32_t        m_frameCount  = 0;
+
+};
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <d3d11.h>
+#include <d3dcompiler.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/str.h"
+#include "../common/thread.h"
+#include "../common/timer.h"
+
+const std::string g_vertexShaderCode =
+  "float4 main(float4 v_pos : IN_POSITION) : SV_POSITION {\n"
+  "  return v_pos * VARIANT;\n"
+  "}\n";
+
+const std::string g_pixelShaderCode =
+  "Texture2D<float4> t_tex : register(t0);\n"
+  "float4 main(float4 pos : SV_POSITION) : SV_TARGET {\n"
+  "  return t_tex.Load(int3(pos.xy, 0)) * VARIANT;\n"
+  "}\n";
+
+enum class CreateOp : uint32_t {
+  VertexShader,
+  PixelShader,
+  Texture,
+  TextureView,
+  Buffer,
+  BufferView,
+};
+
+constexpr uint32_t CreateOpCount = 6;
+
+struct ThreadResults {
+  std::array<Stats, CreateOpCount> latencies;
+};
+
+class ConcurrentCreateApp {
+
+public:
+
+  ConcurrentCreateApp() {
+    std::array<D3D_FEATURE_LEVEL, 2> fl = {
+      D3D_FEATURE_LEVEL_11_1,
+      D3D_FEATURE_LEVEL_11_0,
+    };
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, 0, fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &m_device, nullptr, nullptr))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    m_initialized = true;
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    D3D11_FEATURE_DATA_THREADING featureThreading = { };
+
+    if (SUCCEEDED(m_device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &featureThreading, sizeof(featureThreading)))) {
+      std::cout << "DriverConcurrentCreates: " << featureThreading.DriverConcurrentCreates << std::endl
+                << "DriverCommandLists:      " << featureThreading.DriverCommandLists << std::endl;
+    }
+
+    uint32_t maxThreads = std::min(Thread::hardwareConcurrency(), MaxThreadCount);
+    double baseRate = 0.0;
+
+    // Powers of two, plus the maximum thread count
+    std::vector<uint32_t> threadCounts;
+
+    for (uint32_t i = 1; i < maxThreads; i *= 2)
+      threadCounts.push_back(i);
+
+    threadCounts.push_back(maxThreads);
+
+    for (uint32_t threadCount : threadCounts) {
+      double rate = runTest(threadCount);
+
+      if (threadCount == 1)
+        baseRate = rate;
+
+      std::cout << "  Scaling: " << rate / baseRate << "x"
+                << ", efficiency " << 100.0 * rate / (baseRate * threadCount) << "%" << std::endl;
+    }
+
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t MaxThreadCount      = 32;
+  constexpr static uint32_t IterationsPerThread = 500;
+
+  Com<ID3D11Device> m_device;
+
+  std::vector<Com<ID3DBlob>> m_vsBlobs;
+  std::vector<Com<ID3DBlob>> m_psBlobs;
+
+  uint32_t m_nextVariant = 1;
+
+  bool m_initialized = false;
+
+  /**
+    * \brief Compiles shader variants for one run
+    *
+    * Every create in every run gets bytecode the device has
+    * not seen before, so that shader creation cannot be
+    * served from a shader cache. Variants are numbered
+    * across runs, and compilation is spread over all
+    * hardware threads since it is not part of the test.
+    */
+  bool compileShaders(uint32_t count) {
+    uint32_t firstVariant = m_nextVariant;
+    m_nextVariant += count;
+
+    m_vsBlobs.clear();
+    m_psBlobs.clear();
+    m_vsBlobs.resize(count);
+    m_psBlobs.resize(count);
+
+    std::atomic<uint32_t> next = { 0 };
+    std::atomic<bool> success = { true };
+    std::vector<Thread> threads;
+
+    for (uint32_t i = 0; i < Thread::hardwareConcurrency(); i++) {
+      threads.emplace_back([this, count, firstVariant, &next, &success] {
+        uint32_t index;
+
+        while ((index = next++) < count) {
+          if (!compileVariant(firstVariant + index, m_vsBlobs[index], m_psBlobs[index]))
+            success.store(false);
+        }
+      });
+    }
+
+    for (auto& t : threads)
+      t.join();
+
+    return success.load();
+  }
+
+  bool compileVariant(uint32_t index, Com<ID3DBlob>& vsBlob, Com<ID3DBlob>& psBlob) {
+    std::string variant = format(index, ".0f");
+
+    std::array<D3D_SHADER_MACRO, 2> macros = {{
+      { "VARIANT", variant.c_str() },
+      { nullptr, nullptr },
+    }};
+
+    if (FAILED(D3DCompile(g_vertexShaderCode.data(), g_vertexShaderCode.size(),
+        "Vertex shader", macros.data(), nullptr, "main", "vs_5_0", 0, 0, &vsBlob, nullptr))) {
+      std::cerr << "Failed to compile vertex shader" << std::endl;
+      return false;
+    }
+
+    if (FAILED(D3DCompile(g_pixelShaderCode.data(), g_pixelShaderCode.size(),
+        "Pixel shader", macros.data(), nullptr, "main", "ps_5_0", 0, 0, &psBlob, nullptr))) {
+      std::cerr << "Failed to compile pixel shader" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  void runThread(uint32_t threadIndex, const std::atomic<bool>& start, ThreadResults& results) {
+    D3D11_TEXTURE2D_DESC textureDesc = { };
+    textureDesc.Width = 256;
+    textureDesc.Height = 256;
+    textureDesc.MipLevels = 0;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    textureDesc.SampleDesc = { 1, 0 };
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    D3D11_BUFFER_DESC bufferDesc = { };
+    bufferDesc.ByteWidth = 1u << 16;
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC bufferViewDesc = { };
+    bufferViewDesc.Format = DXGI_FORMAT_R32_UINT;
+    bufferViewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    bufferViewDesc.Buffer.NumElements = bufferDesc.ByteWidth / sizeof(uint32_t);
+
+    while (!start.load())
+      continue;
+
+    for (uint32_t i = 0; i < IterationsPerThread; i++) {
+      uint32_t variant = threadIndex * IterationsPerThread + i;
+
+      Com<ID3D11VertexShader> vs;
+      Com<ID3D11PixelShader> ps;
+      Com<ID3D11Texture2D> texture;
+      Com<ID3D11ShaderResourceView> textureView;
+      Com<ID3D11Buffer> buffer;
+      Com<ID3D11ShaderResourceView> bufferView;
+
+      Timer timer;
+      m_device->CreateVertexShader(m_vsBlobs[variant]->GetBufferPointer(),
+        m_vsBlobs[variant]->GetBufferSize(), nullptr, &vs);
+      results.latencies[uint32_t(CreateOp::VertexShader)].add(timer.us());
+
+      timer.reset();
+      m_device->CreatePixelShader(m_psBlobs[variant]->GetBufferPointer(),
+        m_psBlobs[variant]->GetBufferSize(), nullptr, &ps);
+      results.latencies[uint32_t(CreateOp::PixelShader)].add(timer.us());
+
+      timer.reset();
+      m_device->CreateTexture2D(&textureDesc, nullptr, &texture);
+      results.latencies[uint32_t(CreateOp::Texture)].add(timer.us());
+
+      if (texture != nullptr) {
+        timer.reset();
+        m_device->CreateShaderResourceView(texture.ptr(), nullptr, &textureView);
+        results.latencies[uint32_t(CreateOp::TextureView)].add(timer.us());
+      }
+
+      timer.reset();
+      m_device->CreateBuffer(&bufferDesc, nullptr, &buffer);
+      results.latencies[uint32_t(CreateOp::Buffer)].add(timer.us());
+
+      if (buffer != nullptr) {
+        timer.reset();
+        m_device->CreateShaderResourceView(buffer.ptr(), &bufferViewDesc, &bufferView);
+        results.latencies[uint32_t(CreateOp::BufferView)].add(timer.us());
+      }
+    }
+  }
+
+  double runTest(uint32_t threadCount) {
+    if (!compileShaders(threadCount * IterationsPerThread))
+      return 0.0;
+
+    std::atomic<bool> start = { false };
+    std::vector<ThreadResults> results(threadCount);
+    std::vector<Thread> threads;
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+      threads.emplace_back([this, i, &start, &results] {
+        runThread(i, start, results[i]);
+      });
+    }
+
+    Timer timer;
+    start.store(true);
+
+    for (auto& t : threads)
+      t.join();
+
+    double ms = timer.ms();
+
+    static const std::array<const char*, CreateOpCount> s_opNames = {{
+      "VertexShader", "PixelShader", "Texture2D", "Texture SRV", "Buffer", "Buffer SRV",
+    }};
+
+    size_t totalCount = 0;
+
+    std::cout << threadCount << " thread(s):" << std::endl;
+
+    for (uint32_t op = 0; op < CreateOpCount; op++) {
+      Stats stats;
+
+      for (const auto& r : results)
+        stats.merge(r.latencies[op]);
+
+      totalCount += stats.count();
+
+      std::cout << "  " << s_opNames[op] << ": p50 " << stats.percentile(50.0) << " us"
+                << ", p99 " << stats.percentile(99.0) << " us"
+                << ", max " << stats.max() << " us" << std::endl;
+    }
+
+    double rate = double(totalCount) / (ms / 1000.0);
+
+    std::cout << "  " << totalCount << " objects in " << ms << " ms, "
+              << rate << " creations/s" << std::endl;
+
+    // Per-thread latencies show whether some threads get starved
+    std::cout << "  Per thread, p50/p99 in us:" << std::endl
+              << "  " << std::left << std::setw(8) << "Thread";
+
+    for (uint32_t op = 0; op < CreateOpCount; op++)
+      std::cout << std::setw(16) << s_opNames[op];
+
+    std::cout << std::endl;
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+      std::cout << "  " << std::setw(8) << i;
+
+      for (uint32_t op = 0; op < CreateOpCount; op++) {
+        auto& stats = results[i].latencies[op];
+        std::cout << std::setw(16) << format(std::fixed, std::setprecision(1),
+          stats.percentile(50.0), "/", stats.percentile(99.0));
+      }
+
+      std::cout << std::endl;
+    }
+
+    std::cout << std::right << std::defaultfloat;
+    return rate;
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  ConcurrentCreateApp app;
+  return app.run();
+}
@@ -0,0 +1,256 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <d3d11_4.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/thread.h"
+#include "../common/timer.h"
+
+class FenceApp {
+
+public:
+
+  FenceApp() {
+    std::array<D3D_FEATURE_LEVEL, 2> fl = {
+      D3D_FEATURE_LEVEL_11_1,
+      D3D_FEATURE_LEVEL_11_0,
+    };
+
+    Com<ID3D11Device> device;
+    Com<ID3D11DeviceContext> context;
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, 0, fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &device, nullptr, &context))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    if (FAILED(device->QueryInterface(IID_PPV_ARGS(&m_device)))
+     || FAILED(context->QueryInterface(IID_PPV_ARGS(&m_context)))) {
+      std::cerr << "Failed to query ID3D11Device5 or ID3D11DeviceContext4" << std::endl;
+      return;
+    }
+
+    if (FAILED(m_device->CreateFence(0, D3D11_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)))) {
+      std::cerr << "Failed to create fence" << std::endl;
+      return;
+    }
+
+    m_event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+
+    if (!m_event) {
+      std::cerr << "Failed to create event" << std::endl;
+      return;
+    }
+
+    D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT };
+
+    if (FAILED(m_device->CreateQuery(&queryDesc, &m_query))) {
+      std::cerr << "Failed to create event query" << std::endl;
+      return;
+    }
+
+    D3D11_TEXTURE2D_DESC rtDesc = { };
+    rtDesc.Width = 64;
+    rtDesc.Height = 64;
+    rtDesc.MipLevels = 1;
+    rtDesc.ArraySize = 1;
+    rtDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    rtDesc.SampleDesc = { 1, 0 };
+    rtDesc.Usage = D3D11_USAGE_DEFAULT;
+    rtDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+    Com<ID3D11Texture2D> renderTarget;
+
+    if (FAILED(m_device->CreateTexture2D(&rtDesc, nullptr, &renderTarget))
+     || FAILED(m_device->CreateRenderTargetView(renderTarget.ptr(), nullptr, &m_renderTargetView))) {
+      std::cerr << "Failed to create render target" << std::endl;
+      return;
+    }
+
+    m_initialized = true;
+  }
+
+  ~FenceApp() {
+    if (m_event)
+      CloseHandle(m_event);
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    Stats fenceSpin;
+    Stats fenceEvent;
+    Stats fenceWait;
+    Stats queryPoll;
+
+    for (uint32_t i = 0; i < SampleCount; i++) {
+      // Signal, then spin on the completed value
+      Timer timer;
+      submitWork();
+      m_context->Signal(m_fence.ptr(), ++m_fenceValue);
+      m_context->Flush();
+
+      while (m_fence->GetCompletedValue() < m_fenceValue)
+        continue;
+
+      fenceSpin.add(timer.us());
+
+      // Signal, then block on the completion event
+      timer.reset();
+      submitWork();
+      m_context->Signal(m_fence.ptr(), ++m_fenceValue);
+      m_fence->SetEventOnCompletion(m_fenceValue, m_event);
+      m_context->Flush();
+
+      WaitForSingleObject(m_event, INFINITE);
+      fenceEvent.add(timer.us());
+
+      // Make the GPU wait for a value signaled by the same context
+      timer.reset();
+      submitWork();
+      m_context->Signal(m_fence.ptr(), ++m_fenceValue);
+      m_context->Wait(m_fence.ptr(), m_fenceValue);
+      m_context->Signal(m_fence.ptr(), ++m_fenceValue);
+      m_context->Flush();
+
+      while (m_fence->GetCompletedValue() < m_fenceValue)
+        continue;
+
+      fenceWait.add(timer.us());
+
+      // Poll an event query instead of using a fence
+      timer.reset();
+      submitWork();
+      m_context->End(m_query.ptr());
+      m_context->Flush();
+
+      while (m_context->GetData(m_query.ptr(), nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+        continue;
+
+      queryPoll.add(timer.us());
+    }
+
+    printStats("Fence, spin on GetCompletedValue", fenceSpin);
+    printStats("Fence, SetEventOnCompletion", fenceEvent);
+    printStats("Fence, Signal + Wait + Signal", fenceWait);
+    printStats("Event query, poll GetData", queryPoll);
+
+    uint32_t negativeSamples = 0;
+    Stats wakeUp = measureWakeUpLatency(negativeSamples);
+
+    printStats("Event wake-up latency", wakeUp);
+
+    std::cout << "  " << negativeSamples << " of " << SampleCount
+              << " samples negative (waiter woke before the spinner), excluded" << std::endl;
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t SampleCount = 1000;
+
+  Com<ID3D11Device5>            m_device;
+  Com<ID3D11DeviceContext4>     m_context;
+  Com<ID3D11Fence>              m_fence;
+  Com<ID3D11Query>              m_query;
+  Com<ID3D11RenderTargetView>   m_renderTargetView;
+
+  HANDLE                        m_event = nullptr;
+  UINT64                        m_fenceValue = 0;
+
+  bool m_initialized = false;
+
+  void submitWork() {
+    FLOAT color[4] = { 0.0f, 0.0f, 0.0f, float(m_fenceValue & 1) };
+    m_context->ClearRenderTargetView(m_renderTargetView.ptr(), color);
+  }
+
+  /**
+    * \brief Measures event wake-up latency
+    *
+    * A helper thread spins on the fence value and records when
+    * it first observes completion. The main thread blocks on
+    * the completion event, so the difference between both
+    * timestamps is the time it takes to wake up a waiter.
+    * \param [out] negativeSamples Number of samples where the
+    *    waiter woke up first, which are not part of the result
+    */
+  Stats measureWakeUpLatency(uint32_t& negativeSamples) {
+    using Clock = std::chrono::high_resolution_clock;
+
+    std::atomic<UINT64> target = { 0 };
+    std::atomic<int64_t> observed = { 0 };
+    std::atomic<bool> stop = { false };
+
+    Thread spinner([this, &target, &observed, &stop] {
+      UINT64 last = 0;
+
+      while (!stop.load()) {
+        UINT64 value = target.load();
+
+        if (value > last && m_fence->GetCompletedValue() >= value) {
+          observed.store(Clock::now().time_since_epoch().count());
+          last = value;
+        }
+      }
+    });
+
+    Stats stats;
+    negativeSamples = 0;
+
+    for (uint32_t i = 0; i < SampleCount; i++) {
+      submitWork();
+      m_context->Signal(m_fence.ptr(), ++m_fenceValue);
+      m_fence->SetEventOnCompletion(m_fenceValue, m_event);
+
+      observed.store(0);
+      target.store(m_fenceValue);
+
+      m_context->Flush();
+      WaitForSingleObject(m_event, INFINITE);
+
+      int64_t woken = Clock::now().time_since_epoch().count();
+
+      // The spinner may not have seen the value yet
+      int64_t spun;
+
+      while (!(spun = observed.load()))
+        continue;
+
+      if (woken >= spun)
+        stats.add(std::chrono::duration<double, std::micro>(Clock::duration(woken - spun)).count());
+      else
+        negativeSamples += 1;
+    }
+
+    stop.store(true);
+    return stats;
+  }
+
+  void printStats(const char* name, Stats& stats) {
+    std::cout << name << ":" << std::endl
+              << "  avg " << stats.avg() << " us"
+              << ", p50 " << stats.percentile(50.0) << " us"
+              << ", p99 " << stats.percentile(99.0) << " us"
+              << ", max " << stats.max() << " us" << std::endl;
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  FenceApp app;
+  return app.run();
+}
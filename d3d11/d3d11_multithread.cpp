@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <d3d11_4.h>
+#include <d3dcompiler.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/thread.h"
+#include "../common/timer.h"
+
+const std::string g_vertexShaderCode =
+  "float4 main(uint vid : SV_VERTEXID) : SV_POSITION {\n"
+  "  float2 coord = float2(vid & 1, vid >> 1) * 4.0f - 1.0f;\n"
+  "  return float4(coord, 0.0f, 1.0f);\n"
+  "}\n";
+
+const std::string g_pixelShaderCode =
+  "cbuffer cb : register(b0) { float4 color; };\n"
+  "float4 main() : SV_TARGET {\n"
+  "  return color;\n"
+  "}\n";
+
+enum class LockMode : uint32_t {
+  Unprotected,
+  Implicit,
+  Explicit,
+};
+
+struct ThreadResults {
+  Stats mapTimes;
+  Stats lockTimes;
+};
+
+class MultithreadApp {
+
+public:
+
+  MultithreadApp() {
+    std::array<D3D_FEATURE_LEVEL, 2> fl = {
+      D3D_FEATURE_LEVEL_11_1,
+      D3D_FEATURE_LEVEL_11_0,
+    };
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, 0, fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &m_device, nullptr, &m_context))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    if (FAILED(m_context->QueryInterface(IID_PPV_ARGS(&m_multithread)))) {
+      std::cerr << "Failed to query ID3D11Multithread" << std::endl;
+      return;
+    }
+
+    m_initialized = createResources();
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    // Single-threaded submission without any locking as a baseline
+    double baseRate = runTest(LockMode::Unprotected, 1);
+
+    uint32_t maxThreads = std::min(Thread::hardwareConcurrency(), MaxThreadCount);
+
+    for (auto mode : { LockMode::Implicit, LockMode::Explicit }) {
+      for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+        double rate = runTest(mode, threadCount);
+
+        std::cout << "  vs. unprotected single thread: " << rate / baseRate << "x" << std::endl;
+      }
+    }
+
+    m_multithread->SetMultithreadProtected(FALSE);
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t MaxThreadCount  = 8;
+  constexpr static uint32_t TotalBatches    = 20000;
+
+  Com<ID3D11Device>             m_device;
+  Com<ID3D11DeviceContext>      m_context;
+  Com<ID3D11Multithread>        m_multithread;
+
+  Com<ID3D11Texture2D>          m_renderTarget;
+  Com<ID3D11RenderTargetView>   m_renderTargetView;
+  Com<ID3D11VertexShader>       m_vertexShader;
+  Com<ID3D11PixelShader>        m_pixelShader;
+
+  std::vector<Com<ID3D11Buffer>> m_constantBuffers;
+
+  bool m_initialized = false;
+
+  bool createResources() {
+    D3D11_TEXTURE2D_DESC rtDesc = { };
+    rtDesc.Width = 64;
+    rtDesc.Height = 64;
+    rtDesc.MipLevels = 1;
+    rtDesc.ArraySize = 1;
+    rtDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    rtDesc.SampleDesc = { 1, 0 };
+    rtDesc.Usage = D3D11_USAGE_DEFAULT;
+    rtDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+    if (FAILED(m_device->CreateTexture2D(&rtDesc, nullptr, &m_renderTarget))
+     || FAILED(m_device->CreateRenderTargetView(m_renderTarget.ptr(), nullptr, &m_renderTargetView))) {
+      std::cerr << "Failed to create render target" << std::endl;
+      return false;
+    }
+
+    Com<ID3DBlob> vertexShaderBlob;
+    Com<ID3DBlob> pixelShaderBlob;
+
+    if (FAILED(D3DCompile(g_vertexShaderCode.data(), g_vertexShaderCode.size(),
+        "Vertex shader", nullptr, nullptr, "main", "vs_5_0", 0, 0, &vertexShaderBlob, nullptr))) {
+      std::cerr << "Failed to compile vertex shader" << std::endl;
+      return false;
+    }
+
+    if (FAILED(D3DCompile(g_pixelShaderCode.data(), g_pixelShaderCode.size(),
+        "Pixel shader", nullptr, nullptr, "main", "ps_5_0", 0, 0, &pixelShaderBlob, nullptr))) {
+      std::cerr << "Failed to compile pixel shader" << std::endl;
+      return false;
+    }
+
+    if (FAILED(m_device->CreateVertexShader(
+        vertexShaderBlob->GetBufferPointer(),
+        vertexShaderBlob->GetBufferSize(),
+        nullptr, &m_vertexShader))) {
+      std::cerr << "Failed to create vertex shader" << std::endl;
+      return false;
+    }
+
+    if (FAILED(m_device->CreatePixelShader(
+        pixelShaderBlob->GetBufferPointer(),
+        pixelShaderBlob->GetBufferSize(),
+        nullptr, &m_pixelShader))) {
+      std::cerr << "Failed to create pixel shader" << std::endl;
+      return false;
+    }
+
+    D3D11_BUFFER_DESC cbDesc = { };
+    cbDesc.ByteWidth = 16;
+    cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+    cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    for (uint32_t i = 0; i < MaxThreadCount; i++) {
+      Com<ID3D11Buffer> buffer;
+
+      if (FAILED(m_device->CreateBuffer(&cbDesc, nullptr, &buffer))) {
+        std::cerr << "Failed to create constant buffer" << std::endl;
+        return false;
+      }
+
+      m_constantBuffers.push_back(std::move(buffer));
+    }
+
+    return true;
+  }
+
+  void bindState(ID3D11Buffer* constantBuffer) {
+    D3D11_VIEWPORT viewport = { 0.0f, 0.0f, 64.0f, 64.0f, 0.0f, 1.0f };
+
+    m_context->OMSetRenderTargets(1, &m_renderTargetView, nullptr);
+    m_context->RSSetViewports(1, &viewport);
+    m_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    m_context->VSSetShader(m_vertexShader.ptr(), nullptr, 0);
+    m_context->PSSetShader(m_pixelShader.ptr(), nullptr, 0);
+    m_context->PSSetConstantBuffers(0, 1, &constantBuffer);
+  }
+
+  /**
+    * \brief Submits one Map/Unmap/Draw batch
+    *
+    * Each thread maps its own constant buffer, since mapping
+    * a subresource that another thread still has mapped is
+    * invalid. With explicit locking, the thread holds the
+    * context lock for the entire batch. Otherwise, each call
+    * only takes the lock internally, so another thread may
+    * rebind the constant buffer before the draw, but all
+    * calls remain valid.
+    */
+  void submitBatch(LockMode mode, uint32_t threadIndex, uint32_t batch, ThreadResults& results) {
+    ID3D11Buffer* constantBuffer = m_constantBuffers[threadIndex].ptr();
+
+    if (mode == LockMode::Explicit) {
+      Timer lockTimer;
+      m_multithread->Enter();
+      results.lockTimes.add(lockTimer.us());
+
+      bindState(constantBuffer);
+    }
+
+    Timer mapTimer;
+    D3D11_MAPPED_SUBRESOURCE mapped = { };
+
+    if (SUCCEEDED(m_context->Map(constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+      float color[4] = { float(threadIndex) / float(MaxThreadCount), float(batch & 0xff) / 255.0f, 0.0f, 1.0f };
+      std::memcpy(mapped.pData, color, sizeof(color));
+      m_context->Unmap(constantBuffer, 0);
+    }
+
+    results.mapTimes.add(mapTimer.us());
+
+    if (mode != LockMode::Explicit)
+      m_context->PSSetConstantBuffers(0, 1, &constantBuffer);
+
+    m_context->Draw(3, 0);
+
+    if (mode == LockMode::Explicit)
+      m_multithread->Leave();
+  }
+
+  double runTest(LockMode mode, uint32_t threadCount) {
+    static const std::array<const char*, 3> s_modeNames = {{
+      "Unprotected", "Implicit locking", "Explicit Enter/Leave",
+    }};
+
+    m_multithread->SetMultithreadProtected(mode != LockMode::Unprotected);
+
+    m_context->ClearState();
+    bindState(m_constantBuffers[0].ptr());
+
+    std::atomic<bool> start = { false };
+    std::vector<ThreadResults> results(threadCount);
+    std::vector<Thread> threads;
+
+    uint32_t batchesPerThread = TotalBatches / threadCount;
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+      threads.emplace_back([this, mode, i, batchesPerThread, &start, &results] {
+        while (!start.load())
+          continue;
+
+        for (uint32_t j = 0; j < batchesPerThread; j++)
+          submitBatch(mode, i, j, results[i]);
+      });
+    }
+
+    Timer timer;
+    start.store(true);
+
+    for (auto& t : threads)
+      t.join();
+
+    m_context->Flush();
+
+    double ms = timer.ms();
+    double rate = double(batchesPerThread * threadCount) / (ms / 1000.0);
+
+    Stats mapStats;
+    Stats lockStats;
+
+    for (const auto& r : results) {
+      mapStats.merge(r.mapTimes);
+      lockStats.merge(r.lockTimes);
+    }
+
+    std::cout << s_modeNames[uint32_t(mode)] << ", " << threadCount << " thread(s): "
+              << rate << " batches/s" << std::endl
+              << "  Map+Unmap: p50 " << mapStats.percentile(50.0) << " us"
+              << ", p99 " << mapStats.percentile(99.0) << " us" << std::endl;
+
+    if (mode == LockMode::Explicit) {
+      std::cout << "  Lock wait: p50 " << lockStats.percentile(50.0) << " us"
+                << ", p99 " << lockStats.percentile(99.0) << " us"
+                << ", " << 100.0 * lockStats.sum() / (ms * 1000.0 * threadCount) << "% of thread time" << std::endl;
+    } else if (mode == LockMode::Implicit) {
+      // The lock is taken inside each call and cannot be timed separately,
+      // any wait for it is part of the Map+Unmap times above.
+      std::cout << "  Lock wait: n/a, included in Map+Unmap" << std::endl;
+    }
+
+    return rate;
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  MultithreadApp app;
+  return app.run();
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <array>
 #include <cstring>
 #include <iostream>
 #include <functional>
@@ -11,6 +13,7 @@
 
 #include "../common/com.h"
 #include "../common/str.h"
+#include "../common/timer.h"
 
 const std::string g_vertexShaderCode =
   "float4 main(float2 v_pos : IN_POSITION) : SV_POSITION {\n"
@@ -26,40 +29,88 @@ struct Vertex {
   float x, y;
 };
 
+struct FrameResources {
+  Com<ID3D12CommandAllocator>   allocator;
+  Com<ID3D12Resource>           renderTarget;
+  Com<ID3D11Texture2D>          d3d11RenderTarget;
+  Com<ID3D11RenderTargetView>   d3d11RenderTargetView;
+  UINT64                        fenceValue = 0;
+  bool                          timestampPending = false;
+};
+
+struct BackBuffer {
+  Com<ID3D11Texture2D>          d3d11RenderTarget;
+  Com<ID3D11RenderTargetView>   d3d11RenderTargetView;
+};
+
 class D3D11On12App {
 
 public:
 
-  D3D11On12App(HINSTANCE hInstance, int nCmdShow) {
+  D3D11On12App(HINSTANCE hInstance, int nCmdShow, uint32_t width, uint32_t height,
+      uint32_t framesInFlight, bool direct, bool benchmark)
+  : m_width(width), m_height(height),
+    m_framesInFlight(std::clamp(framesInFlight, 1u, MaxFramesInFlight)),
+    m_direct(direct), m_benchmark(benchmark) {
     m_initialized =
       createWindow(hInstance, nCmdShow) &&
       createDXGIFactory() &&
       createD3D12Device() &&
       createD3D12CommandList() &&
       createD3D12Resources() &&
+      createD3D12Queries() &&
       createD3D11On12Device() &&
       createD3D11Resources() &&
-      createDXGISwapChain();
+      createDXGISwapChain() &&
+      createD3D11BackBuffers();
   }
 
   ~D3D11On12App() {
+    if (m_d3d12Fence && m_d3d12Event)
+      waitForFence(m_fenceValue);
+
     if (m_d3d12Event)
       CloseHandle(m_d3d12Event);
   }
 
   bool renderFrame() {
-    m_d3d12Allocator->Reset();
-    m_d3d12CommandList->Reset(m_d3d12Allocator.ptr(), nullptr);
+    auto& frame = m_frames[m_frameIndex];
 
-    // Use D3D11 to render to the shared image
-    std::vector<ID3D11Resource*> resources = { m_d3d11RenderTarget.ptr(), m_d3d11VertexBuffer.ptr(), m_d3d11IndexBuffer.ptr() };
+    // Make sure the GPU is done with the resources of this frame slot
+    waitForFence(frame.fenceValue);
+    readGpuTime(m_frameIndex);
+
+    frame.allocator->Reset();
+
+    // Write the start timestamp before any D3D11 work gets submitted
+    m_d3d12CommandList->Reset(frame.allocator.ptr(), nullptr);
+    m_d3d12CommandList->EndQuery(m_d3d12QueryHeap.ptr(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * m_frameIndex);
+    m_d3d12CommandList->Close();
+
+    ID3D12CommandList* cmdList = m_d3d12CommandList.ptr();
+    m_d3d12Queue->ExecuteCommandLists(1, &cmdList);
+
+    m_d3d12CommandList->Reset(frame.allocator.ptr(), nullptr);
+
+    // Either render to the shared image, or directly to the back buffer
+    UINT backBufferIndex = m_dxgiSwapChain->GetCurrentBackBufferIndex();
+
+    ID3D11Resource* renderTarget = m_direct
+      ? m_backBuffers[backBufferIndex].d3d11RenderTarget.ptr()
+      : frame.d3d11RenderTarget.ptr();
+
+    ID3D11RenderTargetView* renderTargetView = m_direct
+      ? m_backBuffers[backBufferIndex].d3d11RenderTargetView.ptr()
+      : frame.d3d11RenderTargetView.ptr();
+
+    std::vector<ID3D11Resource*> resources = { renderTarget, m_d3d11VertexBuffer.ptr(), m_d3d11IndexBuffer.ptr() };
 
     m_d3d11on12Device->AcquireWrappedResources(resources.data(), resources.size());
     m_d3d11Context->ClearState();
 
     FLOAT color[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
-    m_d3d11Context->OMSetRenderTargets(1, &m_d3d11RenderTargetView, nullptr);
-    m_d3d11Context->ClearRenderTargetView(m_d3d11RenderTargetView.ptr(), color);
+    m_d3d11Context->OMSetRenderTargets(1, &renderTargetView, nullptr);
+    m_d3d11Context->ClearRenderTargetView(renderTargetView, color);
 
     m_d3d11Context->VSSetShader(m_d3d11VertexShader.ptr(), nullptr, 0);
     m_d3d11Context->PSSetShader(m_d3d11PixelShader.ptr(), nullptr, 0);
@@ -70,8 +121,8 @@ public:
     D3D11_VIEWPORT viewport;
     viewport.TopLeftX = 0.0f;
     viewport.TopLeftY = 0.0f;
-    viewport.Width = 1280.0f;
-    viewport.Height = 720.0f;
+    viewport.Width = float(m_width);
+    viewport.Height = float(m_height);
     viewport.MinDepth = 0.0f;
     viewport.MaxDepth = 1.0f;
     m_d3d11Context->RSSetViewports(1, &viewport);
@@ -86,10 +137,44 @@ public:
     m_d3d11on12Device->ReleaseWrappedResources(resources.data(), resources.size());
     m_d3d11Context->Flush();
 
-    // Copy the shared image to the D3D12 swap chain
+    if (!m_direct && !copyToBackBuffer(frame, backBufferIndex))
+      return false;
+
+    m_d3d12CommandList->EndQuery(m_d3d12QueryHeap.ptr(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * m_frameIndex + 1);
+    m_d3d12CommandList->ResolveQueryData(m_d3d12QueryHeap.ptr(), D3D12_QUERY_TYPE_TIMESTAMP,
+      2 * m_frameIndex, 2, m_d3d12QueryBuffer.ptr(), 2 * sizeof(UINT64) * m_frameIndex);
+    m_d3d12CommandList->Close();
+
+    m_d3d12Queue->ExecuteCommandLists(1, &cmdList);
+
+    m_dxgiSwapChain->Present(m_benchmark ? 0 : 1, 0);
+
+    frame.fenceValue = ++m_fenceValue;
+    frame.timestampPending = true;
+    m_d3d12Queue->Signal(m_d3d12Fence.ptr(), frame.fenceValue);
+
+    // With a single frame in flight, just stall at the end of each frame
+    if (m_framesInFlight == 1)
+      waitForFence(frame.fenceValue);
+
+    m_frameIndex = (m_frameIndex + 1) % m_framesInFlight;
+
+    m_frameStats.add(m_frameTimer.ms());
+    m_frameTimer.reset();
+
+    if (m_frameStats.count() == ReportInterval && !m_benchmark) {
+      printFrameStats();
+      m_frameStats.clear();
+      m_gpuStats.clear();
+    }
+
+    return true;
+  }
+
+  bool copyToBackBuffer(FrameResources& frame, UINT backBufferIndex) {
     Com<ID3D12Resource> backBuffer;
 
-    if (FAILED(m_dxgiSwapChain->GetBuffer(m_dxgiSwapChain->GetCurrentBackBufferIndex(), IID_PPV_ARGS(&backBuffer)))) {
+    if (FAILED(m_dxgiSwapChain->GetBuffer(backBufferIndex, IID_PPV_ARGS(&backBuffer)))) {
       std::cerr << "Failed to acquire back buffer" << std::endl;
       return false;
     }
@@ -109,7 +194,7 @@ public:
     dstRegion.SubresourceIndex = 0;
 
     D3D12_TEXTURE_COPY_LOCATION srcRegion = { };
-    srcRegion.pResource = m_d3d12RenderTarget.ptr();
+    srcRegion.pResource = frame.renderTarget.ptr();
     srcRegion.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
     srcRegion.SubresourceIndex = 0;
 
@@ -117,7 +202,7 @@ public:
 
     D3D12_RESOURCE_BARRIER postCopyBarrier = { };
     postCopyBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    postCopyBarrier.Transition.pResource = m_d3d12RenderTarget.ptr();
+    postCopyBarrier.Transition.pResource = frame.renderTarget.ptr();
     postCopyBarrier.Transition.Subresource = 0;
     postCopyBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
     postCopyBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
@@ -131,27 +216,146 @@ public:
 
     m_d3d12CommandList->ResourceBarrier(1, &postCopyBarrier);
     m_d3d12CommandList->ResourceBarrier(1, &prePresentBarrier);
-    m_d3d12CommandList->Close();
+    return true;
+  }
 
-    ID3D12CommandList* cmdList = m_d3d12CommandList.ptr();
-    m_d3d12Queue->ExecuteCommandLists(1, &cmdList);
+  void readGpuTime(uint32_t frameIndex) {
+    auto& frame = m_frames[frameIndex];
 
-    m_dxgiSwapChain->Present(1, 0);
+    if (!frame.timestampPending)
+      return;
 
-    // We're lazy with synchronization, just stall at the end of each frame
-    m_d3d12Queue->Signal(m_d3d12Fence.ptr(), ++m_frameId);
-    m_d3d12Fence->SetEventOnCompletion(m_frameId, m_d3d12Event);
+    frame.timestampPending = false;
 
-    while (WaitForSingleObject(m_d3d12Event, INFINITE))
-      continue;
+    D3D12_RANGE readRange = { 2 * sizeof(UINT64) * frameIndex, 2 * sizeof(UINT64) * (frameIndex + 1) };
+    D3D12_RANGE writeRange = { 0, 0 };
+
+    void* data = nullptr;
+
+    if (FAILED(m_d3d12QueryBuffer->Map(0, &readRange, &data)))
+      return;
+
+    auto timestamps = reinterpret_cast<const UINT64*>(data) + 2 * frameIndex;
+
+    if (m_timestampFrequency && timestamps[1] > timestamps[0])
+      m_gpuStats.add(double(timestamps[1] - timestamps[0]) * 1000.0 / double(m_timestampFrequency));
+
+    m_d3d12QueryBuffer->Unmap(0, &writeRange);
+  }
+
+  void readAllGpuTimes() {
+    waitForFence(m_fenceValue);
+
+    for (uint32_t i = 0; i < MaxFramesInFlight; i++)
+      readGpuTime(i);
+  }
+
+  void printFrameStats() {
+    std::cout << (m_direct ? "Direct" : "Copy") << ", frames in flight: " << m_framesInFlight
+              << ", frame time avg " << m_frameStats.avg() << " ms"
+              << ", p50 " << m_frameStats.percentile(50.0) << " ms"
+              << ", p99 " << m_frameStats.percentile(99.0) << " ms"
+              << ", GPU time avg " << m_gpuStats.avg() << " ms"
+              << ", p50 " << m_gpuStats.percentile(50.0) << " ms" << std::endl;
+  }
+
+  int runBenchmark() {
+    // Indexed by [direct][frames in flight - 1]
+    std::array<std::array<double, MaxFramesInFlight>, 2> frameTimes = { };
+    std::array<std::array<double, MaxFramesInFlight>, 2> gpuTimes = { };
+
+    for (uint32_t d = 0; d < 2; d++) {
+      for (uint32_t i = 1; i <= MaxFramesInFlight; i++) {
+        waitForFence(m_fenceValue);
+
+        m_direct = d != 0;
+        m_framesInFlight = i;
+        m_frameIndex = 0;
+
+        // Warm up before measuring
+        for (uint32_t j = 0; j < BenchmarkWarmupFrames; j++) {
+          if (!pumpMessages() || !renderFrame())
+            return 1;
+        }
+
+        readAllGpuTimes();
+
+        m_frameStats.clear();
+        m_gpuStats.clear();
+        m_frameTimer.reset();
+
+        for (uint32_t j = 0; j < BenchmarkFrames; j++) {
+          if (!pumpMessages() || !renderFrame())
+            return 1;
+        }
+
+        readAllGpuTimes();
+        printFrameStats();
+
+        frameTimes[d][i - 1] = m_frameStats.avg();
+        gpuTimes[d][i - 1] = m_gpuStats.avg();
+      }
+    }
+
+    for (uint32_t d = 0; d < 2; d++) {
+      for (uint32_t i = 2; i <= MaxFramesInFlight; i++) {
+        std::cout << (d ? "Direct" : "Copy") << ", " << i << " frames in flight vs. stalling: "
+                  << frameTimes[d][0] / frameTimes[d][i - 1] << "x" << std::endl;
+      }
+    }
+
+    // The copy reads the shared image and writes the back buffer once per frame
+    double copyMiB = double(2 * 4 * m_width * m_height) / double(1u << 20);
+
+    for (uint32_t i = 1; i <= MaxFramesInFlight; i++) {
+      double savedMs = gpuTimes[0][i - 1] - gpuTimes[1][i - 1];
+
+      std::cout << i << " frames in flight, direct vs. copy: GPU time "
+                << gpuTimes[1][i - 1] << " ms vs. " << gpuTimes[0][i - 1] << " ms"
+                << ", frame time " << frameTimes[1][i - 1] << " ms vs. " << frameTimes[0][i - 1] << " ms" << std::endl;
+
+      if (savedMs > 0.0) {
+        std::cout << "  Avoided " << copyMiB << " MiB of copy traffic per frame, "
+                  << (copyMiB / 1024.0) / (savedMs / 1000.0) << " GiB/s effective copy bandwidth" << std::endl;
+      }
+    }
+
+    return 0;
+  }
+
+  bool pumpMessages() {
+    MSG msg;
+
+    while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+      TranslateMessage(&msg);
+      DispatchMessageW(&msg);
+
+      if (msg.message == WM_QUIT)
+        return false;
+    }
 
     return true;
   }
 
+  void waitForFence(UINT64 value) {
+    if (m_d3d12Fence->GetCompletedValue() >= value)
+      return;
+
+    m_d3d12Fence->SetEventOnCompletion(value, m_d3d12Event);
+
+    while (WaitForSingleObject(m_d3d12Event, INFINITE))
+      continue;
+  }
+
   int run() {
     if (!m_initialized)
       return 1;
 
+    if (m_benchmark)
+      return runBenchmark();
+
+    m_frameTimer.reset();
+
     MSG msg;
 
     while (true) {
@@ -173,6 +377,12 @@ public:
 
 private:
 
+  constexpr static uint32_t MaxFramesInFlight     = 3;
+  constexpr static uint32_t ReportInterval        = 600;
+  constexpr static uint32_t BenchmarkWarmupFrames = 60;
+  constexpr static uint32_t BenchmarkFrames       = 1000;
+  constexpr static uint32_t SwapChainBufferCount  = 3;
+
   HWND                            m_window = nullptr;
 
   Com<IDXGIFactory6>              m_dxgiFactory;
@@ -184,26 +394,39 @@ private:
   Com<ID3D11On12Device>           m_d3d11on12Device;
   Com<ID3D11Buffer>               m_d3d11VertexBuffer;
   Com<ID3D11Buffer>               m_d3d11IndexBuffer;
-  Com<ID3D11Texture2D>            m_d3d11RenderTarget;
-  Com<ID3D11RenderTargetView>     m_d3d11RenderTargetView;
   Com<ID3D11VertexShader>         m_d3d11VertexShader;
   Com<ID3D11PixelShader>          m_d3d11PixelShader;
   Com<ID3D11InputLayout>          m_d3d11InputLayout;
 
   Com<ID3D12Device>               m_d3d12Device;
   Com<ID3D12CommandQueue>         m_d3d12Queue;
-  Com<ID3D12CommandAllocator>     m_d3d12Allocator;
   Com<ID3D12GraphicsCommandList>  m_d3d12CommandList;
-  Com<ID3D12Resource>             m_d3d12RenderTarget;
   Com<ID3D12Heap>                 m_d3d12Heap;
   Com<ID3D12Resource>             m_d3d12VertexBuffer;
   Com<ID3D12Resource>             m_d3d12IndexBuffer;
   Com<ID3D12Fence>                m_d3d12Fence;
+  Com<ID3D12QueryHeap>            m_d3d12QueryHeap;
+  Com<ID3D12Resource>             m_d3d12QueryBuffer;
 
   HANDLE                          m_d3d12Event = nullptr;
+  UINT64                          m_timestampFrequency = 0;
+
+  std::array<FrameResources, MaxFramesInFlight> m_frames;
+  std::array<BackBuffer, SwapChainBufferCount> m_backBuffers;
+
+  uint32_t                        m_width = 0;
+  uint32_t                        m_height = 0;
 
-  UINT64                          m_frameId = 0;
+  uint32_t                        m_framesInFlight = 1;
+  uint32_t                        m_frameIndex = 0;
+  UINT64                          m_fenceValue = 0;
 
+  Timer                           m_frameTimer;
+  Stats                           m_frameStats;
+  Stats                           m_gpuStats;
+
+  bool m_direct = false;
+  bool m_benchmark = false;
   bool m_initialized = false;
 
   bool createWindow(HINSTANCE hInstance, int nCmdShow) {
@@ -218,7 +441,7 @@ private:
     RegisterClassExW(&wc);
 
     m_window = CreateWindowExW(0, L"WindowClass", L"D3D11on12 triangle",
-      WS_OVERLAPPEDWINDOW, 300, 300, 1280, 720,
+      WS_OVERLAPPEDWINDOW, 300, 300, m_width, m_height,
       nullptr, nullptr, hInstance, nullptr);
     ShowWindow(m_window, nCmdShow);
 
@@ -266,21 +489,28 @@ private:
   }
 
   bool createD3D12CommandList() {
-    HRESULT hr = m_d3d12Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_d3d12Allocator));
+    HRESULT hr;
 
-    if (FAILED(hr)) {
-      std::cerr << "Failed to create D3D12 command allocator" << std::endl;
-      return false;
+    for (auto& frame : m_frames) {
+      hr = m_d3d12Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&frame.allocator));
+
+      if (FAILED(hr)) {
+        std::cerr << "Failed to create D3D12 command allocator" << std::endl;
+        return false;
+      }
     }
 
     hr = m_d3d12Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
-      m_d3d12Allocator.ptr(), nullptr, IID_PPV_ARGS(&m_d3d12CommandList));
+      m_frames[0].allocator.ptr(), nullptr, IID_PPV_ARGS(&m_d3d12CommandList));
 
     if (FAILED(hr)) {
       std::cerr << "Failed to create D3D12 command list" << std::endl;
       return false;
     }
 
+    // Command lists are created in the recording state
+    m_d3d12CommandList->Close();
+
     hr = m_d3d12Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_d3d12Fence));
 
     if (FAILED(hr)) {
@@ -304,8 +534,8 @@ private:
 
     D3D12_RESOURCE_DESC rtDesc = { };
     rtDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    rtDesc.Width = 1280;
-    rtDesc.Height = 720;
+    rtDesc.Width = m_width;
+    rtDesc.Height = m_height;
     rtDesc.DepthOrArraySize = 1;
     rtDesc.MipLevels = 1;
     rtDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
@@ -313,12 +543,16 @@ private:
     rtDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
     rtDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
 
-    HRESULT hr = m_d3d12Device->CreateCommittedResource(&deviceHeapProperties, D3D12_HEAP_FLAG_NONE, &rtDesc,
-      D3D12_RESOURCE_STATE_RENDER_TARGET, nullptr, IID_PPV_ARGS(&m_d3d12RenderTarget));
+    HRESULT hr;
 
-    if (FAILED(hr)) {
-      std::cerr << "Failed to create D3D12 render target" << std::endl;
-      return false;
+    for (auto& frame : m_frames) {
+      hr = m_d3d12Device->CreateCommittedResource(&deviceHeapProperties, D3D12_HEAP_FLAG_NONE, &rtDesc,
+        D3D12_RESOURCE_STATE_RENDER_TARGET, nullptr, IID_PPV_ARGS(&frame.renderTarget));
+
+      if (FAILED(hr)) {
+        std::cerr << "Failed to create D3D12 render target" << std::endl;
+        return false;
+      }
     }
 
     D3D12_HEAP_DESC heapDesc = { };
@@ -362,6 +596,44 @@ private:
     return true;
   }
 
+  bool createD3D12Queries() {
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = { };
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = 2 * MaxFramesInFlight;
+
+    HRESULT hr = m_d3d12Device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_d3d12QueryHeap));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 query heap" << std::endl;
+      return false;
+    }
+
+    D3D12_HEAP_PROPERTIES readbackHeapProperties = { };
+    readbackHeapProperties.Type = D3D12_HEAP_TYPE_READBACK;
+
+    D3D12_RESOURCE_DESC bufferDesc = { };
+    bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Width = 2 * sizeof(UINT64) * MaxFramesInFlight;
+    bufferDesc.Height = 1;
+    bufferDesc.DepthOrArraySize = 1;
+    bufferDesc.SampleDesc = { 1, 0 };
+    bufferDesc.MipLevels = 1;
+    bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    hr = m_d3d12Device->CreateCommittedResource(&readbackHeapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+      D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_d3d12QueryBuffer));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 query buffer" << std::endl;
+      return false;
+    }
+
+    if (FAILED(m_d3d12Queue->GetTimestampFrequency(&m_timestampFrequency)))
+      std::cerr << "Failed to query timestamp frequency, GPU times unavailable" << std::endl;
+
+    return true;
+  }
+
   bool createD3D11On12Device() {
     Com<IUnknown> commandQueue = m_d3d12Queue.ptr();
 
@@ -387,22 +659,26 @@ private:
   bool createD3D11Resources() {
     D3D11_RESOURCE_FLAGS d3d11Flags = { D3D11_BIND_RENDER_TARGET };
 
-    HRESULT hr = m_d3d11on12Device->CreateWrappedResource(
-      m_d3d12RenderTarget.ptr(), &d3d11Flags,
-      D3D12_RESOURCE_STATE_RENDER_TARGET,
-      D3D12_RESOURCE_STATE_COPY_SOURCE,
-      IID_PPV_ARGS(&m_d3d11RenderTarget));
+    HRESULT hr;
 
-    if (FAILED(hr)) {
-      std::cerr << "Failed to create D3D11 render target" << std::endl;
-      return false;
-    }
+    for (auto& frame : m_frames) {
+      hr = m_d3d11on12Device->CreateWrappedResource(
+        frame.renderTarget.ptr(), &d3d11Flags,
+        D3D12_RESOURCE_STATE_RENDER_TARGET,
+        D3D12_RESOURCE_STATE_COPY_SOURCE,
+        IID_PPV_ARGS(&frame.d3d11RenderTarget));
 
-    hr = m_d3d11Device->CreateRenderTargetView(m_d3d11RenderTarget.ptr(), nullptr, &m_d3d11RenderTargetView);
+      if (FAILED(hr)) {
+        std::cerr << "Failed to create D3D11 render target" << std::endl;
+        return false;
+      }
 
-    if (FAILED(hr)) {
-      std::cerr << "Failed to create D3D11 render target view" << std::endl;
-      return false;
+      hr = m_d3d11Device->CreateRenderTargetView(frame.d3d11RenderTarget.ptr(), nullptr, &frame.d3d11RenderTargetView);
+
+      if (FAILED(hr)) {
+        std::cerr << "Failed to create D3D11 render target view" << std::endl;
+        return false;
+      }
     }
 
     d3d11Flags = { D3D11_BIND_VERTEX_BUFFER };
@@ -502,12 +778,12 @@ private:
     Com<IDXGISwapChain1> swapChain;
 
     DXGI_SWAP_CHAIN_DESC1 swapChainDesc = { };
-    swapChainDesc.Width = 1280;
-    swapChainDesc.Height = 720;
+    swapChainDesc.Width = m_width;
+    swapChainDesc.Height = m_height;
     swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
     swapChainDesc.SampleDesc = { 1, 0 };
     swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    swapChainDesc.BufferCount = 3;
+    swapChainDesc.BufferCount = SwapChainBufferCount;
     swapChainDesc.Scaling = DXGI_SCALING_NONE;
     swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
     swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
@@ -528,6 +804,47 @@ private:
     return true;
   }
 
+  bool createD3D11BackBuffers() {
+    D3D11_RESOURCE_FLAGS d3d11Flags = { D3D11_BIND_RENDER_TARGET };
+
+    // Wrap back buffers so that D3D11 can render to them without
+    // the intermediate image. Render through an sRGB view so that
+    // output matches the sRGB image copied in the other mode.
+    D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = { };
+    rtvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+
+    for (uint32_t i = 0; i < SwapChainBufferCount; i++) {
+      Com<ID3D12Resource> backBuffer;
+
+      if (FAILED(m_dxgiSwapChain->GetBuffer(i, IID_PPV_ARGS(&backBuffer)))) {
+        std::cerr << "Failed to query back buffer" << std::endl;
+        return false;
+      }
+
+      HRESULT hr = m_d3d11on12Device->CreateWrappedResource(
+        backBuffer.ptr(), &d3d11Flags,
+        D3D12_RESOURCE_STATE_PRESENT,
+        D3D12_RESOURCE_STATE_PRESENT,
+        IID_PPV_ARGS(&m_backBuffers[i].d3d11RenderTarget));
+
+      if (FAILED(hr)) {
+        std::cerr << "Failed to wrap back buffer" << std::endl;
+        return false;
+      }
+
+      hr = m_d3d11Device->CreateRenderTargetView(m_backBuffers[i].d3d11RenderTarget.ptr(),
+        &rtvDesc, &m_backBuffers[i].d3d11RenderTargetView);
+
+      if (FAILED(hr)) {
+        std::cerr << "Failed to create back buffer render target view" << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+
   static LRESULT CALLBACK windowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
     switch (message) {
       case WM_CLOSE:
@@ -544,6 +861,29 @@ int WINAPI WinMain(HINSTANCE hInstance,
                    HINSTANCE hPrevInstance,
                    LPSTR lpCmdLine,
                    int nCmdShow) {
-  D3D11On12App app(hInstance, nCmdShow);
+  // Usage: d3d11-on-12 [frames in flight (1-3)] [direct] [4k] [bench]
+  uint32_t framesInFlight = 1;
+  uint32_t width = 1280;
+  uint32_t height = 720;
+  bool direct = false;
+  bool benchmark = false;
+
+  if (lpCmdLine) {
+    std::stringstream args(lpCmdLine);
+    std::string arg;
+
+    while (args >> arg) {
+      if (arg == "bench")
+        benchmark = true;
+      else if (arg == "direct")
+        direct = true;
+      else if (arg == "4k")
+        width = 3840, height = 2160;
+      else if (arg.size() == 1 && arg[0] >= '1' && arg[0] <= '9')
+        framesInFlight = uint32_t(arg[0] - '0');
+    }
+  }
+
+  D3D11On12App app(hInstance, nCmdShow, width, height, framesInFlight, direct, benchmark);
   return app.run();
 }
@@ -0,0 +1,399 @@
+#include <array>
+#include <iostream>
+#include <vector>
+
+#include <dxgi1_6.h>
+#include <d3d11_4.h>
+#include <d3d11on12.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/timer.h"
+
+enum class SyncMode : uint32_t {
+  QueueOrder,
+  AcquireRelease,
+  SharedFence,
+};
+
+class D3D11On12SyncApp {
+
+public:
+
+  D3D11On12SyncApp() {
+    m_initialized =
+      createDevices() &&
+      createSharedFence() &&
+      createResources() &&
+      createD3D12CommandList();
+  }
+
+  ~D3D11On12SyncApp() {
+    if (m_event)
+      CloseHandle(m_event);
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    for (auto mode : { SyncMode::QueueOrder, SyncMode::AcquireRelease, SyncMode::SharedFence })
+      runTest(mode);
+
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t BufferSize          = 1u << 16;
+  constexpr static uint32_t LatencySamples      = 1000;
+  constexpr static uint32_t RoundTripsPerFrame  = 100;
+  constexpr static uint32_t FrameCount          = 100;
+
+  Com<IDXGIFactory6>              m_dxgiFactory;
+  Com<IDXGIAdapter4>              m_dxgiAdapter;
+
+  Com<ID3D11Device5>              m_d3d11Device;
+  Com<ID3D11DeviceContext4>       m_d3d11Context;
+  Com<ID3D11On12Device>           m_d3d11on12Device;
+  Com<ID3D11Fence>                m_d3d11Fence;
+
+  Com<ID3D11Buffer>               m_d3d11SharedBuffer;
+  Com<ID3D11Buffer>               m_d3d11WrappedBuffer;
+  Com<ID3D11UnorderedAccessView>  m_d3d11SharedBufferView;
+  Com<ID3D11UnorderedAccessView>  m_d3d11WrappedBufferView;
+
+  Com<ID3D12Device>               m_d3d12Device;
+  Com<ID3D12CommandQueue>         m_d3d12Queue;
+  Com<ID3D12CommandQueue>         m_d3d12SyncQueue;
+  Com<ID3D12CommandAllocator>     m_d3d12Allocator;
+  Com<ID3D12GraphicsCommandList>  m_d3d12CommandList;
+  Com<ID3D12Fence>                m_d3d12Fence;
+
+  Com<ID3D12Resource>             m_d3d12Buffer;
+  Com<ID3D12Resource>             m_d3d12CopyBuffer;
+
+  HANDLE                          m_event = nullptr;
+  UINT64                          m_fenceValue = 0;
+
+  bool m_initialized = false;
+
+  bool createDevices() {
+    HRESULT hr = CreateDXGIFactory2(0, IID_PPV_ARGS(&m_dxgiFactory));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create DXGI factory" << std::endl;
+      return false;
+    }
+
+    hr = m_dxgiFactory->EnumAdapterByGpuPreference(0,
+      DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE, IID_PPV_ARGS(&m_dxgiAdapter));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to query DXGI adapter" << std::endl;
+      return false;
+    }
+
+    hr = D3D12CreateDevice(m_dxgiAdapter.ptr(), D3D_FEATURE_LEVEL_11_1, IID_PPV_ARGS(&m_d3d12Device));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 device" << std::endl;
+      return false;
+    }
+
+    D3D12_COMMAND_QUEUE_DESC queueDesc = { };
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+
+    if (FAILED(m_d3d12Device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_d3d12Queue)))
+     || FAILED(m_d3d12Device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_d3d12SyncQueue)))) {
+      std::cerr << "Failed to create D3D12 command queues" << std::endl;
+      return false;
+    }
+
+    Com<IUnknown> commandQueue = m_d3d12Queue.ptr();
+    Com<ID3D11Device> device;
+    Com<ID3D11DeviceContext> context;
+
+    hr = D3D11On12CreateDevice(
+      m_d3d12Device.ptr(), 0, nullptr, 0,
+      &commandQueue, 1, 0, &device, &context, nullptr);
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return false;
+    }
+
+    if (FAILED(device->QueryInterface(IID_PPV_ARGS(&m_d3d11Device)))
+     || FAILED(context->QueryInterface(IID_PPV_ARGS(&m_d3d11Context)))) {
+      std::cerr << "Failed to query ID3D11Device5 or ID3D11DeviceContext4 interface" << std::endl;
+      return false;
+    }
+
+    hr = m_d3d11Device->QueryInterface(IID_PPV_ARGS(&m_d3d11on12Device));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to retrieve ID3D11On12Device interface" << std::endl;
+      return false;
+    }
+
+    m_event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+
+    if (!m_event) {
+      std::cerr << "Failed to create fence event" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool createSharedFence() {
+    HRESULT hr = m_d3d12Device->CreateFence(0, D3D12_FENCE_FLAG_SHARED, IID_PPV_ARGS(&m_d3d12Fence));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 fence" << std::endl;
+      return false;
+    }
+
+    HANDLE handle = nullptr;
+    hr = m_d3d12Device->CreateSharedHandle(m_d3d12Fence.ptr(), nullptr, GENERIC_ALL, nullptr, &handle);
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create shared fence handle" << std::endl;
+      return false;
+    }
+
+    hr = m_d3d11Device->OpenSharedFence(handle, IID_PPV_ARGS(&m_d3d11Fence));
+    CloseHandle(handle);
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to open shared fence" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool createResources() {
+    D3D12_HEAP_PROPERTIES heapProperties = { };
+    heapProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    D3D12_RESOURCE_DESC bufferDesc = { };
+    bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Width = BufferSize;
+    bufferDesc.Height = 1;
+    bufferDesc.DepthOrArraySize = 1;
+    bufferDesc.SampleDesc = { 1, 0 };
+    bufferDesc.MipLevels = 1;
+    bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+    // Buffers decay to the common state and get promoted implicitly,
+    // so D3D12 can copy from this after D3D11 wrote it in any mode.
+    HRESULT hr = m_d3d12Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_SHARED, &bufferDesc,
+      D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&m_d3d12Buffer));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 buffer" << std::endl;
+      return false;
+    }
+
+    bufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    hr = m_d3d12Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+      D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_d3d12CopyBuffer));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 copy buffer" << std::endl;
+      return false;
+    }
+
+    // D3D11 accesses the buffer D3D12 copies from in every mode. The
+    // wrapped resource requires Acquire/ReleaseWrappedResources, while
+    // the shared resource relies on queue order or the shared fence.
+    D3D11_RESOURCE_FLAGS d3d11Flags = { D3D11_BIND_UNORDERED_ACCESS };
+
+    hr = m_d3d11on12Device->CreateWrappedResource(
+      m_d3d12Buffer.ptr(), &d3d11Flags,
+      D3D12_RESOURCE_STATE_COMMON,
+      D3D12_RESOURCE_STATE_COMMON,
+      IID_PPV_ARGS(&m_d3d11WrappedBuffer));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create wrapped buffer" << std::endl;
+      return false;
+    }
+
+    HANDLE handle = nullptr;
+    hr = m_d3d12Device->CreateSharedHandle(m_d3d12Buffer.ptr(), nullptr, GENERIC_ALL, nullptr, &handle);
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create shared buffer handle" << std::endl;
+      return false;
+    }
+
+    hr = m_d3d11Device->OpenSharedResource1(handle, IID_PPV_ARGS(&m_d3d11SharedBuffer));
+    CloseHandle(handle);
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to open shared buffer" << std::endl;
+      return false;
+    }
+
+    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = { };
+    uavDesc.Format = DXGI_FORMAT_R32_UINT;
+    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    uavDesc.Buffer.NumElements = BufferSize / sizeof(uint32_t);
+
+    if (FAILED(m_d3d11Device->CreateUnorderedAccessView(m_d3d11SharedBuffer.ptr(), &uavDesc, &m_d3d11SharedBufferView))
+     || FAILED(m_d3d11Device->CreateUnorderedAccessView(m_d3d11WrappedBuffer.ptr(), &uavDesc, &m_d3d11WrappedBufferView))) {
+      std::cerr << "Failed to create D3D11 unordered access views" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool createD3D12CommandList() {
+    HRESULT hr = m_d3d12Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_d3d12Allocator));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 command allocator" << std::endl;
+      return false;
+    }
+
+    hr = m_d3d12Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+      m_d3d12Allocator.ptr(), nullptr, IID_PPV_ARGS(&m_d3d12CommandList));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 command list" << std::endl;
+      return false;
+    }
+
+    // The same command list gets executed for every handoff
+    m_d3d12CommandList->CopyBufferRegion(m_d3d12CopyBuffer.ptr(), 0, m_d3d12Buffer.ptr(), 0, BufferSize);
+    m_d3d12CommandList->Close();
+    return true;
+  }
+
+  /**
+    * \brief Submits one D3D11 -> D3D12 -> D3D11 round trip
+    *
+    * D3D11 clears a buffer, D3D12 copies from that same buffer,
+    * then D3D11 clears it again and signals completion, so that
+    * every mode hands the buffer over in both directions. The
+    * handoffs rely on submission order on the shared queue, on
+    * Acquire/ReleaseWrappedResources, or on a shared fence with
+    * D3D12 work on a separate queue, depending on the mode.
+    * \returns Fence value that signals completion
+    */
+  UINT64 submitRoundTrip(SyncMode mode) {
+    UINT clearValue[4] = { uint32_t(m_fenceValue), 0, 0, 0 };
+    ID3D12CommandList* cmdList = m_d3d12CommandList.ptr();
+
+    switch (mode) {
+      case SyncMode::QueueOrder: {
+        m_d3d11Context->ClearUnorderedAccessViewUint(m_d3d11SharedBufferView.ptr(), clearValue);
+        m_d3d11Context->Flush();
+
+        m_d3d12Queue->ExecuteCommandLists(1, &cmdList);
+
+        m_d3d11Context->ClearUnorderedAccessViewUint(m_d3d11SharedBufferView.ptr(), clearValue);
+        m_d3d11Context->Signal(m_d3d11Fence.ptr(), ++m_fenceValue);
+        m_d3d11Context->Flush();
+      } break;
+
+      case SyncMode::AcquireRelease: {
+        ID3D11Resource* resource = m_d3d11WrappedBuffer.ptr();
+
+        m_d3d11on12Device->AcquireWrappedResources(&resource, 1);
+        m_d3d11Context->ClearUnorderedAccessViewUint(m_d3d11WrappedBufferView.ptr(), clearValue);
+        m_d3d11on12Device->ReleaseWrappedResources(&resource, 1);
+        m_d3d11Context->Flush();
+
+        m_d3d12Queue->ExecuteCommandLists(1, &cmdList);
+
+        m_d3d11on12Device->AcquireWrappedResources(&resource, 1);
+        m_d3d11Context->ClearUnorderedAccessViewUint(m_d3d11WrappedBufferView.ptr(), clearValue);
+        m_d3d11on12Device->ReleaseWrappedResources(&resource, 1);
+        m_d3d11Context->Signal(m_d3d11Fence.ptr(), ++m_fenceValue);
+        m_d3d11Context->Flush();
+      } break;
+
+      case SyncMode::SharedFence: {
+        m_d3d11Context->ClearUnorderedAccessViewUint(m_d3d11SharedBufferView.ptr(), clearValue);
+        m_d3d11Context->Signal(m_d3d11Fence.ptr(), ++m_fenceValue);
+        m_d3d11Context->Flush();
+
+        m_d3d12SyncQueue->Wait(m_d3d12Fence.ptr(), m_fenceValue);
+        m_d3d12SyncQueue->ExecuteCommandLists(1, &cmdList);
+        m_d3d12SyncQueue->Signal(m_d3d12Fence.ptr(), ++m_fenceValue);
+
+        m_d3d11Context->Wait(m_d3d11Fence.ptr(), m_fenceValue);
+        m_d3d11Context->ClearUnorderedAccessViewUint(m_d3d11SharedBufferView.ptr(), clearValue);
+        m_d3d11Context->Signal(m_d3d11Fence.ptr(), ++m_fenceValue);
+        m_d3d11Context->Flush();
+      } break;
+    }
+
+    return m_fenceValue;
+  }
+
+  void waitForFence(UINT64 value) {
+    if (m_d3d12Fence->GetCompletedValue() >= value)
+      return;
+
+    m_d3d12Fence->SetEventOnCompletion(value, m_event);
+
+    while (WaitForSingleObject(m_event, INFINITE))
+      continue;
+  }
+
+  void runTest(SyncMode mode) {
+    static const std::array<const char*, 3> s_modeNames = {{
+      "Queue order", "Acquire/Release", "Shared fence",
+    }};
+
+    // Serialized round trips, the CPU waits for each one
+    Stats latencyStats;
+
+    for (uint32_t i = 0; i < LatencySamples; i++) {
+      Timer timer;
+      waitForFence(submitRoundTrip(mode));
+      latencyStats.add(timer.us());
+    }
+
+    // Pipelined round trips, the CPU only waits once per frame
+    Stats frameStats;
+
+    for (uint32_t i = 0; i < FrameCount; i++) {
+      Timer timer;
+      UINT64 value = 0;
+
+      for (uint32_t j = 0; j < RoundTripsPerFrame; j++)
+        value = submitRoundTrip(mode);
+
+      waitForFence(value);
+      frameStats.add(timer.us());
+    }
+
+    double transitionsPerFrame = double(2 * RoundTripsPerFrame);
+
+    std::cout << s_modeNames[uint32_t(mode)] << ":" << std::endl
+              << "  Round trip latency: avg " << latencyStats.avg() << " us"
+              << ", p50 " << latencyStats.percentile(50.0) << " us"
+              << ", p99 " << latencyStats.percentile(99.0) << " us"
+              << ", max " << latencyStats.max() << " us" << std::endl
+              << "  Pipelined: " << RoundTripsPerFrame << " round trips in " << frameStats.avg() << " us"
+              << ", " << frameStats.avg() / transitionsPerFrame << " us per transition" << std::endl;
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  D3D11On12SyncApp app;
+  return app.run();
+}
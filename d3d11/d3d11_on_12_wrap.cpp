@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <dxgi1_6.h>
+#include <d3d11on12.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/timer.h"
+
+class D3D11On12WrapApp {
+
+public:
+
+  D3D11On12WrapApp() {
+    m_initialized =
+      createDevices() &&
+      createResources();
+  }
+
+  ~D3D11On12WrapApp() {
+    if (m_d3d12Event)
+      CloseHandle(m_d3d12Event);
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    std::cout << "Wrapped " << MaxResourceCount << " resources, "
+              << (m_wrapTime / double(MaxResourceCount)) << " us per CreateWrappedResource" << std::endl;
+
+    for (uint32_t resourceCount : { 1u, 10u, 100u, 1000u }) {
+      for (uint32_t batchSize : { 1u, 16u, 64u }) {
+        if (batchSize < resourceCount)
+          runTest(resourceCount, batchSize);
+      }
+
+      // Acquire everything with a single call
+      runTest(resourceCount, resourceCount);
+    }
+
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t MaxResourceCount = 1000;
+  constexpr static uint32_t FrameCount       = 200;
+
+  Com<IDXGIFactory6>              m_dxgiFactory;
+  Com<IDXGIAdapter4>              m_dxgiAdapter;
+
+  Com<ID3D11Device>               m_d3d11Device;
+  Com<ID3D11DeviceContext>        m_d3d11Context;
+  Com<ID3D11On12Device>           m_d3d11on12Device;
+
+  Com<ID3D12Device>               m_d3d12Device;
+  Com<ID3D12CommandQueue>         m_d3d12Queue;
+  Com<ID3D12Fence>                m_d3d12Fence;
+
+  HANDLE                          m_d3d12Event = nullptr;
+  UINT64                          m_fenceValue = 0;
+
+  std::vector<Com<ID3D12Resource>> m_d3d12Resources;
+  std::vector<Com<ID3D11Resource>> m_d3d11Resources;
+
+  double                          m_wrapTime = 0.0;
+
+  bool m_initialized = false;
+
+  bool createDevices() {
+    HRESULT hr = CreateDXGIFactory2(0, IID_PPV_ARGS(&m_dxgiFactory));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create DXGI factory" << std::endl;
+      return false;
+    }
+
+    hr = m_dxgiFactory->EnumAdapterByGpuPreference(0,
+      DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE, IID_PPV_ARGS(&m_dxgiAdapter));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to query DXGI adapter" << std::endl;
+      return false;
+    }
+
+    hr = D3D12CreateDevice(m_dxgiAdapter.ptr(), D3D_FEATURE_LEVEL_11_1, IID_PPV_ARGS(&m_d3d12Device));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 device" << std::endl;
+      return false;
+    }
+
+    D3D12_COMMAND_QUEUE_DESC queueDesc = { };
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+
+    hr = m_d3d12Device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_d3d12Queue));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 command queue" << std::endl;
+      return false;
+    }
+
+    hr = m_d3d12Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_d3d12Fence));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D12 fence" << std::endl;
+      return false;
+    }
+
+    m_d3d12Event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+
+    if (!m_d3d12Event) {
+      std::cerr << "Failed to create fence event" << std::endl;
+      return false;
+    }
+
+    Com<IUnknown> commandQueue = m_d3d12Queue.ptr();
+
+    hr = D3D11On12CreateDevice(
+      m_d3d12Device.ptr(), 0, nullptr, 0,
+      &commandQueue, 1, 0, &m_d3d11Device, &m_d3d11Context, nullptr);
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return false;
+    }
+
+    hr = m_d3d11Device->QueryInterface(IID_PPV_ARGS(&m_d3d11on12Device));
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to retrieve ID3D11On12Device interface" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool createResources() {
+    D3D12_HEAP_PROPERTIES heapProperties = { };
+    heapProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    D3D12_RESOURCE_DESC desc = { };
+    desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Width = 64;
+    desc.Height = 64;
+    desc.DepthOrArraySize = 1;
+    desc.MipLevels = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc = { 1, 0 };
+    desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    D3D11_RESOURCE_FLAGS d3d11Flags = { D3D11_BIND_SHADER_RESOURCE };
+
+    for (uint32_t i = 0; i < MaxResourceCount; i++) {
+      Com<ID3D12Resource> d3d12Resource;
+      Com<ID3D11Resource> d3d11Resource;
+
+      HRESULT hr = m_d3d12Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &desc,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, nullptr, IID_PPV_ARGS(&d3d12Resource));
+
+      if (FAILED(hr)) {
+        std::cerr << "Failed to create D3D12 texture" << std::endl;
+        return false;
+      }
+
+      Timer timer;
+
+      hr = m_d3d11on12Device->CreateWrappedResource(
+        d3d12Resource.ptr(), &d3d11Flags,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+        IID_PPV_ARGS(&d3d11Resource));
+
+      m_wrapTime += timer.us();
+
+      if (FAILED(hr)) {
+        std::cerr << "Failed to create wrapped resource" << std::endl;
+        return false;
+      }
+
+      m_d3d12Resources.push_back(std::move(d3d12Resource));
+      m_d3d11Resources.push_back(std::move(d3d11Resource));
+    }
+
+    return true;
+  }
+
+  void runTest(uint32_t resourceCount, uint32_t batchSize) {
+    std::vector<ID3D11Resource*> resources(resourceCount);
+
+    for (uint32_t i = 0; i < resourceCount; i++)
+      resources[i] = m_d3d11Resources[i].ptr();
+
+    Stats acquireStats;
+    Stats releaseStats;
+
+    for (uint32_t frame = 0; frame < FrameCount; frame++) {
+      for (uint32_t i = 0; i < resourceCount; i += batchSize) {
+        uint32_t count = std::min(batchSize, resourceCount - i);
+
+        Timer acquireTimer;
+        m_d3d11on12Device->AcquireWrappedResources(&resources[i], count);
+        acquireStats.add(acquireTimer.us());
+
+        Timer releaseTimer;
+        m_d3d11on12Device->ReleaseWrappedResources(&resources[i], count);
+        releaseStats.add(releaseTimer.us());
+      }
+
+      m_d3d11Context->Flush();
+
+      // Don't let the queue grow without bounds
+      m_d3d12Queue->Signal(m_d3d12Fence.ptr(), ++m_fenceValue);
+      m_d3d12Fence->SetEventOnCompletion(m_fenceValue, m_d3d12Event);
+
+      while (WaitForSingleObject(m_d3d12Event, INFINITE))
+        continue;
+    }
+
+    double perResourceAcquire = acquireStats.sum() / double(FrameCount * resourceCount);
+    double perResourceRelease = releaseStats.sum() / double(FrameCount * resourceCount);
+
+    std::cout << resourceCount << " resources, batch size " << batchSize << ":" << std::endl
+              << "  Acquire: " << acquireStats.avg() << " us per call (p99 " << acquireStats.percentile(99.0) << "), "
+              << perResourceAcquire << " us per resource" << std::endl
+              << "  Release: " << releaseStats.avg() << " us per call (p99 " << releaseStats.percentile(99.0) << "), "
+              << perResourceRelease << " us per resource" << std::endl
+              << "  Frame:   " << (acquireStats.sum() + releaseStats.sum()) / double(FrameCount) << " us" << std::endl;
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  D3D11On12WrapApp app;
+  return app.run();
+}
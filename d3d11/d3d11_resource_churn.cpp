@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <d3d11.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/dxgi_memory.h"
+#include "../common/timer.h"
+
+enum class ResourceKind : uint32_t {
+  Buffer,
+  Texture2D,
+};
+
+struct ChurnResource {
+  Com<ID3D11Resource> resource;
+  D3D11_USAGE         usage;
+  uint64_t            size;
+};
+
+struct UsageStats {
+  Stats     createTimes;
+  Stats     destroyTimes;
+  uint32_t  failures = 0;
+};
+
+class ResourceChurnApp {
+
+public:
+
+  ResourceChurnApp() {
+    std::array<D3D_FEATURE_LEVEL, 2> fl = {
+      D3D_FEATURE_LEVEL_11_1,
+      D3D_FEATURE_LEVEL_11_0,
+    };
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, 0, fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &m_device, nullptr, &m_context))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    m_memory = MemoryTimeline(m_device.ptr());
+
+    // Shared initial data for immutable resources
+    m_initialData.resize(MaxImmutableSize);
+    m_initialized = true;
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    DXGI_QUERY_VIDEO_MEMORY_INFO baseLocal = { };
+    DXGI_QUERY_VIDEO_MEMORY_INFO baseNonLocal = { };
+    m_memory.query(baseLocal, baseNonLocal);
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "Memory over time (MiB):" << std::endl
+              << std::setw(8) << "Ops" << std::setw(8) << "Live"
+              << std::setw(10) << "Requested" << std::setw(10) << "Local"
+              << std::setw(10) << "Sysmem" << std::setw(10) << "Overhead" << std::endl;
+
+    uint64_t peakUsage = 0;
+    uint64_t peakLive = 0;
+
+    for (uint32_t op = 1; op <= OperationCount; op++) {
+      // Keep the live set around the memory target, then
+      // create and destroy resources with equal probability
+      bool create = m_live.empty() || (m_liveBytes < LiveTarget && random(2));
+
+      if (create)
+        createResource();
+      else
+        destroyResource(random(m_live.size()));
+
+      // Give deferred destruction a chance to complete
+      if (!(op % FlushInterval))
+        m_context->Flush();
+
+      peakLive = std::max(peakLive, m_liveBytes);
+
+      if (!(op % SampleInterval)) {
+        DXGI_QUERY_VIDEO_MEMORY_INFO local = { };
+        DXGI_QUERY_VIDEO_MEMORY_INFO nonLocal = { };
+
+        if (m_memory.query(local, nonLocal)) {
+          uint64_t usage = local.CurrentUsage + nonLocal.CurrentUsage;
+          uint64_t baseUsage = baseLocal.CurrentUsage + baseNonLocal.CurrentUsage;
+          uint64_t allocated = usage > baseUsage ? usage - baseUsage : 0;
+
+          peakUsage = std::max(peakUsage, allocated);
+
+          // Memory committed beyond what live resources need,
+          // relative to the requested size
+          double overhead = m_liveBytes ? double(allocated) / double(m_liveBytes) - 1.0 : 0.0;
+
+          std::cout << std::setw(8) << op << std::setw(8) << m_live.size()
+                    << std::setw(10) << toMiB(m_liveBytes)
+                    << std::setw(10) << toMiB(local.CurrentUsage)
+                    << std::setw(10) << toMiB(nonLocal.CurrentUsage)
+                    << std::setw(9) << (100.0 * overhead) << "%" << std::endl;
+        }
+      }
+    }
+
+    while (!m_live.empty())
+      destroyResource(m_live.size() - 1);
+
+    m_context->Flush();
+
+    std::cout << "Peak requested: " << toMiB(peakLive) << " MiB" << std::endl;
+
+    if (m_memory.isAvailable())
+      std::cout << "Peak allocated: " << toMiB(peakUsage) << " MiB" << std::endl;
+
+    std::cout << std::defaultfloat;
+
+    static const std::array<const char*, 4> s_usageNames = {{
+      "DEFAULT", "IMMUTABLE", "DYNAMIC", "STAGING",
+    }};
+
+    for (uint32_t i = 0; i < m_stats.size(); i++) {
+      auto& stats = m_stats[i];
+
+      std::cout << s_usageNames[i] << ": " << stats.createTimes.count() << " created, "
+                << stats.failures << " failed" << std::endl
+                << "  Create:  p50 " << stats.createTimes.percentile(50.0) << " us"
+                << ", p99 " << stats.createTimes.percentile(99.0) << " us"
+                << ", max " << stats.createTimes.max() << " us" << std::endl
+                << "  Destroy: p50 " << stats.destroyTimes.percentile(50.0) << " us"
+                << ", p99 " << stats.destroyTimes.percentile(99.0) << " us"
+                << ", max " << stats.destroyTimes.max() << " us" << std::endl;
+    }
+
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t OperationCount    = 10000;
+  constexpr static uint32_t SampleInterval    = 500;
+  constexpr static uint32_t FlushInterval     = 64;
+  constexpr static uint64_t LiveTarget        = 1ull << 30;
+  constexpr static uint32_t MinSizeLog2       = 8;
+  constexpr static uint32_t MaxSizeLog2       = 28;
+  constexpr static uint64_t MaxImmutableSize  = 64ull << 20;
+
+  Com<ID3D11Device>           m_device;
+  Com<ID3D11DeviceContext>    m_context;
+
+  MemoryTimeline              m_memory;
+
+  std::vector<ChurnResource>  m_live;
+  uint64_t                    m_liveBytes = 0;
+
+  std::array<UsageStats, 4>   m_stats;
+
+  std::vector<uint8_t>        m_initialData;
+
+  uint64_t                    m_seed = 0x12345678u;
+
+  bool m_initialized = false;
+
+  // High half of a 64-bit LCG, so that all 32 bits are usable
+  uint32_t random(uint32_t max) {
+    m_seed = m_seed * 6364136223846793005ull + 1442695040888963407ull;
+    return uint32_t(m_seed >> 32) % max;
+  }
+
+  /**
+    * \brief Picks a resource size
+    *
+    * Sizes are distributed roughly like a streaming workload:
+    * many small constant and vertex buffers, fewer textures in
+    * the megabyte range, and only occasional huge resources.
+    */
+  uint64_t randomSize() {
+    uint32_t log2 = MinSizeLog2;
+
+    while (log2 < MaxSizeLog2 && random(4))
+      log2 += random(3);
+
+    log2 = std::min(log2, MaxSizeLog2);
+
+    uint64_t size = 1ull << log2;
+    return std::min(size + random(uint32_t(size)), 1ull << MaxSizeLog2);
+  }
+
+  D3D11_USAGE randomUsage() {
+    static const std::array<D3D11_USAGE, 8> s_usages = {{
+      D3D11_USAGE_DEFAULT, D3D11_USAGE_DEFAULT,
+      D3D11_USAGE_DEFAULT, D3D11_USAGE_DEFAULT,
+      D3D11_USAGE_IMMUTABLE, D3D11_USAGE_IMMUTABLE,
+      D3D11_USAGE_DYNAMIC, D3D11_USAGE_STAGING,
+    }};
+
+    return s_usages[random(s_usages.size())];
+  }
+
+  void createResource() {
+    uint64_t size = randomSize();
+    D3D11_USAGE usage = randomUsage();
+
+    // Initial data for immutable resources is limited
+    // in order to keep host memory usage reasonable
+    if (usage == D3D11_USAGE_IMMUTABLE)
+      size = std::min(size, MaxImmutableSize);
+
+    ResourceKind kind = (size >= (1u << 16) && random(2))
+      ? ResourceKind::Texture2D
+      : ResourceKind::Buffer;
+
+    UINT bindFlags = 0;
+    UINT cpuFlags = 0;
+
+    switch (usage) {
+      case D3D11_USAGE_DEFAULT:
+        bindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+        break;
+
+      case D3D11_USAGE_IMMUTABLE:
+        bindFlags = D3D11_BIND_SHADER_RESOURCE;
+        break;
+
+      case D3D11_USAGE_DYNAMIC:
+        bindFlags = D3D11_BIND_SHADER_RESOURCE;
+        cpuFlags = D3D11_CPU_ACCESS_WRITE;
+        break;
+
+      case D3D11_USAGE_STAGING:
+        cpuFlags = D3D11_CPU_ACCESS_READ | D3D11_CPU_ACCESS_WRITE;
+        break;
+    }
+
+    ChurnResource entry;
+    entry.usage = usage;
+
+    HRESULT hr = E_FAIL;
+    Timer timer;
+
+    if (kind == ResourceKind::Buffer) {
+      D3D11_BUFFER_DESC desc = { };
+      desc.ByteWidth = UINT(size & ~15ull);
+      desc.Usage = usage;
+      desc.BindFlags = bindFlags;
+      desc.CPUAccessFlags = cpuFlags;
+
+      D3D11_SUBRESOURCE_DATA data = { m_initialData.data() };
+
+      Com<ID3D11Buffer> buffer;
+      hr = m_device->CreateBuffer(&desc, usage == D3D11_USAGE_IMMUTABLE ? &data : nullptr, &buffer);
+
+      entry.resource = buffer.ptr();
+      entry.size = desc.ByteWidth;
+    } else {
+      // Pick a power-of-two RGBA8 texture of roughly the requested size
+      uint32_t texels = uint32_t(size / 4);
+      uint32_t widthLog2 = 0;
+
+      while ((2u << (2 * widthLog2)) <= texels)
+        widthLog2 += 1;
+
+      D3D11_TEXTURE2D_DESC desc = { };
+      desc.Width = 1u << widthLog2;
+      desc.Height = std::max(1u, texels >> widthLog2);
+      desc.MipLevels = 1;
+      desc.ArraySize = 1;
+      desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+      desc.SampleDesc = { 1, 0 };
+      desc.Usage = usage;
+      desc.BindFlags = bindFlags;
+      desc.CPUAccessFlags = cpuFlags;
+
+      D3D11_SUBRESOURCE_DATA data = { m_initialData.data(), 4 * desc.Width };
+
+      Com<ID3D11Texture2D> texture;
+      hr = m_device->CreateTexture2D(&desc, usage == D3D11_USAGE_IMMUTABLE ? &data : nullptr, &texture);
+
+      entry.resource = texture.ptr();
+      entry.size = uint64_t(4) * desc.Width * desc.Height;
+    }
+
+    double us = timer.us();
+    auto& stats = m_stats[uint32_t(usage)];
+
+    if (FAILED(hr)) {
+      stats.failures += 1;
+      return;
+    }
+
+    stats.createTimes.add(us);
+
+    m_liveBytes += entry.size;
+    m_live.push_back(std::move(entry));
+  }
+
+  void destroyResource(size_t index) {
+    ChurnResource entry = std::move(m_live[index]);
+
+    m_live[index] = std::move(m_live.back());
+    m_live.pop_back();
+
+    Timer timer;
+    entry.resource = nullptr;
+    m_stats[uint32_t(entry.usage)].destroyTimes.add(timer.us());
+
+    m_liveBytes -= entry.size;
+  }
+
+  static double toMiB(uint64_t bytes) {
+    return double(bytes) / double(1u << 20);
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  ResourceChurnApp app;
+  return app.run();
+}
@@ -0,0 +1,223 @@
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <d3d11.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/str.h"
+#include "../common/timer.h"
+
+// Upper bounds of histogram buckets, in microseconds
+constexpr std::array<double, 8> g_histogramBuckets = {{ 10, 20, 50, 100, 200, 500, 1000, 5000 }};
+
+using Histogram = std::array<uint32_t, g_histogramBuckets.size() + 1>;
+
+enum class SyncMethod : uint32_t {
+  QueryFlush,
+  QueryFlushDoNotFlush,
+  QueryImplicitFlush,
+  StagingMap,
+  StagingMapDoNotWait,
+};
+
+class SyncApp {
+
+public:
+
+  SyncApp() {
+    std::array<D3D_FEATURE_LEVEL, 2> fl = {
+      D3D_FEATURE_LEVEL_11_1,
+      D3D_FEATURE_LEVEL_11_0,
+    };
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, 0, fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &m_device, nullptr, &m_context))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT };
+
+    if (FAILED(m_device->CreateQuery(&queryDesc, &m_query))) {
+      std::cerr << "Failed to create event query" << std::endl;
+      return;
+    }
+
+    D3D11_TEXTURE2D_DESC desc = { };
+    desc.Width = 64;
+    desc.Height = 64;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc = { 1, 0 };
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+    if (FAILED(m_device->CreateTexture2D(&desc, nullptr, &m_renderTarget))
+     || FAILED(m_device->CreateRenderTargetView(m_renderTarget.ptr(), nullptr, &m_renderTargetView))) {
+      std::cerr << "Failed to create render target" << std::endl;
+      return;
+    }
+
+    // Only read back a single pixel, as picking would
+    desc.Width = 1;
+    desc.Height = 1;
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    if (FAILED(m_device->CreateTexture2D(&desc, nullptr, &m_staging))) {
+      std::cerr << "Failed to create staging texture" << std::endl;
+      return;
+    }
+
+    m_initialized = true;
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    static const std::array<const char*, 5> s_methodNames = {{
+      "Event query, Flush, GetData",
+      "Event query, Flush, GetData(DONOTFLUSH)",
+      "Event query, GetData only",
+      "Staging copy, Map(READ)",
+      "Staging copy, Map(READ, DO_NOT_WAIT)",
+    }};
+
+    for (uint32_t i = 0; i < s_methodNames.size(); i++) {
+      Stats stats;
+      Histogram histogram = { };
+
+      // Warm up so that one-time costs don't show up in the results
+      for (uint32_t j = 0; j < WarmupCount; j++)
+        measure(SyncMethod(i));
+
+      for (uint32_t j = 0; j < SampleCount; j++) {
+        double us = measure(SyncMethod(i));
+        stats.add(us);
+
+        size_t bucket = 0;
+
+        while (bucket < g_histogramBuckets.size() && us >= g_histogramBuckets[bucket])
+          bucket += 1;
+
+        histogram[bucket] += 1;
+      }
+
+      printStats(s_methodNames[i], stats, histogram);
+    }
+
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t WarmupCount = 100;
+  constexpr static uint32_t SampleCount = 5000;
+
+  Com<ID3D11Device>             m_device;
+  Com<ID3D11DeviceContext>      m_context;
+  Com<ID3D11Query>              m_query;
+  Com<ID3D11Texture2D>          m_renderTarget;
+  Com<ID3D11RenderTargetView>   m_renderTargetView;
+  Com<ID3D11Texture2D>          m_staging;
+
+  uint32_t                      m_iteration = 0;
+
+  bool m_initialized = false;
+
+  /**
+    * \brief Issues trivial work and waits for it
+    * \returns Round trip latency, in microseconds
+    */
+  double measure(SyncMethod method) {
+    FLOAT color[4] = { float(++m_iteration & 0xff) / 255.0f, 0.0f, 0.0f, 1.0f };
+
+    Timer timer;
+    m_context->ClearRenderTargetView(m_renderTargetView.ptr(), color);
+
+    switch (method) {
+      case SyncMethod::QueryFlush:
+      case SyncMethod::QueryFlushDoNotFlush: {
+        UINT flags = method == SyncMethod::QueryFlushDoNotFlush
+          ? D3D11_ASYNC_GETDATA_DONOTFLUSH : 0;
+
+        m_context->End(m_query.ptr());
+        m_context->Flush();
+
+        while (m_context->GetData(m_query.ptr(), nullptr, 0, flags) != S_OK)
+          continue;
+      } break;
+
+      case SyncMethod::QueryImplicitFlush: {
+        m_context->End(m_query.ptr());
+
+        while (m_context->GetData(m_query.ptr(), nullptr, 0, 0) != S_OK)
+          continue;
+      } break;
+
+      case SyncMethod::StagingMap:
+      case SyncMethod::StagingMapDoNotWait: {
+        D3D11_BOX box = { 0, 0, 0, 1, 1, 1 };
+        m_context->CopySubresourceRegion(m_staging.ptr(), 0, 0, 0, 0, m_renderTarget.ptr(), 0, &box);
+
+        UINT flags = 0;
+
+        if (method == SyncMethod::StagingMapDoNotWait) {
+          m_context->Flush();
+          flags = D3D11_MAP_FLAG_DO_NOT_WAIT;
+        }
+
+        D3D11_MAPPED_SUBRESOURCE mapped = { };
+        HRESULT hr;
+
+        while ((hr = m_context->Map(m_staging.ptr(), 0, D3D11_MAP_READ, flags, &mapped)) == DXGI_ERROR_WAS_STILL_DRAWING)
+          continue;
+
+        if (SUCCEEDED(hr))
+          m_context->Unmap(m_staging.ptr(), 0);
+      } break;
+    }
+
+    return timer.us();
+  }
+
+  void printStats(const char* name, Stats& stats, const Histogram& histogram) {
+    std::cout << name << ":" << std::endl
+              << "  avg " << stats.avg() << " us"
+              << ", p50 " << stats.percentile(50.0) << " us"
+              << ", p90 " << stats.percentile(90.0) << " us"
+              << ", p99 " << stats.percentile(99.0) << " us"
+              << ", p99.9 " << stats.percentile(99.9) << " us"
+              << ", max " << stats.max() << " us" << std::endl;
+
+    for (size_t i = 0; i < histogram.size(); i++) {
+      if (!histogram[i])
+        continue;
+
+      std::string label = i < g_histogramBuckets.size()
+        ? format("< ", g_histogramBuckets[i])
+        : format(">= ", g_histogramBuckets.back());
+
+      std::cout << "  " << std::setw(8) << label << " us: "
+                << std::setw(5) << histogram[i] << std::endl;
+    }
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  SyncApp app;
+  return app.run();
+}
@@ -9,7 +9,10 @@
 #include <windowsx.h>
 
 #include "../common/com.h"
+#include "../common/dxgi_memory.h"
 #include "../common/str.h"
+#include "../common/tiling.h"
+#include "../common/timer.h"
 
 class TiledResourceTestApp {
 
@@ -56,8 +59,11 @@ public:
     testCreateTiledImage3D();
     testCreateMinMaxSampler();
     testGetResourceTiling();
+    testResourceTilingOracle();
     testMapBufferTiles();
     testMapImageTiles();
+    testResizeTilePool();
+    testTilePoolMemory();
     return 0;
   }
 
@@ -294,6 +300,163 @@ public:
     }
   }
 
+  void testResourceTilingOracle() {
+    constexpr uint32_t CaseCount = 20000;
+    constexpr uint32_t MaxReportedMismatches = 16;
+
+    // Gather formats that support tiling on this device
+    std::vector<uint32_t> formats2D;
+    std::vector<uint32_t> formats3D;
+
+    for (uint32_t i = 1; i <= uint32_t(DXGI_FORMAT_B4G4R4A4_UNORM); i++) {
+      if (!tiling::getFormatInfo(i).bitsPerBlock)
+        continue;
+
+      UINT support = 0;
+
+      D3D11_FEATURE_DATA_FORMAT_SUPPORT2 support2 = { };
+      support2.InFormat = DXGI_FORMAT(i);
+
+      if (FAILED(m_device->CheckFormatSupport(DXGI_FORMAT(i), &support))
+       || FAILED(m_device->CheckFeatureSupport(D3D11_FEATURE_FORMAT_SUPPORT2, &support2, sizeof(support2)))
+       || !(support2.OutFormatSupport2 & D3D11_FORMAT_SUPPORT2_TILED))
+        continue;
+
+      if (support & D3D11_FORMAT_SUPPORT_TEXTURE2D)
+        formats2D.push_back(i);
+
+      if ((support & D3D11_FORMAT_SUPPORT_TEXTURE3D) && m_tier >= D3D11_TILED_RESOURCES_TIER_3)
+        formats3D.push_back(i);
+    }
+
+    std::cout << "Test: GetResourceTiling oracle (" << std::dec
+              << formats2D.size() << " 2D formats, "
+              << formats3D.size() << " 3D formats)" << std::endl;
+
+    // Simple deterministic RNG so that runs are reproducible.
+    // Use the high half of a 64-bit LCG to get 32 usable bits.
+    uint64_t seed = 0x12345678u;
+
+    auto random = [&seed] (uint32_t max) {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      return uint32_t(seed >> 32) % max;
+    };
+
+    auto randomExtent = [&random] (uint32_t maxLog2) {
+      return 1u + random(1u << random(maxLog2 + 1));
+    };
+
+    uint32_t tested = 0;
+    uint32_t skipped = 0;
+    uint32_t mismatches = 0;
+
+    for (uint32_t i = 0; i < CaseCount; i++) {
+      tiling::ResourceDesc desc;
+
+      uint32_t kind = random(16);
+
+      if (kind == 0) {
+        desc.dimension = tiling::Dimension::Buffer;
+        desc.width = 1 + random(64u << 20);
+      } else if (kind == 1 && !formats3D.empty()) {
+        desc.dimension = tiling::Dimension::Texture3D;
+        desc.format = formats3D[random(formats3D.size())];
+        desc.width = randomExtent(11);
+        desc.height = randomExtent(11);
+        desc.depth = randomExtent(11);
+      } else if (!formats2D.empty()) {
+        desc.dimension = tiling::Dimension::Texture2D;
+        desc.format = formats2D[random(formats2D.size())];
+        desc.width = randomExtent(14);
+        desc.height = randomExtent(14);
+        desc.arraySize = random(4) ? 1 : 1 + random(16);
+
+        // Multisampled images have a single mip and use smaller tiles
+        if (!random(8))
+          desc.sampleCount = 2u << random(3);
+      } else {
+        continue;
+      }
+
+      if (desc.dimension != tiling::Dimension::Buffer) {
+        tiling::FormatInfo info = tiling::getFormatInfo(desc.format);
+
+        // Block-compressed images need block-aligned top-level extents
+        desc.width = align(desc.width, info.blockWidth);
+        desc.height = align(desc.height, info.blockHeight);
+
+        uint32_t fullMips = tiling::getFullMipCount(desc);
+        desc.mipLevels = random(3) ? 1 + random(fullMips) : 0;
+
+        if (desc.sampleCount > 1)
+          desc.mipLevels = 1;
+      }
+
+      Com<ID3D11Resource> resource;
+
+      if (!createTiledResource(desc, &resource)) {
+        skipped += 1;
+        continue;
+      }
+
+      uint32_t subresourceCount = desc.dimension == tiling::Dimension::Buffer ? 1
+        : (desc.mipLevels ? desc.mipLevels : tiling::getFullMipCount(desc))
+        * (desc.dimension == tiling::Dimension::Texture3D ? 1 : desc.arraySize);
+
+      std::vector<D3D11_SUBRESOURCE_TILING> tilings(subresourceCount);
+
+      uint32_t tileCount = 0;
+      D3D11_PACKED_MIP_DESC packedInfo = { };
+      D3D11_TILE_SHAPE tileShape = { };
+
+      m_device->GetResourceTiling(resource.ptr(),
+        &tileCount, &packedInfo, &tileShape,
+        &subresourceCount, 0, tilings.data());
+
+      // Tier 1 devices may pack mips that are not tile-aligned
+      tiling::Options options;
+      options.alignedMipSize = m_tier == D3D11_TILED_RESOURCES_TIER_1;
+
+      tiling::ResourceTiling expected;
+      tiling::computeResourceTiling(desc, options, expected);
+
+      // The oracle assumes a linear layout for packed mips, which is
+      // only a lower bound since devices may pad it. Check the device
+      // against that, then use its tile count to verify the rest of
+      // the layout, which depends on it.
+      std::string error;
+
+      if (packedInfo.NumPackedMips
+       && packedInfo.NumTilesForPackedMips < expected.packedMips.numTilesForPackedMips) {
+        error = format("Packed mip tiles ", packedInfo.NumTilesForPackedMips,
+          ", expected at least ", expected.packedMips.numTilesForPackedMips);
+      } else {
+        options.packedMipTiles = packedInfo.NumTilesForPackedMips;
+        tiling::computeResourceTiling(desc, options, expected);
+
+        error = compareResourceTiling(expected,
+          tileCount, packedInfo, tileShape, subresourceCount, tilings.data());
+      }
+
+      tested += 1;
+
+      if (!error.empty()) {
+        if (mismatches++ < MaxReportedMismatches) {
+          std::cout << "  Mismatch: dim = " << uint32_t(desc.dimension)
+                    << ", format = " << desc.format
+                    << ", extent = " << desc.width << "x" << desc.height << "x" << desc.depth
+                    << ", mips = " << desc.mipLevels
+                    << ", layers = " << desc.arraySize
+                    << ", samples = " << desc.sampleCount
+                    << ": " << error << std::endl;
+        }
+      }
+    }
+
+    std::cout << "  Tested " << tested << " cases, skipped " << skipped
+              << ", mismatches " << mismatches << std::endl;
+  }
+
   void testMapBufferTiles() {
     Com<ID3D11Buffer> tilePool;
     Com<ID3D11Buffer> buffer1;
@@ -590,6 +753,224 @@ public:
       D3D11_TILE_COPY_SWIZZLED_TILED_RESOURCE_TO_LINEAR_BUFFER);
   }
 
+  void testResizeTilePool() {
+    constexpr uint32_t MinTileCount = 1;
+    constexpr uint32_t MaxTileCount = 1024;
+
+    Com<ID3D11Buffer> tilePool;
+    Com<ID3D11Buffer> buffer;
+    Com<ID3D11Buffer> readback;
+
+    D3D11_BUFFER_DESC tilePoolDesc = { };
+    tilePoolDesc.ByteWidth = MinTileCount << 16;
+    tilePoolDesc.Usage = D3D11_USAGE_DEFAULT;
+    tilePoolDesc.MiscFlags = D3D11_RESOURCE_MISC_TILE_POOL;
+
+    if (FAILED(m_device->CreateBuffer(&tilePoolDesc, nullptr, &tilePool))) {
+      std::cout << "Failed to create tile pool" << std::endl;
+      return;
+    }
+
+    D3D11_BUFFER_DESC bufferDesc = { };
+    bufferDesc.ByteWidth = MaxTileCount << 16;
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+    bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_TILED;
+
+    if (FAILED(m_device->CreateBuffer(&bufferDesc, nullptr, &buffer))) {
+      std::cout << "Failed to create tiled buffer" << std::endl;
+      return;
+    }
+
+    D3D11_BUFFER_DESC readbackDesc = { };
+    readbackDesc.ByteWidth = MaxTileCount * sizeof(uint32_t);
+    readbackDesc.Usage = D3D11_USAGE_STAGING;
+    readbackDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    if (FAILED(m_device->CreateBuffer(&readbackDesc, nullptr, &readback))) {
+      std::cout << "Failed to create readback buffer" << std::endl;
+      return;
+    }
+
+    // Grow the pool step by step, mapping new tiles into the
+    // buffer every time. Tile i of the buffer always maps to
+    // tile i of the pool and contains the value i + 1.
+    std::cout << "Test: Grow tile pool" << std::endl;
+
+    uint32_t tileCount = 0;
+
+    for (uint32_t newTileCount = MinTileCount; newTileCount <= MaxTileCount; newTileCount *= 2) {
+      double resizeUs = 0.0;
+
+      if (newTileCount != MinTileCount) {
+        Timer timer;
+        HRESULT hr = m_context->ResizeTilePool(tilePool.ptr(), uint64_t(newTileCount) << 16);
+        resizeUs = timer.us();
+
+        if (FAILED(hr)) {
+          std::cout << "ResizeTilePool failed: 0x" << std::hex << hr << std::endl;
+          return;
+        }
+      }
+
+      D3D11_TILED_RESOURCE_COORDINATE regionCoord = { tileCount };
+      D3D11_TILE_REGION_SIZE regionSize = { newTileCount - tileCount };
+
+      UINT rangeFlags = 0;
+      UINT rangeOffset = tileCount;
+      UINT rangeSize = newTileCount - tileCount;
+
+      Timer timer;
+      HRESULT hr = m_context->UpdateTileMappings(buffer.ptr(),
+        1, &regionCoord, &regionSize, tilePool.ptr(),
+        1, &rangeFlags, &rangeOffset, &rangeSize, 0);
+      double mapUs = timer.us();
+
+      if (FAILED(hr)) {
+        std::cout << "UpdateTileMappings failed: 0x" << std::hex << hr << std::endl;
+        return;
+      }
+
+      for (uint32_t i = tileCount; i < newTileCount; i++)
+        clearBufferTile(buffer.ptr(), i, i + 1);
+
+      tileCount = newTileCount;
+
+      bool valid = validateBufferTileData(buffer.ptr(), readback.ptr(), tileCount,
+        [] (uint32_t tile) { return tile + 1; });
+
+      std::cout << "  " << std::dec << (uint64_t(tileCount) << 6) << " KiB: "
+                << "ResizeTilePool " << resizeUs << " us, "
+                << "UpdateTileMappings " << mapUs << " us, "
+                << "mappings " << (valid ? "ok" : "broken") << std::endl;
+    }
+
+    // Shrink the pool again. Tiles that are about to be removed
+    // get unmapped first since accessing them would be undefined.
+    std::cout << "Test: Shrink tile pool" << std::endl;
+
+    for (uint32_t newTileCount = MaxTileCount / 2; newTileCount >= MinTileCount; newTileCount /= 2) {
+      D3D11_TILED_RESOURCE_COORDINATE regionCoord = { newTileCount };
+      D3D11_TILE_REGION_SIZE regionSize = { tileCount - newTileCount };
+
+      UINT rangeFlags = D3D11_TILE_RANGE_NULL;
+      UINT rangeOffset = 0;
+
+      HRESULT hr = m_context->UpdateTileMappings(buffer.ptr(),
+        1, &regionCoord, &regionSize, tilePool.ptr(),
+        1, &rangeFlags, &rangeOffset, nullptr, 0);
+
+      if (FAILED(hr)) {
+        std::cout << "UpdateTileMappings failed: 0x" << std::hex << hr << std::endl;
+        return;
+      }
+
+      Timer timer;
+      hr = m_context->ResizeTilePool(tilePool.ptr(), uint64_t(newTileCount) << 16);
+      double resizeUs = timer.us();
+
+      if (FAILED(hr)) {
+        std::cout << "ResizeTilePool failed: 0x" << std::hex << hr << std::endl;
+        return;
+      }
+
+      tileCount = newTileCount;
+
+      bool valid = validateBufferTileData(buffer.ptr(), readback.ptr(), tileCount,
+        [] (uint32_t tile) { return tile + 1; });
+
+      std::cout << "  " << std::dec << (uint64_t(tileCount) << 6) << " KiB: "
+                << "ResizeTilePool " << resizeUs << " us, "
+                << "mappings " << (valid ? "ok" : "broken") << std::endl;
+    }
+  }
+
+  void testTilePoolMemory() {
+    constexpr uint32_t TileCount = 4096;
+
+    MemoryTimeline timeline(m_device.ptr());
+
+    if (!timeline.isAvailable())
+      return;
+
+    std::cout << "Test: Tile pool memory accounting" << std::endl;
+
+    Com<ID3D11Buffer> tilePool;
+    Com<ID3D11Buffer> buffer;
+
+    timeline.sample("Start");
+
+    D3D11_BUFFER_DESC tilePoolDesc = { };
+    tilePoolDesc.ByteWidth = TileCount << 15;
+    tilePoolDesc.Usage = D3D11_USAGE_DEFAULT;
+    tilePoolDesc.MiscFlags = D3D11_RESOURCE_MISC_TILE_POOL;
+
+    if (FAILED(m_device->CreateBuffer(&tilePoolDesc, nullptr, &tilePool))) {
+      std::cout << "Failed to create tile pool" << std::endl;
+      return;
+    }
+
+    timeline.sample("Create 128 MiB tile pool");
+
+    if (FAILED(m_context->ResizeTilePool(tilePool.ptr(), uint64_t(TileCount) << 16))) {
+      std::cout << "Failed to resize tile pool" << std::endl;
+      return;
+    }
+
+    timeline.sample("Resize tile pool to 256 MiB");
+
+    D3D11_BUFFER_DESC bufferDesc = { };
+    bufferDesc.ByteWidth = TileCount << 16;
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+    bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_TILED;
+
+    if (FAILED(m_device->CreateBuffer(&bufferDesc, nullptr, &buffer))) {
+      std::cout << "Failed to create tiled buffer" << std::endl;
+      return;
+    }
+
+    timeline.sample("Create 256 MiB tiled buffer");
+
+    D3D11_TILED_RESOURCE_COORDINATE regionCoord = { 0, 0, 0, 0 };
+    D3D11_TILE_REGION_SIZE regionSize = { TileCount, FALSE };
+
+    UINT rangeFlags = 0;
+    UINT rangeOffset = 0;
+    UINT rangeSize = TileCount;
+
+    m_context->UpdateTileMappings(buffer.ptr(),
+      1, &regionCoord, &regionSize, tilePool.ptr(),
+      1, &rangeFlags, &rangeOffset, &rangeSize, 0);
+    m_context->Flush();
+
+    timeline.sample("Map all tiles");
+
+    for (uint32_t i = 0; i < TileCount; i += 64)
+      clearBufferTile(buffer.ptr(), i, i + 1);
+
+    m_context->Flush();
+    timeline.sample("Clear mapped tiles");
+
+    rangeFlags = D3D11_TILE_RANGE_NULL;
+
+    m_context->UpdateTileMappings(buffer.ptr(),
+      1, &regionCoord, &regionSize, tilePool.ptr(),
+      1, &rangeFlags, &rangeOffset, &rangeSize, 0);
+    m_context->Flush();
+
+    timeline.sample("Unmap all tiles");
+
+    buffer = nullptr;
+    timeline.sample("Release tiled buffer");
+
+    tilePool = nullptr;
+    m_context->Flush();
+    timeline.sample("Release tile pool");
+
+    timeline.print(std::cout);
+  }
+
 private:
 
   Com<ID3D11Device2>          m_device;
@@ -599,7 +980,140 @@ private:
 
   bool m_initialized = false;
 
-  void validateBufferTileData(
+  static uint32_t align(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+
+  bool createTiledResource(
+    const tiling::ResourceDesc&   desc,
+          ID3D11Resource**        resource) {
+    HRESULT hr = E_INVALIDARG;
+
+    if (desc.dimension == tiling::Dimension::Buffer) {
+      D3D11_BUFFER_DESC bufferDesc = { };
+      bufferDesc.ByteWidth = desc.width;
+      bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+      bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+      bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_TILED;
+
+      Com<ID3D11Buffer> buffer;
+
+      if (SUCCEEDED(hr = m_device->CreateBuffer(&bufferDesc, nullptr, &buffer)))
+        hr = buffer->QueryInterface(IID_PPV_ARGS(resource));
+    } else if (desc.dimension == tiling::Dimension::Texture3D) {
+      D3D11_TEXTURE3D_DESC desc3D = { };
+      desc3D.Width = desc.width;
+      desc3D.Height = desc.height;
+      desc3D.Depth = desc.depth;
+      desc3D.MipLevels = desc.mipLevels;
+      desc3D.Format = DXGI_FORMAT(desc.format);
+      desc3D.Usage = D3D11_USAGE_DEFAULT;
+      desc3D.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+      desc3D.MiscFlags = D3D11_RESOURCE_MISC_TILED;
+
+      Com<ID3D11Texture3D> tex3D;
+
+      if (SUCCEEDED(hr = m_device->CreateTexture3D(&desc3D, nullptr, &tex3D)))
+        hr = tex3D->QueryInterface(IID_PPV_ARGS(resource));
+    } else {
+      D3D11_TEXTURE2D_DESC desc2D = { };
+      desc2D.Width = desc.width;
+      desc2D.Height = desc.height;
+      desc2D.MipLevels = desc.mipLevels;
+      desc2D.ArraySize = desc.arraySize;
+      desc2D.SampleDesc = { desc.sampleCount, 0 };
+      desc2D.Format = DXGI_FORMAT(desc.format);
+      desc2D.Usage = D3D11_USAGE_DEFAULT;
+      desc2D.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+      if (desc.sampleCount > 1)
+        desc2D.BindFlags |= D3D11_BIND_RENDER_TARGET;
+      desc2D.MiscFlags = D3D11_RESOURCE_MISC_TILED;
+
+      Com<ID3D11Texture2D> tex2D;
+
+      if (SUCCEEDED(hr = m_device->CreateTexture2D(&desc2D, nullptr, &tex2D)))
+        hr = tex2D->QueryInterface(IID_PPV_ARGS(resource));
+    }
+
+    return SUCCEEDED(hr);
+  }
+
+  static std::string compareResourceTiling(
+    const tiling::ResourceTiling&     expected,
+          uint32_t                    tileCount,
+    const D3D11_PACKED_MIP_DESC&      packedInfo,
+    const D3D11_TILE_SHAPE&           tileShape,
+          uint32_t                    subresourceCount,
+    const D3D11_SUBRESOURCE_TILING*   tilings) {
+    if (tileShape.WidthInTexels  != expected.tileShape.widthInTexels
+     || tileShape.HeightInTexels != expected.tileShape.heightInTexels
+     || tileShape.DepthInTexels  != expected.tileShape.depthInTexels) {
+      return format("Tile shape ",
+        tileShape.WidthInTexels, "x", tileShape.HeightInTexels, "x", tileShape.DepthInTexels, ", expected ",
+        expected.tileShape.widthInTexels, "x", expected.tileShape.heightInTexels, "x", expected.tileShape.depthInTexels);
+    }
+
+    if (packedInfo.NumStandardMips != expected.packedMips.numStandardMips
+     || packedInfo.NumPackedMips   != expected.packedMips.numPackedMips) {
+      return format("Mips ", uint32_t(packedInfo.NumStandardMips), "+", uint32_t(packedInfo.NumPackedMips),
+        ", expected ", expected.packedMips.numStandardMips, "+", expected.packedMips.numPackedMips);
+    }
+
+    if (packedInfo.NumPackedMips
+     && packedInfo.StartTileIndexInOverallResource != expected.packedMips.startTileIndexInOverallResource) {
+      return format("Packed mip start tile ", packedInfo.StartTileIndexInOverallResource,
+        ", expected ", expected.packedMips.startTileIndexInOverallResource);
+    }
+
+    if (tileCount != expected.tileCount)
+      return format("Tile count ", tileCount, ", expected ", expected.tileCount);
+
+    if (subresourceCount != expected.subresources.size())
+      return format("Subresource count ", subresourceCount, ", expected ", expected.subresources.size());
+
+    for (uint32_t i = 0; i < subresourceCount; i++) {
+      const auto& a = tilings[i];
+      const auto& b = expected.subresources[i];
+
+      if (b.startTileIndexInOverallResource == tiling::PackedTile) {
+        if (a.StartTileIndexInOverallResource != D3D11_PACKED_TILE)
+          return format("Subresource ", i, " not packed");
+      } else if (a.WidthInTiles  != b.widthInTiles
+              || a.HeightInTiles != b.heightInTiles
+              || a.DepthInTiles  != b.depthInTiles
+              || a.StartTileIndexInOverallResource != b.startTileIndexInOverallResource) {
+        return format("Subresource ", i, ": ",
+          a.WidthInTiles, "x", a.HeightInTiles, "x", a.DepthInTiles, " @ ", a.StartTileIndexInOverallResource, ", expected ",
+          b.widthInTiles, "x", b.heightInTiles, "x", b.depthInTiles, " @ ", b.startTileIndexInOverallResource);
+      }
+    }
+
+    return std::string();
+  }
+
+  void clearBufferTile(
+          ID3D11Buffer*       tiledBuffer,
+          uint32_t            tile,
+          uint32_t            value) {
+    Com<ID3D11UnorderedAccessView> uav;
+
+    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = { };
+    uavDesc.Format = DXGI_FORMAT_R32_UINT;
+    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    uavDesc.Buffer.FirstElement = 16384 * tile;
+    uavDesc.Buffer.NumElements = 16384;
+
+    if (FAILED(m_device->CreateUnorderedAccessView(tiledBuffer, &uavDesc, &uav))) {
+      std::cout << "Failed to create buffer UAV for clears" << std::endl;
+      return;
+    }
+
+    const std::array<uint32_t, 4> color = { value };
+    m_context->ClearUnorderedAccessViewUint(uav.ptr(), color.data());
+  }
+
+  bool validateBufferTileData(
           ID3D11Buffer*       tiledBuffer,
           ID3D11Buffer*       readbackBuffer,
           uint32_t            tileCount,
@@ -620,11 +1134,13 @@ private:
         std::cout << "At tile " << std::dec << i
                   << ", expected 0x" << std::hex << proc(i)
                   << ", got 0x" << std::hex << data[i] << std::endl;
-        break;
+        m_context->Unmap(readbackBuffer, 0);
+        return false;
       }
     }
 
     m_context->Unmap(readbackBuffer, 0);
+    return true;
   }
 
 };
@@ -0,0 +1,473 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <d3dcompiler.h>
+#include <d3d11_2.h>
+
+#include <windows.h>
+#include <windowsx.h>
+
+#include "../common/com.h"
+#include "../common/gpu_timer.h"
+#include "../common/str.h"
+#include "../common/timer.h"
+
+const std::string g_bufferReadShaderCode =
+  "cbuffer cb : register(b0) { uint elem_count; uint thread_count; };\n"
+  "Buffer<uint4> t_src : register(t0);\n"
+  "RWBuffer<uint> u_sum : register(u0);\n"
+  "[numthreads(64,1,1)]\n"
+  "void main(uint3 tid : SV_DispatchThreadID) {\n"
+  "  uint4 sum = 0;\n"
+  "  for (uint i = tid.x; i < elem_count; i += thread_count)\n"
+  "    sum += t_src[i];\n"
+  "  u_sum[tid.x] = sum.x ^ sum.y ^ sum.z ^ sum.w;\n"
+  "}\n";
+
+const std::string g_bufferWriteShaderCode =
+  "cbuffer cb : register(b0) { uint elem_count; uint thread_count; };\n"
+  "RWBuffer<uint4> u_dst : register(u0);\n"
+  "[numthreads(64,1,1)]\n"
+  "void main(uint3 tid : SV_DispatchThreadID) {\n"
+  "  for (uint i = tid.x; i < elem_count; i += thread_count)\n"
+  "    u_dst[i] = uint4(i, i, i, i);\n"
+  "}\n";
+
+const std::string g_imageReadShaderCode =
+  "cbuffer cb : register(b0) { uint2 size; };\n"
+  "Texture2D<float4> t_src : register(t0);\n"
+  "SamplerState s_src : register(s0);\n"
+  "RWTexture2D<float> u_sum : register(u0);\n"
+  "[numthreads(8,8,1)]\n"
+  "void main(uint3 tid : SV_DispatchThreadID) {\n"
+  "  float4 sum = 0.0f;\n"
+  "  for (uint y = 0; y < 4; y++) {\n"
+  "    for (uint x = 0; x < 4; x++) {\n"
+  "      float2 coord = (float2(tid.xy * 4 + uint2(x, y)) + 0.5f) / float2(size);\n"
+  "      sum += t_src.SampleLevel(s_src, coord, 0.0f);\n"
+  "    }\n"
+  "  }\n"
+  "  u_sum[tid.xy] = dot(sum, 1.0f.xxxx);\n"
+  "}\n";
+
+const std::string g_imageWriteShaderCode =
+  "cbuffer cb : register(b0) { uint2 size; };\n"
+  "RWTexture2D<unorm float4> u_dst : register(u0);\n"
+  "[numthreads(8,8,1)]\n"
+  "void main(uint3 tid : SV_DispatchThreadID) {\n"
+  "  u_dst[tid.xy] = float4(float2(tid.xy) / float2(size), 0.0f, 1.0f);\n"
+  "}\n";
+
+struct ShaderArgs {
+  uint32_t x, y;
+  uint32_t pad[2];
+};
+
+class TiledAccessApp {
+
+public:
+
+  TiledAccessApp() {
+    Com<ID3D11Device> device;
+
+    std::vector<D3D_FEATURE_LEVEL> fl = {
+      D3D_FEATURE_LEVEL_12_1,
+      D3D_FEATURE_LEVEL_12_0,
+      D3D_FEATURE_LEVEL_11_1,
+    };
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, 0, fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &device, nullptr, nullptr))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    if (FAILED(device->QueryInterface(IID_PPV_ARGS(&m_device)))) {
+      std::cerr << "Failed to query ID3D11Device2" << std::endl;
+      return;
+    }
+
+    m_device->GetImmediateContext2(&m_context);
+
+    D3D11_FEATURE_DATA_D3D11_OPTIONS1 options1 = { };
+    m_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS1, &options1, sizeof(options1));
+    m_tier = options1.TiledResourcesTier;
+
+    if (m_tier == D3D11_TILED_RESOURCES_NOT_SUPPORTED) {
+      std::cerr << "Tiled resources not supported" << std::endl;
+      return;
+    }
+
+    // Accessing unmapped tiles is only well-defined on tier 2
+    if (m_tier < D3D11_TILED_RESOURCES_TIER_2)
+      std::cout << "Tier 1 device, only testing fully mapped resources" << std::endl;
+
+    D3D11_BUFFER_DESC argsDesc = { };
+    argsDesc.ByteWidth = sizeof(ShaderArgs);
+    argsDesc.Usage = D3D11_USAGE_DYNAMIC;
+    argsDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    argsDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    if (FAILED(m_device->CreateBuffer(&argsDesc, nullptr, &m_args))) {
+      std::cerr << "Failed to create constant buffer" << std::endl;
+      return;
+    }
+
+    D3D11_SAMPLER_DESC samplerDesc = { };
+    samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+    samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+    samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+
+    if (FAILED(m_device->CreateSamplerState(&samplerDesc, &m_sampler))) {
+      std::cerr << "Failed to create sampler" << std::endl;
+      return;
+    }
+
+    m_initialized =
+      createShader(g_bufferReadShaderCode, &m_bufferReadShader) &&
+      createShader(g_bufferWriteShaderCode, &m_bufferWriteShader) &&
+      createShader(g_imageReadShaderCode, &m_imageReadShader) &&
+      createShader(g_imageWriteShaderCode, &m_imageWriteShader) &&
+      createOutputResources();
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    std::cout << "Buffer: " << (BufferSize >> 20) << " MiB, "
+              << "Image: " << ImageSize << "x" << ImageSize << " R8G8B8A8_UNORM" << std::endl;
+
+    testConfig(Kind::Buffer, false, 0);
+    testConfig(Kind::Image,  false, 0);
+
+    for (uint32_t nullPercent : { 0u, 50u, 99u }) {
+      if (nullPercent && m_tier < D3D11_TILED_RESOURCES_TIER_2)
+        continue;
+
+      testConfig(Kind::Buffer, true, nullPercent);
+      testConfig(Kind::Image,  true, nullPercent);
+    }
+
+    return 0;
+  }
+
+private:
+
+  enum class Kind : uint32_t {
+    Buffer,
+    Image,
+  };
+
+  constexpr static uint32_t BufferSize    = 256u << 20;
+  constexpr static uint32_t ImageSize     = 4096;
+  constexpr static uint32_t ThreadCount   = 65536;
+  constexpr static uint32_t WarmupCount   = 5;
+  constexpr static uint32_t IterationCount = 50;
+
+  Com<ID3D11Device2>              m_device;
+  Com<ID3D11DeviceContext2>       m_context;
+
+  D3D11_TILED_RESOURCES_TIER      m_tier = D3D11_TILED_RESOURCES_NOT_SUPPORTED;
+
+  Com<ID3D11Buffer>               m_args;
+  Com<ID3D11SamplerState>         m_sampler;
+
+  Com<ID3D11ComputeShader>        m_bufferReadShader;
+  Com<ID3D11ComputeShader>        m_bufferWriteShader;
+  Com<ID3D11ComputeShader>        m_imageReadShader;
+  Com<ID3D11ComputeShader>        m_imageWriteShader;
+
+  Com<ID3D11UnorderedAccessView>  m_bufferSumView;
+  Com<ID3D11UnorderedAccessView>  m_imageSumView;
+
+  bool m_initialized = false;
+
+  bool createShader(const std::string& code, ID3D11ComputeShader** shader) {
+    Com<ID3DBlob> blob;
+
+    if (FAILED(D3DCompile(code.data(), code.size(),
+        "Compute shader", nullptr, nullptr, "main", "cs_5_0", 0, 0, &blob, nullptr))) {
+      std::cerr << "Failed to compile compute shader" << std::endl;
+      return false;
+    }
+
+    if (FAILED(m_device->CreateComputeShader(
+        blob->GetBufferPointer(),
+        blob->GetBufferSize(),
+        nullptr, shader))) {
+      std::cerr << "Failed to create compute shader" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool createOutputResources() {
+    Com<ID3D11Buffer> sumBuffer;
+
+    D3D11_BUFFER_DESC bufferDesc = { };
+    bufferDesc.ByteWidth = ThreadCount * sizeof(uint32_t);
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    bufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+
+    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = { };
+    uavDesc.Format = DXGI_FORMAT_R32_UINT;
+    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    uavDesc.Buffer.NumElements = ThreadCount;
+
+    if (FAILED(m_device->CreateBuffer(&bufferDesc, nullptr, &sumBuffer))
+     || FAILED(m_device->CreateUnorderedAccessView(sumBuffer.ptr(), &uavDesc, &m_bufferSumView))) {
+      std::cerr << "Failed to create buffer output" << std::endl;
+      return false;
+    }
+
+    Com<ID3D11Texture2D> sumImage;
+
+    D3D11_TEXTURE2D_DESC imageDesc = { };
+    imageDesc.Width = ImageSize / 4;
+    imageDesc.Height = ImageSize / 4;
+    imageDesc.MipLevels = 1;
+    imageDesc.ArraySize = 1;
+    imageDesc.Format = DXGI_FORMAT_R32_FLOAT;
+    imageDesc.SampleDesc = { 1, 0 };
+    imageDesc.Usage = D3D11_USAGE_DEFAULT;
+    imageDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+
+    if (FAILED(m_device->CreateTexture2D(&imageDesc, nullptr, &sumImage))
+     || FAILED(m_device->CreateUnorderedAccessView(sumImage.ptr(), nullptr, &m_imageSumView))) {
+      std::cerr << "Failed to create image output" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  static bool isTileMapped(uint32_t tile, uint32_t nullPercent) {
+    // Scatter null tiles across the resource rather than
+    // grouping them, so that every wave hits both kinds.
+    uint32_t hash = tile * 2654435761u;
+    return ((hash >> 16) % 100) >= nullPercent;
+  }
+
+  bool mapTiles(ID3D11Resource* resource, uint32_t nullPercent, Com<ID3D11Buffer>& tilePool) {
+    D3D11_SUBRESOURCE_TILING tiling = { };
+    D3D11_PACKED_MIP_DESC packedInfo = { };
+    D3D11_TILE_SHAPE tileShape = { };
+    uint32_t tilingCount = 1;
+    uint32_t tileCount = 0;
+
+    m_device->GetResourceTiling(resource,
+      &tileCount, &packedInfo, &tileShape,
+      &tilingCount, 0, &tiling);
+
+    std::vector<D3D11_TILED_RESOURCE_COORDINATE> coords;
+
+    for (uint32_t y = 0; y < tiling.HeightInTiles; y++) {
+      for (uint32_t x = 0; x < tiling.WidthInTiles; x++) {
+        if (isTileMapped(x + y * tiling.WidthInTiles, nullPercent))
+          coords.push_back({ x, y, 0, 0 });
+      }
+    }
+
+    D3D11_BUFFER_DESC poolDesc = { };
+    poolDesc.ByteWidth = std::max<uint32_t>(coords.size(), 1) << 16;
+    poolDesc.Usage = D3D11_USAGE_DEFAULT;
+    poolDesc.MiscFlags = D3D11_RESOURCE_MISC_TILE_POOL;
+
+    if (FAILED(m_device->CreateBuffer(&poolDesc, nullptr, &tilePool))) {
+      std::cerr << "Failed to create tile pool" << std::endl;
+      return false;
+    }
+
+    if (coords.empty())
+      return true;
+
+    std::vector<D3D11_TILE_REGION_SIZE> regionSizes(coords.size(), { 1, FALSE, 1, 1, 1 });
+
+    UINT rangeFlags = 0;
+    UINT rangeOffset = 0;
+    UINT rangeSize = coords.size();
+
+    HRESULT hr = m_context->UpdateTileMappings(resource,
+      coords.size(), coords.data(), regionSizes.data(), tilePool.ptr(),
+      1, &rangeFlags, &rangeOffset, &rangeSize, 0);
+
+    if (FAILED(hr)) {
+      std::cerr << "UpdateTileMappings failed: 0x" << std::hex << hr << std::dec << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  void testConfig(Kind kind, bool tiled, uint32_t nullPercent) {
+    Com<ID3D11Resource> resource;
+    Com<ID3D11ShaderResourceView> srv;
+    Com<ID3D11UnorderedAccessView> uav;
+    Com<ID3D11Buffer> tilePool;
+
+    uint32_t miscFlags = tiled ? D3D11_RESOURCE_MISC_TILED : 0;
+
+    if (kind == Kind::Buffer) {
+      D3D11_BUFFER_DESC desc = { };
+      desc.ByteWidth = BufferSize;
+      desc.Usage = D3D11_USAGE_DEFAULT;
+      desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+      desc.MiscFlags = miscFlags;
+
+      Com<ID3D11Buffer> buffer;
+
+      if (FAILED(m_device->CreateBuffer(&desc, nullptr, &buffer))) {
+        std::cerr << "Failed to create buffer" << std::endl;
+        return;
+      }
+
+      resource = buffer.ptr();
+
+      D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = { };
+      srvDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
+      srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+      srvDesc.Buffer.NumElements = BufferSize / 16;
+
+      D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = { };
+      uavDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
+      uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+      uavDesc.Buffer.NumElements = BufferSize / 16;
+
+      if (FAILED(m_device->CreateShaderResourceView(resource.ptr(), &srvDesc, &srv))
+       || FAILED(m_device->CreateUnorderedAccessView(resource.ptr(), &uavDesc, &uav))) {
+        std::cerr << "Failed to create buffer views" << std::endl;
+        return;
+      }
+    } else {
+      D3D11_TEXTURE2D_DESC desc = { };
+      desc.Width = ImageSize;
+      desc.Height = ImageSize;
+      desc.MipLevels = 1;
+      desc.ArraySize = 1;
+      desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+      desc.SampleDesc = { 1, 0 };
+      desc.Usage = D3D11_USAGE_DEFAULT;
+      desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+      desc.MiscFlags = miscFlags;
+
+      Com<ID3D11Texture2D> image;
+
+      if (FAILED(m_device->CreateTexture2D(&desc, nullptr, &image))) {
+        std::cerr << "Failed to create image" << std::endl;
+        return;
+      }
+
+      resource = image.ptr();
+
+      if (FAILED(m_device->CreateShaderResourceView(resource.ptr(), nullptr, &srv))
+       || FAILED(m_device->CreateUnorderedAccessView(resource.ptr(), nullptr, &uav))) {
+        std::cerr << "Failed to create image views" << std::endl;
+        return;
+      }
+    }
+
+    if (tiled && !mapTiles(resource.ptr(), nullPercent, tilePool))
+      return;
+
+    // Write first so that the read test sees defined data
+    // in all mapped tiles, then read the result back.
+    double writeMs = measure(kind, false, srv.ptr(), uav.ptr());
+    double readMs  = measure(kind, true,  srv.ptr(), uav.ptr());
+
+    double size = kind == Kind::Buffer
+      ? double(BufferSize)
+      : double(ImageSize) * double(ImageSize) * 4.0;
+
+    std::string name = tiled
+      ? format(kind == Kind::Buffer ? "Tiled buffer" : "Tiled image", ", ", nullPercent, "% null")
+      : std::string(kind == Kind::Buffer ? "Committed buffer" : "Committed image");
+
+    std::cout << name << ":" << std::endl
+              << "  Read:  " << readMs << " ms, " << (size / (readMs * 1.0e6)) << " GB/s" << std::endl
+              << "  Write: " << writeMs << " ms, " << (size / (writeMs * 1.0e6)) << " GB/s" << std::endl;
+  }
+
+  double measure(Kind kind, bool read,
+      ID3D11ShaderResourceView*   srv,
+      ID3D11UnorderedAccessView*  uav) {
+    ShaderArgs args = { };
+
+    if (kind == Kind::Buffer) {
+      args.x = BufferSize / 16;
+      args.y = ThreadCount;
+    } else {
+      args.x = ImageSize;
+      args.y = ImageSize;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped = { };
+
+    if (SUCCEEDED(m_context->Map(m_args.ptr(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+      std::memcpy(mapped.pData, &args, sizeof(args));
+      m_context->Unmap(m_args.ptr(), 0);
+    }
+
+    m_context->ClearState();
+    m_context->CSSetConstantBuffers(0, 1, &m_args);
+
+    if (read) {
+      m_context->CSSetShaderResources(0, 1, &srv);
+
+      if (kind == Kind::Buffer) {
+        m_context->CSSetShader(m_bufferReadShader.ptr(), nullptr, 0);
+        m_context->CSSetUnorderedAccessViews(0, 1, &m_bufferSumView, nullptr);
+      } else {
+        m_context->CSSetShader(m_imageReadShader.ptr(), nullptr, 0);
+        m_context->CSSetUnorderedAccessViews(0, 1, &m_imageSumView, nullptr);
+        m_context->CSSetSamplers(0, 1, &m_sampler);
+      }
+    } else {
+      m_context->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
+      m_context->CSSetShader(kind == Kind::Buffer
+        ? m_bufferWriteShader.ptr()
+        : m_imageWriteShader.ptr(), nullptr, 0);
+    }
+
+    GpuTimer gpuTimer(m_device.ptr());
+
+    for (uint32_t i = 0; i < WarmupCount + IterationCount; i++) {
+      if (i == WarmupCount) {
+        gpuTimer.resolve(m_context.ptr(), true);
+        gpuTimer.stats().clear();
+      }
+
+      gpuTimer.begin(m_context.ptr());
+
+      if (kind == Kind::Buffer)
+        m_context->Dispatch(ThreadCount / 64, 1, 1);
+      else if (read)
+        m_context->Dispatch(ImageSize / 32, ImageSize / 32, 1);
+      else
+        m_context->Dispatch(ImageSize / 8, ImageSize / 8, 1);
+
+      gpuTimer.end(m_context.ptr());
+    }
+
+    gpuTimer.resolve(m_context.ptr(), true);
+    m_context->ClearState();
+    return gpuTimer.stats().avg();
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  TiledAccessApp app;
+  return app.run();
+}
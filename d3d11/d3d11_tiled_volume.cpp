@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <d3dcompiler.h>
+#include <d3d11_2.h>
+
+#include <windows.h>
+#include <windowsx.h>
+
+#include "../common/com.h"
+#include "../common/dxgi_memory.h"
+#include "../common/gpu_timer.h"
+#include "../common/str.h"
+#include "../common/timer.h"
+
+const std::string g_rayMarchShaderCode =
+  "cbuffer cb : register(b0) {\n"
+  "  float3 cam_pos;\n"
+  "  float  step_size;\n"
+  "  float3 cam_dir;\n"
+  "  uint   step_count;\n"
+  "  float3 cam_right;\n"
+  "  uint   out_w;\n"
+  "  float3 cam_up;\n"
+  "  uint   out_h;\n"
+  "};\n"
+  "Texture3D<float> t_volume : register(t0);\n"
+  "SamplerState s_linear : register(s0);\n"
+  "RWTexture2D<float4> u_output : register(u0);\n"
+  "[numthreads(8,8,1)]\n"
+  "void main(uint3 tid : SV_DispatchThreadID) {\n"
+  "  if (tid.x >= out_w || tid.y >= out_h) return;\n"
+  "  float2 ndc = (float2(tid.xy) + 0.5f) / float2(out_w, out_h) * 2.0f - 1.0f;\n"
+  "  float3 dir = normalize(cam_dir + ndc.x * cam_right - ndc.y * cam_up);\n"
+  "  float3 pos = cam_pos;\n"
+  "  float3 color = 0.0f;\n"
+  "  float transmittance = 1.0f;\n"
+  "  for (uint i = 0; i < step_count && transmittance > 0.01f; i++) {\n"
+  "    pos += dir * step_size;\n"
+  "    float density = t_volume.SampleLevel(s_linear, pos, 0.0f);\n"
+  "    float absorb = density * step_size * 64.0f;\n"
+  "    color += transmittance * absorb * float3(0.9f, 0.9f, 1.0f);\n"
+  "    transmittance *= exp(-absorb);\n"
+  "  }\n"
+  "  u_output[tid.xy] = float4(color, 1.0f - transmittance);\n"
+  "}\n";
+
+struct RayMarchArgs {
+  float camPos[3];
+  float stepSize;
+  float camDir[3];
+  uint32_t stepCount;
+  float camRight[3];
+  uint32_t outW;
+  float camUp[3];
+  uint32_t outH;
+};
+
+struct Vec3 {
+  float x, y, z;
+};
+
+class TiledVolumeApp {
+
+public:
+
+  TiledVolumeApp(DXGI_FORMAT format)
+  : m_format(format) {
+    Com<ID3D11Device> device;
+
+    std::vector<D3D_FEATURE_LEVEL> fl = {
+      D3D_FEATURE_LEVEL_12_1,
+      D3D_FEATURE_LEVEL_12_0,
+    };
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, 0, fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &device, nullptr, nullptr))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    if (FAILED(device->QueryInterface(IID_PPV_ARGS(&m_device)))) {
+      std::cerr << "Failed to query ID3D11Device2" << std::endl;
+      return;
+    }
+
+    m_device->GetImmediateContext2(&m_context);
+
+    D3D11_FEATURE_DATA_D3D11_OPTIONS1 options1 = { };
+    m_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS1, &options1, sizeof(options1));
+
+    if (options1.TiledResourcesTier < D3D11_TILED_RESOURCES_TIER_3) {
+      std::cerr << "Tiled resources tier 3 not supported" << std::endl;
+      return;
+    }
+
+    m_memory = MemoryTimeline(m_device.ptr());
+    m_memory.sample("Start");
+
+    m_initialized = createVolume()
+                 && createTilePool()
+                 && createRayMarchResources();
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    GpuTimer gpuTimer(m_device.ptr());
+
+    Stats mapStats;
+    Stats frameStats;
+
+    uint64_t tilesMapped = 0;
+    uint64_t tilesUnmapped = 0;
+    uint64_t tilesDropped = 0;
+
+    Timer totalTimer;
+
+    for (uint32_t frame = 0; frame < FrameCount; frame++) {
+      Timer frameTimer;
+
+      // Move the camera along a circle through the volume
+      float angle = 2.0f * 3.14159265f * float(frame) / float(FrameCount);
+
+      Vec3 camPos = { 0.5f + 0.3f * std::cos(angle), 0.5f + 0.1f * std::sin(3.0f * angle), 0.5f + 0.3f * std::sin(angle) };
+      Vec3 camDir = { -std::sin(angle), 0.0f, std::cos(angle) };
+
+      Timer mapTimer;
+
+      uint32_t dropped = 0;
+      auto counts = updateResidency(camPos, camDir, dropped);
+
+      mapStats.add(mapTimer.ms());
+
+      tilesMapped += counts.first;
+      tilesUnmapped += counts.second;
+      tilesDropped += dropped;
+
+      gpuTimer.begin(m_context.ptr());
+      rayMarch(camPos, camDir);
+      gpuTimer.end(m_context.ptr());
+      gpuTimer.resolve(m_context.ptr(), false);
+
+      frameStats.add(frameTimer.ms());
+    }
+
+    gpuTimer.resolve(m_context.ptr(), true);
+
+    double totalMs = totalTimer.ms();
+
+    m_memory.sample(format("Streaming done, ", m_residentTiles.size(), " tiles"));
+
+    std::cout << std::dec
+              << "Volume: " << VolumeSize << "^3 " << (m_format == DXGI_FORMAT_R8_UNORM ? "R8_UNORM" : "R16_FLOAT")
+              << ", tile shape " << m_tileShape.WidthInTexels << "x" << m_tileShape.HeightInTexels << "x" << m_tileShape.DepthInTexels
+              << ", " << m_tileCountX * m_tileCountY * m_tileCountZ << " tiles" << std::endl
+              << "Frames: " << FrameCount << ", total " << totalMs << " ms" << std::endl
+              << "Tiles mapped: " << tilesMapped << " (" << double(tilesMapped) / FrameCount << " per frame)" << std::endl
+              << "Tiles unmapped: " << tilesUnmapped << " (" << double(tilesUnmapped) / FrameCount << " per frame)" << std::endl
+              << "Tiles dropped (pool exhausted): " << tilesDropped << std::endl
+              << "Mapping CPU ms per frame: avg " << mapStats.avg()
+              << ", p50 " << mapStats.percentile(50.0)
+              << ", p99 " << mapStats.percentile(99.0)
+              << ", max " << mapStats.max() << std::endl
+              << "Frame CPU ms: avg " << frameStats.avg()
+              << ", p50 " << frameStats.percentile(50.0)
+              << ", p99 " << frameStats.percentile(99.0) << std::endl
+              << "Ray march GPU ms: avg " << gpuTimer.stats().avg()
+              << ", p50 " << gpuTimer.stats().percentile(50.0)
+              << ", p99 " << gpuTimer.stats().percentile(99.0) << std::endl;
+
+    releaseResources();
+    m_memory.print(std::cout);
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t VolumeSize    = 1024;
+  constexpr static uint32_t PoolTileCount = 4096;
+  constexpr static uint32_t FrameCount    = 1000;
+  constexpr static uint32_t OutputW       = 1280;
+  constexpr static uint32_t OutputH       = 720;
+
+  constexpr static float ResidencyRadius  = 0.2f;
+  constexpr static float ResidencyOffset  = 0.15f;
+
+  Com<ID3D11Device2>              m_device;
+  Com<ID3D11DeviceContext2>       m_context;
+
+  MemoryTimeline                  m_memory;
+
+  DXGI_FORMAT                     m_format;
+
+  Com<ID3D11Texture3D>            m_volume;
+  Com<ID3D11ShaderResourceView>   m_volumeView;
+  Com<ID3D11Buffer>               m_tilePool;
+
+  Com<ID3D11Texture2D>            m_output;
+  Com<ID3D11UnorderedAccessView>  m_outputView;
+  Com<ID3D11ComputeShader>        m_rayMarchShader;
+  Com<ID3D11Buffer>               m_rayMarchArgs;
+  Com<ID3D11SamplerState>         m_sampler;
+
+  D3D11_TILE_SHAPE                m_tileShape = { };
+
+  uint32_t                        m_tileCountX = 0;
+  uint32_t                        m_tileCountY = 0;
+  uint32_t                        m_tileCountZ = 0;
+
+  std::unordered_map<uint32_t, uint32_t> m_residentTiles;
+  std::vector<uint32_t>           m_freeTiles;
+
+  std::array<std::vector<uint8_t>, 4> m_tileData;
+
+  bool m_initialized = false;
+
+  bool createVolume() {
+    D3D11_TEXTURE3D_DESC desc = { };
+    desc.Width      = VolumeSize;
+    desc.Height     = VolumeSize;
+    desc.Depth      = VolumeSize;
+    desc.MipLevels  = 1;
+    desc.Format     = m_format;
+    desc.Usage      = D3D11_USAGE_DEFAULT;
+    desc.BindFlags  = D3D11_BIND_SHADER_RESOURCE;
+    desc.MiscFlags  = D3D11_RESOURCE_MISC_TILED;
+
+    if (FAILED(m_device->CreateTexture3D(&desc, nullptr, &m_volume))) {
+      std::cerr << "Failed to create tiled 3D texture" << std::endl;
+      return false;
+    }
+
+    if (FAILED(m_device->CreateShaderResourceView(m_volume.ptr(), nullptr, &m_volumeView))) {
+      std::cerr << "Failed to create volume view" << std::endl;
+      return false;
+    }
+
+    D3D11_SUBRESOURCE_TILING tiling = { };
+    D3D11_PACKED_MIP_DESC packedInfo = { };
+    uint32_t tilingCount = 1;
+    uint32_t tileCount = 0;
+
+    m_device->GetResourceTiling(m_volume.ptr(),
+      &tileCount, &packedInfo, &m_tileShape,
+      &tilingCount, 0, &tiling);
+
+    m_tileCountX = tiling.WidthInTiles;
+    m_tileCountY = tiling.HeightInTiles;
+    m_tileCountZ = tiling.DepthInTiles;
+
+    // Pre-generate a few tiles worth of noise. The actual
+    // texel layout within a tile is irrelevant here.
+    uint32_t seed = 1;
+
+    for (auto& data : m_tileData) {
+      data.resize(65536);
+
+      if (m_format == DXGI_FORMAT_R8_UNORM) {
+        for (auto& b : data) {
+          seed = seed * 1664525u + 1013904223u;
+          b = uint8_t((seed >> 24) & 0x3f);
+        }
+      } else {
+        auto halfs = reinterpret_cast<uint16_t*>(data.data());
+
+        for (size_t i = 0; i < data.size() / 2; i++) {
+          seed = seed * 1664525u + 1013904223u;
+          halfs[i] = uint16_t(0x2000 | ((seed >> 20) & 0xfff));
+        }
+      }
+    }
+
+    m_memory.sample("Create tiled volume");
+    return true;
+  }
+
+  bool createTilePool() {
+    D3D11_BUFFER_DESC desc = { };
+    desc.ByteWidth = PoolTileCount << 16;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_TILE_POOL;
+
+    if (FAILED(m_device->CreateBuffer(&desc, nullptr, &m_tilePool))) {
+      std::cerr << "Failed to create tile pool" << std::endl;
+      return false;
+    }
+
+    for (uint32_t i = PoolTileCount; i; i--)
+      m_freeTiles.push_back(i - 1);
+
+    m_memory.sample(format("Create ", PoolTileCount >> 4, " MiB tile pool"));
+    return true;
+  }
+
+  bool createRayMarchResources() {
+    D3D11_TEXTURE2D_DESC outputDesc = { };
+    outputDesc.Width      = OutputW;
+    outputDesc.Height     = OutputH;
+    outputDesc.MipLevels  = 1;
+    outputDesc.ArraySize  = 1;
+    outputDesc.SampleDesc = { 1, 0 };
+    outputDesc.Format     = DXGI_FORMAT_R8G8B8A8_UNORM;
+    outputDesc.Usage      = D3D11_USAGE_DEFAULT;
+    outputDesc.BindFlags  = D3D11_BIND_UNORDERED_ACCESS;
+
+    if (FAILED(m_device->CreateTexture2D(&outputDesc, nullptr, &m_output))
+     || FAILED(m_device->CreateUnorderedAccessView(m_output.ptr(), nullptr, &m_outputView))) {
+      std::cerr << "Failed to create output image" << std::endl;
+      return false;
+    }
+
+    D3D11_BUFFER_DESC argsDesc = { };
+    argsDesc.ByteWidth = sizeof(RayMarchArgs);
+    argsDesc.Usage = D3D11_USAGE_DYNAMIC;
+    argsDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    argsDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    if (FAILED(m_device->CreateBuffer(&argsDesc, nullptr, &m_rayMarchArgs))) {
+      std::cerr << "Failed to create constant buffer" << std::endl;
+      return false;
+    }
+
+    D3D11_SAMPLER_DESC samplerDesc = { };
+    samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+    samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+    samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+    samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+    samplerDesc.MaxLOD = 0.0f;
+
+    if (FAILED(m_device->CreateSamplerState(&samplerDesc, &m_sampler))) {
+      std::cerr << "Failed to create sampler" << std::endl;
+      return false;
+    }
+
+    Com<ID3DBlob> csBlob;
+
+    if (FAILED(D3DCompile(g_rayMarchShaderCode.data(), g_rayMarchShaderCode.size(),
+        "Ray march shader", nullptr, nullptr, "main", "cs_5_0", 0, 0, &csBlob, nullptr))) {
+      std::cerr << "Failed to compile compute shader" << std::endl;
+      return false;
+    }
+
+    if (FAILED(m_device->CreateComputeShader(
+        csBlob->GetBufferPointer(),
+        csBlob->GetBufferSize(),
+        nullptr, &m_rayMarchShader))) {
+      std::cerr << "Failed to create compute shader" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+    * \brief Updates tile residency around the camera
+    *
+    * Unmaps tiles that left the region of interest and maps
+    * and uploads tiles that entered it, each with a single
+    * UpdateTileMappings call.
+    * \returns Number of mapped and unmapped tiles
+    */
+  std::pair<uint32_t, uint32_t> updateResidency(const Vec3& camPos, const Vec3& camDir, uint32_t& dropped) {
+    Vec3 center = {
+      camPos.x + camDir.x * ResidencyOffset,
+      camPos.y + camDir.y * ResidencyOffset,
+      camPos.z + camDir.z * ResidencyOffset };
+
+    float tileW = float(m_tileShape.WidthInTexels)  / float(VolumeSize);
+    float tileH = float(m_tileShape.HeightInTexels) / float(VolumeSize);
+    float tileD = float(m_tileShape.DepthInTexels)  / float(VolumeSize);
+
+    auto isWanted = [&] (uint32_t x, uint32_t y, uint32_t z) {
+      float dx = (float(x) + 0.5f) * tileW - center.x;
+      float dy = (float(y) + 0.5f) * tileH - center.y;
+      float dz = (float(z) + 0.5f) * tileD - center.z;
+      return dx * dx + dy * dy + dz * dz < ResidencyRadius * ResidencyRadius;
+    };
+
+    std::vector<D3D11_TILED_RESOURCE_COORDINATE> unmapCoords;
+    std::vector<D3D11_TILED_RESOURCE_COORDINATE> mapCoords;
+    std::vector<UINT> mapOffsets;
+
+    // Evict tiles first so that their pool tiles can be reused
+    for (auto i = m_residentTiles.begin(); i != m_residentTiles.end(); ) {
+      uint32_t x = i->first % m_tileCountX;
+      uint32_t y = (i->first / m_tileCountX) % m_tileCountY;
+      uint32_t z = i->first / (m_tileCountX * m_tileCountY);
+
+      if (!isWanted(x, y, z)) {
+        unmapCoords.push_back({ x, y, z, 0 });
+        m_freeTiles.push_back(i->second);
+        i = m_residentTiles.erase(i);
+      } else {
+        i++;
+      }
+    }
+
+    uint32_t x0 = uint32_t(std::max(0.0f, (center.x - ResidencyRadius) / tileW));
+    uint32_t y0 = uint32_t(std::max(0.0f, (center.y - ResidencyRadius) / tileH));
+    uint32_t z0 = uint32_t(std::max(0.0f, (center.z - ResidencyRadius) / tileD));
+    uint32_t x1 = std::min(m_tileCountX, uint32_t(std::max(0.0f, (center.x + ResidencyRadius) / tileW)) + 1);
+    uint32_t y1 = std::min(m_tileCountY, uint32_t(std::max(0.0f, (center.y + ResidencyRadius) / tileH)) + 1);
+    uint32_t z1 = std::min(m_tileCountZ, uint32_t(std::max(0.0f, (center.z + ResidencyRadius) / tileD)) + 1);
+
+    for (uint32_t z = z0; z < z1; z++) {
+      for (uint32_t y = y0; y < y1; y++) {
+        for (uint32_t x = x0; x < x1; x++) {
+          uint32_t index = x + m_tileCountX * (y + m_tileCountY * z);
+
+          if (!isWanted(x, y, z) || m_residentTiles.count(index))
+            continue;
+
+          if (m_freeTiles.empty()) {
+            dropped += 1;
+            continue;
+          }
+
+          uint32_t poolTile = m_freeTiles.back();
+          m_freeTiles.pop_back();
+
+          m_residentTiles.insert({ index, poolTile });
+          mapCoords.push_back({ x, y, z, 0 });
+          mapOffsets.push_back(poolTile);
+        }
+      }
+    }
+
+    if (!unmapCoords.empty()) {
+      std::vector<D3D11_TILE_REGION_SIZE> regionSizes(unmapCoords.size(), { 1, FALSE, 1, 1, 1 });
+
+      UINT rangeFlags = D3D11_TILE_RANGE_NULL;
+      UINT rangeOffset = 0;
+      UINT rangeSize = unmapCoords.size();
+
+      m_context->UpdateTileMappings(m_volume.ptr(),
+        unmapCoords.size(), unmapCoords.data(), regionSizes.data(), m_tilePool.ptr(),
+        1, &rangeFlags, &rangeOffset, &rangeSize, 0);
+    }
+
+    if (!mapCoords.empty()) {
+      std::vector<D3D11_TILE_REGION_SIZE> regionSizes(mapCoords.size(), { 1, FALSE, 1, 1, 1 });
+      std::vector<UINT> rangeFlags(mapCoords.size(), 0);
+      std::vector<UINT> rangeSizes(mapCoords.size(), 1);
+
+      m_context->UpdateTileMappings(m_volume.ptr(),
+        mapCoords.size(), mapCoords.data(), regionSizes.data(), m_tilePool.ptr(),
+        mapOffsets.size(), rangeFlags.data(), mapOffsets.data(), rangeSizes.data(), 0);
+
+      D3D11_TILE_REGION_SIZE tileSize = { 1, FALSE, 1, 1, 1 };
+
+      for (const auto& coord : mapCoords) {
+        const auto& data = m_tileData[(coord.X ^ coord.Y ^ coord.Z) % m_tileData.size()];
+        m_context->UpdateTiles(m_volume.ptr(), &coord, &tileSize, data.data(), 0);
+      }
+    }
+
+    return { uint32_t(mapCoords.size()), uint32_t(unmapCoords.size()) };
+  }
+
+  void releaseResources() {
+    D3D11_TILED_RESOURCE_COORDINATE regionCoord = { 0, 0, 0, 0 };
+    D3D11_TILE_REGION_SIZE regionSize = { 0, TRUE,
+      m_tileCountX, uint16_t(m_tileCountY), uint16_t(m_tileCountZ) };
+    regionSize.NumTiles = m_tileCountX * m_tileCountY * m_tileCountZ;
+
+    UINT rangeFlags = D3D11_TILE_RANGE_NULL;
+    UINT rangeOffset = 0;
+    UINT rangeSize = regionSize.NumTiles;
+
+    m_context->ClearState();
+    m_context->UpdateTileMappings(m_volume.ptr(),
+      1, &regionCoord, &regionSize, m_tilePool.ptr(),
+      1, &rangeFlags, &rangeOffset, &rangeSize, 0);
+    m_context->Flush();
+
+    m_residentTiles.clear();
+    m_memory.sample("Unmap all tiles");
+
+    m_tilePool = nullptr;
+    m_context->Flush();
+    m_memory.sample("Release tile pool");
+
+    m_volumeView = nullptr;
+    m_volume = nullptr;
+    m_context->Flush();
+    m_memory.sample("Release tiled volume");
+  }
+
+  void rayMarch(const Vec3& camPos, const Vec3& camDir) {
+    D3D11_MAPPED_SUBRESOURCE mapped = { };
+
+    if (SUCCEEDED(m_context->Map(m_rayMarchArgs.ptr(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+      float aspect = float(OutputW) / float(OutputH);
+
+      RayMarchArgs args = { };
+      args.camPos[0] = camPos.x;
+      args.camPos[1] = camPos.y;
+      args.camPos[2] = camPos.z;
+      args.stepSize = 1.0f / 512.0f;
+      args.camDir[0] = camDir.x;
+      args.camDir[1] = camDir.y;
+      args.camDir[2] = camDir.z;
+      args.stepCount = 256;
+      args.camRight[0] = -camDir.z * 0.5f * aspect;
+      args.camRight[1] = 0.0f;
+      args.camRight[2] = camDir.x * 0.5f * aspect;
+      args.outW = OutputW;
+      args.camUp[0] = 0.0f;
+      args.camUp[1] = 0.5f;
+      args.camUp[2] = 0.0f;
+      args.outH = OutputH;
+
+      std::memcpy(mapped.pData, &args, sizeof(args));
+      m_context->Unmap(m_rayMarchArgs.ptr(), 0);
+    }
+
+    m_context->CSSetShader(m_rayMarchShader.ptr(), nullptr, 0);
+    m_context->CSSetConstantBuffers(0, 1, &m_rayMarchArgs);
+    m_context->CSSetShaderResources(0, 1, &m_volumeView);
+    m_context->CSSetSamplers(0, 1, &m_sampler);
+    m_context->CSSetUnorderedAccessViews(0, 1, &m_outputView, nullptr);
+    m_context->Dispatch((OutputW + 7) / 8, (OutputH + 7) / 8, 1);
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  DXGI_FORMAT format = DXGI_FORMAT_R8_UNORM;
+
+  if (lpCmdLine && std::strstr(lpCmdLine, "r16f"))
+    format = DXGI_FORMAT_R16_FLOAT;
+
+  TiledVolumeApp app(format);
+  return app.run();
+}
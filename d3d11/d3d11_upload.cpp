@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <d3d11_3.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/str.h"
+#include "../common/timer.h"
+
+enum class UploadPath : uint32_t {
+  UpdateSubresource,
+  DynamicMap,
+  StagingCopy,
+  DefaultMap,
+};
+
+enum class PitchMode : uint32_t {
+  Tight,
+  Aligned,
+  Padded,
+};
+
+struct UploadConfig {
+  uint32_t  size;
+  uint32_t  mips;
+  PitchMode pitchMode;
+};
+
+struct SourceMip {
+  uint32_t              width;
+  uint32_t              height;
+  uint32_t              pitch;
+  std::vector<uint8_t>  data;
+};
+
+class UploadApp {
+
+public:
+
+  UploadApp() {
+    std::array<D3D_FEATURE_LEVEL, 2> fl = {
+      D3D_FEATURE_LEVEL_11_1,
+      D3D_FEATURE_LEVEL_11_0,
+    };
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, 0, fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &m_device, nullptr, &m_context))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    D3D11_FEATURE_DATA_D3D11_OPTIONS2 options2 = { };
+
+    if (SUCCEEDED(m_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS2, &options2, sizeof(options2))))
+      m_mapOnDefaultTextures = options2.MapOnDefaultTextures;
+
+    // Default textures with an undefined layout can only be written
+    // through WriteToSubresource while mapped
+    if (m_mapOnDefaultTextures && FAILED(m_device->QueryInterface(IID_PPV_ARGS(&m_device3))))
+      m_mapOnDefaultTextures = FALSE;
+
+    std::cout << "MapOnDefaultTextures: " << m_mapOnDefaultTextures << std::endl;
+
+    D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT };
+
+    if (FAILED(m_device->CreateQuery(&queryDesc, &m_query))) {
+      std::cerr << "Failed to create event query" << std::endl;
+      return;
+    }
+
+    m_initialized = true;
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    static const std::array<const char*, 4> s_pathNames = {{
+      "UpdateSubresource", "Map DYNAMIC", "Staging + copy", "Map DEFAULT",
+    }};
+
+    static const std::array<const char*, 3> s_pitchNames = {{
+      "tight", "256-aligned", "padded",
+    }};
+
+    std::cout << std::left << std::setw(12) << "Size" << std::setw(6) << "Mips"
+              << std::setw(13) << "Pitch" << std::setw(20) << "Path" << std::right
+              << std::setw(12) << "CPU ms" << std::setw(12) << "Total ms" << std::setw(12) << "MB/s" << std::endl;
+
+    for (uint32_t size : { 256u, 1024u, 4096u }) {
+      for (uint32_t mips : { 1u, 0u }) {
+        for (auto pitchMode : { PitchMode::Tight, PitchMode::Aligned, PitchMode::Padded }) {
+          UploadConfig config = { size, mips ? mips : fullMipCount(size), pitchMode };
+          auto source = createSourceData(config);
+
+          for (uint32_t p = 0; p < s_pathNames.size(); p++) {
+            double cpuMs = 0.0;
+            double totalMs = 0.0;
+            uint64_t bytes = 0;
+
+            std::cout << std::left << std::setw(12) << format(size, "x", size)
+                      << std::setw(6) << config.mips << std::setw(13) << s_pitchNames[uint32_t(pitchMode)]
+                      << std::setw(20) << s_pathNames[p] << std::right;
+
+            if (!runTest(UploadPath(p), config, source, cpuMs, totalMs, bytes)) {
+              std::cout << std::setw(12) << "n/a" << std::endl;
+              continue;
+            }
+
+            std::cout << std::fixed << std::setprecision(3)
+                      << std::setw(12) << cpuMs << std::setw(12) << totalMs
+                      << std::setprecision(1)
+                      << std::setw(12) << (double(bytes) / double(1u << 20)) / (totalMs / 1000.0)
+                      << std::defaultfloat << std::endl;
+          }
+        }
+      }
+    }
+
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t StagingRingSize = 4;
+  constexpr static uint64_t BytesPerTest    = 256ull << 20;
+
+  Com<ID3D11Device>         m_device;
+  Com<ID3D11Device3>        m_device3;
+  Com<ID3D11DeviceContext>  m_context;
+  Com<ID3D11Query>          m_query;
+
+  BOOL m_mapOnDefaultTextures = FALSE;
+  bool m_initialized = false;
+
+  static uint32_t fullMipCount(uint32_t size) {
+    uint32_t count = 1;
+
+    while (size > 1) {
+      size >>= 1;
+      count += 1;
+    }
+
+    return count;
+  }
+
+  static std::vector<SourceMip> createSourceData(const UploadConfig& config) {
+    std::vector<SourceMip> result(config.mips);
+
+    for (uint32_t m = 0; m < config.mips; m++) {
+      auto& mip = result[m];
+      mip.width = std::max(config.size >> m, 1u);
+      mip.height = std::max(config.size >> m, 1u);
+
+      uint32_t rowSize = 4 * mip.width;
+
+      switch (config.pitchMode) {
+        case PitchMode::Tight:   mip.pitch = rowSize; break;
+        case PitchMode::Aligned: mip.pitch = (rowSize + 255u) & ~255u; break;
+        case PitchMode::Padded:  mip.pitch = rowSize + 68u; break;
+      }
+
+      mip.data.resize(size_t(mip.pitch) * mip.height);
+
+      for (size_t i = 0; i < mip.data.size(); i++)
+        mip.data[i] = uint8_t(i * 7 + m);
+    }
+
+    return result;
+  }
+
+  static void copyRows(void* dst, uint32_t dstPitch, const SourceMip& mip) {
+    auto dstBytes = reinterpret_cast<uint8_t*>(dst);
+
+    if (dstPitch == mip.pitch) {
+      std::memcpy(dstBytes, mip.data.data(), size_t(mip.pitch) * mip.height);
+      return;
+    }
+
+    for (uint32_t y = 0; y < mip.height; y++) {
+      std::memcpy(&dstBytes[size_t(y) * dstPitch],
+        &mip.data[size_t(y) * mip.pitch], 4 * mip.width);
+    }
+  }
+
+  Com<ID3D11Texture2D> createTexture(const UploadConfig& config, D3D11_USAGE usage, UINT bindFlags, UINT cpuFlags) {
+    D3D11_TEXTURE2D_DESC desc = { };
+    desc.Width = config.size;
+    desc.Height = config.size;
+    desc.MipLevels = config.mips;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc = { 1, 0 };
+    desc.Usage = usage;
+    desc.BindFlags = bindFlags;
+    desc.CPUAccessFlags = cpuFlags;
+
+    Com<ID3D11Texture2D> texture;
+
+    if (FAILED(m_device->CreateTexture2D(&desc, nullptr, &texture)))
+      return nullptr;
+
+    return texture;
+  }
+
+  void waitForIdle() {
+    m_context->End(m_query.ptr());
+    m_context->Flush();
+
+    while (m_context->GetData(m_query.ptr(), nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+      continue;
+  }
+
+  bool runTest(UploadPath path, const UploadConfig& config, const std::vector<SourceMip>& source,
+      double& cpuMs, double& totalMs, uint64_t& bytes) {
+    Com<ID3D11Texture2D> texture;
+    std::array<Com<ID3D11Texture2D>, StagingRingSize> staging;
+
+    switch (path) {
+      case UploadPath::UpdateSubresource:
+        texture = createTexture(config, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0);
+        break;
+
+      case UploadPath::DynamicMap:
+        // Dynamic textures cannot have more than one subresource
+        if (config.mips > 1)
+          return false;
+
+        texture = createTexture(config, D3D11_USAGE_DYNAMIC, D3D11_BIND_SHADER_RESOURCE, D3D11_CPU_ACCESS_WRITE);
+        break;
+
+      case UploadPath::StagingCopy:
+        texture = createTexture(config, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0);
+
+        for (auto& s : staging) {
+          s = createTexture(config, D3D11_USAGE_STAGING, 0, D3D11_CPU_ACCESS_WRITE);
+
+          if (s == nullptr)
+            return false;
+        }
+        break;
+
+      case UploadPath::DefaultMap:
+        if (!m_mapOnDefaultTextures)
+          return false;
+
+        texture = createTexture(config, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, D3D11_CPU_ACCESS_WRITE);
+        break;
+    }
+
+    if (texture == nullptr)
+      return false;
+
+    uint64_t uploadSize = 0;
+
+    for (const auto& mip : source)
+      uploadSize += 4ull * mip.width * mip.height;
+
+    uint32_t iterations = uint32_t(std::clamp<uint64_t>(BytesPerTest / uploadSize, 4, 1000));
+
+    // Run once so that allocations don't show up in the timings
+    if (!upload(path, texture.ptr(), staging, 0, source))
+      return false;
+
+    waitForIdle();
+
+    Timer totalTimer;
+    cpuMs = 0.0;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+      Timer cpuTimer;
+
+      if (!upload(path, texture.ptr(), staging, i, source))
+        return false;
+
+      cpuMs += cpuTimer.ms();
+    }
+
+    waitForIdle();
+
+    totalMs = totalTimer.ms();
+    cpuMs /= double(iterations);
+    bytes = uploadSize * iterations;
+    return true;
+  }
+
+  bool upload(UploadPath path, ID3D11Texture2D* texture,
+      const std::array<Com<ID3D11Texture2D>, StagingRingSize>& staging,
+      uint32_t iteration, const std::vector<SourceMip>& source) {
+    ID3D11Texture2D* stagingTexture = staging[iteration % StagingRingSize].ptr();
+
+    for (uint32_t m = 0; m < source.size(); m++) {
+      const auto& mip = source[m];
+      D3D11_MAPPED_SUBRESOURCE mapped = { };
+
+      switch (path) {
+        case UploadPath::UpdateSubresource:
+          m_context->UpdateSubresource(texture, m, nullptr, mip.data.data(), mip.pitch, 0);
+          break;
+
+        case UploadPath::DynamicMap:
+          if (FAILED(m_context->Map(texture, m, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+            return false;
+
+          copyRows(mapped.pData, mapped.RowPitch, mip);
+          m_context->Unmap(texture, m);
+          break;
+
+        case UploadPath::StagingCopy:
+          if (FAILED(m_context->Map(stagingTexture, m, D3D11_MAP_WRITE, 0, &mapped)))
+            return false;
+
+          copyRows(mapped.pData, mapped.RowPitch, mip);
+          m_context->Unmap(stagingTexture, m);
+
+          m_context->CopySubresourceRegion(texture, m, 0, 0, 0, stagingTexture, m, nullptr);
+          break;
+
+        case UploadPath::DefaultMap:
+          // The texture uses the default layout, so it must be mapped
+          // without a pointer and written through the device instead
+          if (FAILED(m_context->Map(texture, m, D3D11_MAP_WRITE, 0, nullptr)))
+            return false;
+
+          m_device3->WriteToSubresource(texture, m, nullptr, mip.data.data(), mip.pitch, 0);
+          m_context->Unmap(texture, m);
+          break;
+      }
+    }
+
+    return true;
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  UploadApp app;
+  return app.run();
+}
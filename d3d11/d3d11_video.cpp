@@ -2,7 +2,11 @@
 #include <array>
 #include <cmath>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <d3d11_1.h>
@@ -11,14 +15,27 @@
 #include <windowsx.h>
 
 #include "../common/com.h"
+#include "../common/gpu_timer.h"
 #include "../common/str.h"
+#include "../common/timer.h"
+#include "../common/yuv_convert.h"
+#include "../common/yuv_sequence.h"
 
 class VideoApp {
   
 public:
   
-  VideoApp(HINSTANCE instance, HWND window)
-  : m_window(window) {
+  VideoApp(HINSTANCE instance, HWND window, bool direct, const YuvSequenceDesc& stream)
+  : m_window(window), m_direct(direct) {
+    if (!stream.path.empty()) {
+      m_sequence = std::make_unique<YuvSequence>(stream);
+
+      if (!m_sequence->valid()) {
+        std::cerr << "Failed to open " << stream.path << " or file too small for one frame" << std::endl;
+        return;
+      }
+    }
+
     // Create base D3D11 device and swap chain
     DXGI_SWAP_CHAIN_DESC swapchainDesc = { };
     swapchainDesc.BufferDesc.Width = m_windowSizeX;
@@ -74,11 +91,11 @@ public:
     D3D11_VIDEO_PROCESSOR_CONTENT_DESC videoEnumDesc = { };
     videoEnumDesc.InputFrameFormat = D3D11_VIDEO_FRAME_FORMAT_PROGRESSIVE;
     videoEnumDesc.InputFrameRate = { 60, 1 };
-    videoEnumDesc.InputWidth = 128;
-    videoEnumDesc.InputHeight = 128;
+    videoEnumDesc.InputWidth = m_sequence ? stream.width : 128;
+    videoEnumDesc.InputHeight = m_sequence ? stream.height : 128;
     videoEnumDesc.OutputFrameRate = { 60, 1 };
-    videoEnumDesc.OutputWidth = 256;
-    videoEnumDesc.OutputHeight = 256;
+    videoEnumDesc.OutputWidth = m_sequence ? m_windowSizeX : 256;
+    videoEnumDesc.OutputHeight = m_sequence ? m_windowSizeY : 256;
     videoEnumDesc.Usage = D3D11_VIDEO_USAGE_PLAYBACK_NORMAL;
     
     if (FAILED(hr = m_vdevice->CreateVideoProcessorEnumerator(&videoEnumDesc, &m_venum))) {
@@ -91,6 +108,17 @@ public:
       return;
     }
 
+    // Streaming always blits directly into the swap chain image
+    if (m_sequence) {
+      m_initialized = createSwapImageOutputView() && createStreamResources();
+      return;
+    }
+
+    if (m_direct && !createSwapImageOutputView()) {
+      std::cerr << "Falling back to blit + copy" << std::endl;
+      m_direct = false;
+    }
+
     // Video output image and view
     D3D11_TEXTURE2D_DESC textureDesc = { };
     textureDesc.Width = 256;
@@ -136,9 +164,13 @@ public:
     size_t imageSizeYuy2 = textureDesc.Height * rowSizeYuy2;
 
     std::vector<uint8_t> srcData(pixelCount * 3);
-    std::vector<uint8_t> imgDataRgba(imageSizeRgba);
-    std::vector<uint8_t> imgDataNv12(imageSizeNv12);
-    std::vector<uint8_t> imgDataYuy2(imageSizeYuy2);
+    std::vector<uint8_t>& imgDataRgba = m_imgDataRgba;
+    std::vector<uint8_t>& imgDataNv12 = m_imgDataNv12;
+    std::vector<uint8_t>& imgDataYuy2 = m_imgDataYuy2;
+
+    imgDataRgba.resize(imageSizeRgba);
+    imgDataNv12.resize(imageSizeNv12);
+    imgDataYuy2.resize(imageSizeYuy2);
     std::ifstream ifile("video_image.raw", std::ios::binary);
 
     if (!ifile || !ifile.read(reinterpret_cast<char*>(srcData.data()), srcData.size())) {
@@ -151,23 +183,27 @@ public:
       imgDataRgba[4 * i + 1] = srcData[3 * i + 1];
       imgDataRgba[4 * i + 2] = srcData[3 * i + 2];
       imgDataRgba[4 * i + 3] = 0xFF;
-
-      imgDataNv12[i] = y_coeff(&srcData[3 * i], 0.299000f, 0.587000f, 0.114000f);
-
-      imgDataYuy2[2 * i + 0] = y_coeff(&srcData[3 * i], 0.299000f, 0.587000f, 0.114000f);
-      imgDataYuy2[2 * i + 1] = i % 2
-        ? c_coeff(&srcData[3 * i], -0.168736f, -0.331264f,  0.500000f)
-        : c_coeff(&srcData[3 * i],  0.500000f, -0.418688f, -0.081312f);
     }
 
-    for (size_t y = 0; y < textureDesc.Height / 2; y++) {
-      for (size_t x = 0; x < textureDesc.Width / 2; x++) {
-        size_t p = textureDesc.Width * (2 * y) + 2 * x;
-        size_t i = pixelCount + textureDesc.Width * y + 2 * x;
-        imgDataNv12[i + 0] = c_coeff(&srcData[3 * p],  0.500000f, -0.418688f, -0.081312f);
-        imgDataNv12[i + 1] = c_coeff(&srcData[3 * p], -0.168736f, -0.331264f,  0.500000f);
-      }
-    }
+    // The image is uploaded as BGRA, so convert it the same way
+    yuv::ConvertArgs convertArgs;
+    convertArgs.matrix = yuv::Matrix::BT601;
+    convertArgs.range = yuv::Range::Limited;
+    convertArgs.rgbOrder = yuv::RgbOrder::BGRA;
+    convertArgs.width = textureDesc.Width;
+    convertArgs.height = textureDesc.Height;
+    convertArgs.src = imgDataRgba.data();
+    convertArgs.srcPitch = rowSizeRgba;
+
+    convertArgs.format = yuv::Format::NV12;
+    convertArgs.dst = imgDataNv12.data();
+    convertArgs.dstPitch = rowSizeNv12;
+    yuv::convert(convertArgs);
+
+    convertArgs.format = yuv::Format::YUY2;
+    convertArgs.dst = imgDataYuy2.data();
+    convertArgs.dstPitch = rowSizeYuy2;
+    yuv::convert(convertArgs);
 
     D3D11_SUBRESOURCE_DATA subresourceData = { };
     subresourceData.pSysMem = imgDataRgba.data();
@@ -236,6 +272,9 @@ public:
       std::cerr << "YUY2 not supported" << std::endl;
     }
 
+    if (!createVerifyResources())
+      return;
+
     m_initialized = true;
   }
   
@@ -246,61 +285,433 @@ public:
   
   
   void run() {
+    if (m_sequence)
+      renderStreamFrame();
+    else
+      renderFrame(nullptr);
+  }
+
+
+  /**
+    * \brief Compares the copy and direct output paths
+    *
+    * Renders a fixed number of frames with each path and
+    * reports the GPU time spent on the video blits, followed
+    * by the measured cost of the clears and copies that only
+    * the copy path needs.
+    */
+  void runBenchmark() {
+    if (m_sequence) {
+      runStreamBenchmark();
+      return;
+    }
+
+    bool directSupported = m_direct || createSwapImageOutputView();
+    m_benchmark = true;
+
+    std::cout << std::left << std::setw(20) << "Path" << std::right
+              << std::setw(12) << "Frame ms" << std::setw(12) << "GPU ms"
+              << std::setw(12) << "GPU p99" << std::endl;
+
+    for (bool direct : { false, true }) {
+      std::cout << std::left << std::setw(20) << (direct ? "Direct to swap chain" : "Clear + blit + copy") << std::right;
+
+      if (direct && !directSupported) {
+        std::cout << std::setw(12) << "n/a" << std::endl;
+        continue;
+      }
+
+      m_direct = direct;
+
+      GpuTimer gpuTimer(m_device.ptr());
+      Stats frameStats;
+
+      for (uint32_t i = 0; i < BenchmarkWarmupFrames + BenchmarkFrames; i++) {
+        MSG msg;
+
+        while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+          TranslateMessage(&msg);
+          DispatchMessage(&msg);
+        }
+
+        Timer timer;
+        renderFrame(i < BenchmarkWarmupFrames ? nullptr : &gpuTimer);
+
+        if (i >= BenchmarkWarmupFrames)
+          frameStats.add(timer.ms());
+      }
+
+      gpuTimer.resolve(m_context.ptr(), true);
+
+      std::cout << std::fixed << std::setprecision(3)
+                << std::setw(12) << frameStats.percentile(50.0)
+                << std::setw(12) << gpuTimer.stats().percentile(50.0)
+                << std::setw(12) << gpuTimer.stats().percentile(99.0)
+                << std::defaultfloat << std::endl;
+    }
+
+    measureIntermediateTraffic();
+  }
+
+
+  /**
+    * \brief Measures the work that direct output avoids
+    *
+    * The copy path clears the intermediate image, then reads and
+    * writes it again for the copy. The blit itself writes the
+    * same amount of data in both cases. Times the clears and the
+    * copies of one frame separately and derives the bandwidth
+    * they use from the number of bytes each one touches.
+    */
+  void measureIntermediateTraffic() {
+    GpuTimer clearTimer(m_device.ptr());
+    GpuTimer copyTimer(m_device.ptr());
+
+    D3D11_BOX box = { 0, 0, 0,
+      std::min(VideoOutputSize, m_windowSizeX),
+      std::min(VideoOutputSize, m_windowSizeY), 1 };
+
+    FLOAT red[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
+
+    for (uint32_t i = 0; i < BenchmarkWarmupFrames + BenchmarkFrames; i++) {
+      bool measure = i >= BenchmarkWarmupFrames;
+
+      if (measure)
+        clearTimer.begin(m_context.ptr());
+
+      for (uint32_t j = 0; j < BlitsPerFrame; j++)
+        m_context->ClearRenderTargetView(m_videoOutputRtv.ptr(), red);
+
+      if (measure) {
+        clearTimer.end(m_context.ptr());
+        copyTimer.begin(m_context.ptr());
+      }
+
+      for (uint32_t j = 0; j < BlitsPerFrame; j++)
+        m_context->CopySubresourceRegion(m_swapImage.ptr(), 0, 0, 0, 0, m_videoOutput.ptr(), 0, &box);
+
+      if (measure) {
+        copyTimer.end(m_context.ptr());
+        clearTimer.resolve(m_context.ptr(), false);
+        copyTimer.resolve(m_context.ptr(), false);
+      }
+    }
+
+    clearTimer.resolve(m_context.ptr(), true);
+    copyTimer.resolve(m_context.ptr(), true);
+
+    double clearBytes = double(BlitsPerFrame) * double(VideoOutputSize * VideoOutputSize * 4);
+    double copyBytes = double(BlitsPerFrame) * double(2 * (box.right - box.left) * (box.bottom - box.top) * 4);
+
+    std::cout << "Intermediate image traffic avoided by direct output (measured):" << std::endl;
+
+    std::array<std::pair<const char*, GpuTimer*>, 2> timers = {{
+      { "Clear", &clearTimer },
+      { "Copy",  &copyTimer  },
+    }};
+
+    std::array<double, 2> bytes = {{ clearBytes, copyBytes }};
+
+    for (uint32_t i = 0; i < timers.size(); i++) {
+      std::cout << "  " << std::left << std::setw(7) << timers[i].first << std::right;
+
+      if (!timers[i].second->stats().count()) {
+        std::cout << "n/a" << std::endl;
+        continue;
+      }
+
+      double ms = timers[i].second->stats().percentile(50.0);
+
+      std::cout << std::fixed << std::setprecision(3) << ms << " ms per frame, "
+                << std::setprecision(1) << bytes[i] / double(1u << 20) << " MiB, "
+                << bytes[i] / (ms / 1000.0) / double(1u << 30) << " GiB/s"
+                << std::defaultfloat << std::endl;
+    }
+  }
+
+
+  /**
+    * \brief Plays the sequence as fast as possible
+    *
+    * Plays every frame at least once, and loops short
+    * sequences so that the result is not dominated by
+    * startup costs.
+    */
+  void runStreamBenchmark() {
+    m_benchmark = true;
+
+    for (uint32_t i = 0; i < 2 * StreamRingSize; i++)
+      renderStreamFrame();
+
+    resetStreamStats();
+
+    uint32_t frameCount = std::max(m_sequence->frameCount(), BenchmarkFrames);
+
+    for (uint32_t i = 0; i < frameCount; i++) {
+      MSG msg;
+
+      while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+      }
+
+      renderStreamFrame();
+    }
+
+    printStreamStats();
+  }
+
+
+  /**
+    * \brief Uploads and displays the next sequence frame
+    *
+    * Each frame is written to the next staging texture in
+    * the ring with a non-blocking map, then copied to the
+    * video texture on the GPU. A map that would block means
+    * that the GPU is more than a ring's worth of frames
+    * behind, and is counted as a stall.
+    */
+  void renderStreamFrame() {
     this->adjustBackBuffer();
 
-    float color[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
-    m_context->ClearRenderTargetView(m_swapImageView.ptr(), color);
+    uint32_t frame = m_streamFrame++;
+    ID3D11Texture2D* staging = m_streamRing[frame % StreamRingSize].ptr();
+
+    Timer uploadTimer;
+    D3D11_MAPPED_SUBRESOURCE mapped = { };
+    HRESULT hr = m_context->Map(staging, 0, D3D11_MAP_WRITE, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+      m_streamStalls += 1;
+
+      while ((hr = m_context->Map(staging, 0, D3D11_MAP_WRITE, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)) == DXGI_ERROR_WAS_STILL_DRAWING)
+        continue;
+    }
+
+    if (FAILED(hr)) {
+      std::cerr << "Failed to map staging texture" << std::endl;
+      return;
+    }
+
+    bool copied = m_sequence->copyFrame(frame, mapped.pData, mapped.RowPitch);
+    m_context->Unmap(staging, 0);
+
+    if (!copied) {
+      std::cerr << "Failed to read frame " << frame << std::endl;
+      return;
+    }
+
+    m_streamUploadMs += uploadTimer.ms();
+    m_context->CopyResource(m_streamTexture.ptr(), staging);
+
+    // Fit the video into the window, keeping the aspect ratio
+    const auto& desc = m_sequence->desc();
+
+    float scale = std::min(
+      float(m_windowSizeX) / float(desc.width),
+      float(m_windowSizeY) / float(desc.height));
+
+    uint32_t dstWidth = uint32_t(float(desc.width) * scale);
+    uint32_t dstHeight = uint32_t(float(desc.height) * scale);
+
+    RECT srcRect = { 0, 0, LONG(desc.width), LONG(desc.height) };
+    RECT dstRect = {
+      LONG((m_windowSizeX - dstWidth) / 2), LONG((m_windowSizeY - dstHeight) / 2),
+      LONG((m_windowSizeX + dstWidth) / 2), LONG((m_windowSizeY + dstHeight) / 2) };
+
+    D3D11_VIDEO_PROCESSOR_COLOR_SPACE csIn = { };
+    csIn.Usage = 0; // Present
+    csIn.YCbCr_Matrix = desc.height >= 720 ? 1 : 0;
+    csIn.Nominal_Range = D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_16_235;
 
-    // Full range RGB output color space
     D3D11_VIDEO_PROCESSOR_COLOR_SPACE csOut = { };
-    csOut.Usage     = 0; // Present
+    csOut.Usage = 0; // Present
     csOut.RGB_Range = 0; // Full range
-    csOut.Nominal_Range = 1; // Full range
 
-    D3D11_VIDEO_PROCESSOR_COLOR_SPACE csIn = { };
-    csIn.Usage     = 0; // Present
-    csIn.RGB_Range = 0; // Full range
-    csIn.Nominal_Range = 1; // Full range
-    csIn.YCbCr_Matrix = 0; // BT.601
+    D3D11_VIDEO_COLOR background = { };
+    background.RGBA = { 0.0f, 0.0f, 0.0f, 1.0f };
 
     m_vcontext->VideoProcessorSetStreamAutoProcessingMode(m_vprocessor.ptr(), 0, false);
-    m_vcontext->VideoProcessorSetOutputColorSpace(m_vprocessor.ptr(), &csOut);
+    m_vcontext->VideoProcessorSetStreamFrameFormat(m_vprocessor.ptr(), 0, D3D11_VIDEO_FRAME_FORMAT_PROGRESSIVE);
     m_vcontext->VideoProcessorSetStreamColorSpace(m_vprocessor.ptr(), 0, &csIn);
-    blit(m_videoInputView.ptr(), 32, 32);
-    blit(m_videoInputViewNv12.ptr(), 32, 320);
-    blit(m_videoInputViewYuy2.ptr(), 32, 608);
+    m_vcontext->VideoProcessorSetStreamSourceRect(m_vprocessor.ptr(), 0, true, &srcRect);
+    m_vcontext->VideoProcessorSetStreamDestRect(m_vprocessor.ptr(), 0, true, &dstRect);
+    m_vcontext->VideoProcessorSetOutputColorSpace(m_vprocessor.ptr(), &csOut);
+    m_vcontext->VideoProcessorSetOutputBackgroundColor(m_vprocessor.ptr(), false, &background);
+    m_vcontext->VideoProcessorSetOutputTargetRect(m_vprocessor.ptr(), false, nullptr);
 
-    csIn.RGB_Range = 1; // Limited range
-    csIn.Nominal_Range = 0; // Limited range
-    m_vcontext->VideoProcessorSetStreamColorSpace(m_vprocessor.ptr(), 0, &csIn);
-    blit(m_videoInputView.ptr(), 320, 32);
-    blit(m_videoInputViewNv12.ptr(), 320, 320);
-    blit(m_videoInputViewYuy2.ptr(), 320, 608);
+    D3D11_VIDEO_PROCESSOR_STREAM stream = { };
+    stream.Enable = true;
+    stream.pInputSurface = m_streamInputView.ptr();
 
-    // Limited range RGB output color space
-    csOut.RGB_Range = 1;
-    csOut.Nominal_Range = 0;
-    m_vcontext->VideoProcessorSetOutputColorSpace(m_vprocessor.ptr(), &csOut);
+    m_vcontext->VideoProcessorBlt(m_vprocessor.ptr(), m_swapImageOutputView.ptr(), frame, 1, &stream);
+    m_swapchain->Present(m_benchmark ? 0 : 1, 0);
 
-    csIn.RGB_Range = 0; // Full range
-    csIn.Nominal_Range = 1; // Full range
-    m_vcontext->VideoProcessorSetStreamColorSpace(m_vprocessor.ptr(), 0, &csIn);
-    blit(m_videoInputView.ptr(), 608, 32);
-    blit(m_videoInputViewNv12.ptr(), 608, 320);
-    blit(m_videoInputViewYuy2.ptr(), 608, 608);
+    m_streamFrameCount += 1;
 
-    csIn.RGB_Range = 1; // Limited range
-    csIn.Nominal_Range = 0; // Limited range
-    m_vcontext->VideoProcessorSetStreamColorSpace(m_vprocessor.ptr(), 0, &csIn);
-    blit(m_videoInputView.ptr(), 896, 32);
-    blit(m_videoInputViewNv12.ptr(), 896, 320);
-    blit(m_videoInputViewYuy2.ptr(), 896, 608);
+    if (!m_benchmark && m_streamFrameCount == StreamReportInterval) {
+      printStreamStats();
+      resetStreamStats();
+    }
+  }
 
-    m_swapchain->Present(1, 0);
+
+  void resetStreamStats() {
+    m_streamTimer.reset();
+    m_streamFrameCount = 0;
+    m_streamStalls = 0;
+    m_streamUploadMs = 0.0;
+  }
+
+
+  void printStreamStats() {
+    double seconds = m_streamTimer.ms() / 1000.0;
+    double bytes = double(m_sequence->frameSize()) * double(m_streamFrameCount);
+
+    std::cout << m_streamFrameCount << " frames: "
+              << double(m_streamFrameCount) / seconds << " fps, "
+              << bytes / double(1u << 20) / seconds << " MB/s uploaded, "
+              << m_streamUploadMs / double(m_streamFrameCount) << " ms CPU upload per frame, "
+              << m_streamStalls << " ring stall(s)" << std::endl;
+  }
+
+
+  bool createStreamResources() {
+    static const std::array<DXGI_FORMAT, 4> s_formats = {{
+      DXGI_FORMAT_NV12, DXGI_FORMAT_YUY2, DXGI_FORMAT_P010, DXGI_FORMAT_AYUV,
+    }};
+
+    const auto& desc = m_sequence->desc();
+    DXGI_FORMAT format = s_formats[uint32_t(desc.format)];
+
+    UINT support = 0;
+
+    if (FAILED(m_venum->CheckVideoProcessorFormat(format, &support))
+     || !(support & D3D11_VIDEO_PROCESSOR_FORMAT_SUPPORT_INPUT)) {
+      std::cerr << "Sequence format not supported as video processor input" << std::endl;
+      return false;
+    }
+
+    D3D11_TEXTURE2D_DESC textureDesc = { };
+    textureDesc.Width = desc.width;
+    textureDesc.Height = desc.height;
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = format;
+    textureDesc.SampleDesc = { 1, 0 };
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+
+    if (FAILED(m_device->CreateTexture2D(&textureDesc, nullptr, &m_streamTexture))) {
+      std::cerr << "Failed to create video texture" << std::endl;
+      return false;
+    }
+
+    D3D11_VIDEO_PROCESSOR_INPUT_VIEW_DESC inputDesc = { };
+    inputDesc.ViewDimension = D3D11_VPIV_DIMENSION_TEXTURE2D;
+    inputDesc.Texture2D.MipSlice = 0;
+
+    if (FAILED(m_vdevice->CreateVideoProcessorInputView(m_streamTexture.ptr(), m_venum.ptr(), &inputDesc, &m_streamInputView))) {
+      std::cerr << "Failed to create D3D11 video input view for sequence" << std::endl;
+      return false;
+    }
+
+    textureDesc.Usage = D3D11_USAGE_STAGING;
+    textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    for (auto& staging : m_streamRing) {
+      if (FAILED(m_device->CreateTexture2D(&textureDesc, nullptr, &staging))) {
+        std::cerr << "Failed to create staging texture" << std::endl;
+        return false;
+      }
+    }
+
+    std::cout << "Streaming " << desc.path << ": " << m_sequence->frameCount() << " frames, "
+              << desc.width << "x" << desc.height << std::endl;
+
+    resetStreamStats();
+    return true;
+  }
+
+
+  void renderFrame(GpuTimer* gpuTimer) {
+    this->adjustBackBuffer();
+
+    float color[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+    m_context->ClearRenderTargetView(m_swapImageView.ptr(), color);
+
+    // Only visible in direct mode, where it replaces the red clear
+    D3D11_VIDEO_COLOR background = { };
+    background.RGBA = { 1.0f, 0.0f, 0.0f, 1.0f };
+
+    // Capture results for verification unless all sets are in use
+    m_captureSet = nullptr;
+
+    if (!m_verifyDone && !m_benchmark) {
+      auto& set = m_verifyRing[m_verifyFrame % VerifyRingSize];
+
+      if (!set.pending) {
+        m_captureSet = &set;
+        m_verifyFrame += 1;
+      }
+    }
+
+    if (gpuTimer)
+      gpuTimer->begin(m_context.ptr());
+
+    m_vcontext->VideoProcessorSetStreamAutoProcessingMode(m_vprocessor.ptr(), 0, false);
+    m_vcontext->VideoProcessorSetOutputBackgroundColor(m_vprocessor.ptr(), false, &background);
+
+    std::array<ID3D11VideoProcessorInputView*, InputCount> inputViews = {{
+      m_videoInputView.ptr(), m_videoInputViewNv12.ptr(), m_videoInputViewYuy2.ptr(),
+    }};
+
+    // One column per combination of input and output range,
+    // with RGB, NV12 and YUY2 inputs from top to bottom
+    for (uint32_t column = 0; column < RangeConfigCount; column++) {
+      bool inputLimited = column & 1;
+      bool outputLimited = column & 2;
+
+      D3D11_VIDEO_PROCESSOR_COLOR_SPACE csOut = { };
+      csOut.Usage = 0; // Present
+      csOut.RGB_Range = outputLimited ? 1 : 0;
+      csOut.Nominal_Range = outputLimited
+        ? D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_16_235
+        : D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_0_255;
+
+      D3D11_VIDEO_PROCESSOR_COLOR_SPACE csIn = { };
+      csIn.Usage = 0; // Present
+      csIn.RGB_Range = inputLimited ? 1 : 0;
+      csIn.YCbCr_Matrix = 0; // BT.601
+      csIn.Nominal_Range = inputLimited
+        ? D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_16_235
+        : D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_0_255;
+
+      m_vcontext->VideoProcessorSetOutputColorSpace(m_vprocessor.ptr(), &csOut);
+      m_vcontext->VideoProcessorSetStreamColorSpace(m_vprocessor.ptr(), 0, &csIn);
+
+      for (uint32_t row = 0; row < InputCount; row++)
+        blit(inputViews[row], 32 + 288 * column, 32 + 288 * row, InputCount * column + row);
+    }
+
+    if (gpuTimer) {
+      gpuTimer->end(m_context.ptr());
+      gpuTimer->resolve(m_context.ptr(), false);
+    }
+
+    if (m_captureSet)
+      m_captureSet->pending = true;
+
+    m_swapchain->Present(m_benchmark ? 0 : 1, 0);
+
+    if (!m_verifyDone && !m_benchmark)
+      verifyPending();
   }
   
 
-  void blit(ID3D11VideoProcessorInputView* pView, uint32_t x, uint32_t y) {
+  void blit(ID3D11VideoProcessorInputView* pView, uint32_t x, uint32_t y, uint32_t cell) {
+    if (m_captureSet)
+      m_captureSet->extents[cell] = { 0, 0 };
+
     if (!pView)
       return;
 
@@ -308,18 +719,267 @@ public:
     stream.Enable = true;
     stream.pInputSurface = pView;
 
+    if (m_direct) {
+      // Write straight into the swap chain image. The target rect
+      // is clipped to the image, the dest rect is not, so that
+      // cells at the edge are cropped rather than scaled.
+      RECT dstRect = { LONG(x), LONG(y), LONG(x + VideoOutputSize), LONG(y + VideoOutputSize) };
+      RECT targetRect = { LONG(x), LONG(y),
+        LONG(std::min(x + VideoOutputSize, m_windowSizeX)),
+        LONG(std::min(y + VideoOutputSize, m_windowSizeY)) };
+
+      if (targetRect.left >= targetRect.right || targetRect.top >= targetRect.bottom)
+        return;
+
+      m_vcontext->VideoProcessorSetOutputTargetRect(m_vprocessor.ptr(), true, &targetRect);
+      m_vcontext->VideoProcessorSetStreamDestRect(m_vprocessor.ptr(), 0, true, &dstRect);
+      m_vcontext->VideoProcessorBlt(m_vprocessor.ptr(), m_swapImageOutputView.ptr(), 0, 1, &stream);
+
+      if (m_captureSet) {
+        D3D11_BOX box = { UINT(targetRect.left), UINT(targetRect.top), 0, UINT(targetRect.right), UINT(targetRect.bottom), 1 };
+        m_context->CopySubresourceRegion(m_captureSet->images[cell].ptr(), 0, 0, 0, 0, m_swapImage.ptr(), 0, &box);
+        m_captureSet->extents[cell] = { box.right - box.left, box.bottom - box.top };
+      }
+      return;
+    }
+
+    m_vcontext->VideoProcessorSetOutputTargetRect(m_vprocessor.ptr(), false, nullptr);
+    m_vcontext->VideoProcessorSetStreamDestRect(m_vprocessor.ptr(), 0, false, nullptr);
+
     D3D11_BOX box;
     box.left = 0;
     box.top = 0;
     box.front = 0;
-    box.right = 256;
-    box.bottom = 256;
+    box.right = VideoOutputSize;
+    box.bottom = VideoOutputSize;
     box.back = 1;
 
     FLOAT red[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
     m_context->ClearRenderTargetView(m_videoOutputRtv.ptr(), red);
     m_vcontext->VideoProcessorBlt(m_vprocessor.ptr(), m_videoOutputView.ptr(), 0, 1, &stream);
     m_context->CopySubresourceRegion(m_swapImage.ptr(), 0, x, y, 0, m_videoOutput.ptr(), 0, &box);
+
+    if (m_captureSet) {
+      m_context->CopyResource(m_captureSet->images[cell].ptr(), m_videoOutput.ptr());
+      m_captureSet->extents[cell] = { VideoOutputSize, VideoOutputSize };
+    }
+  }
+
+
+  bool createVerifyResources() {
+    D3D11_TEXTURE2D_DESC desc = { };
+    desc.Width = VideoOutputSize;
+    desc.Height = VideoOutputSize;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    desc.SampleDesc = { 1, 0 };
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    for (auto& set : m_verifyRing) {
+      for (auto& image : set.images) {
+        if (FAILED(m_device->CreateTexture2D(&desc, nullptr, &image))) {
+          std::cerr << "Failed to create readback texture" << std::endl;
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+
+  /**
+    * \brief Verifies the oldest completed capture
+    *
+    * Polls captured sets without blocking, so rendering
+    * is never stalled on readback. Once one set has been
+    * read back, verification is done, since the results
+    * are identical every frame.
+    */
+  void verifyPending() {
+    for (uint32_t i = 0; i < VerifyRingSize; i++) {
+      uint32_t index = (m_verifyFrame + i) % VerifyRingSize;
+      auto& set = m_verifyRing[index];
+
+      if (!set.pending)
+        continue;
+
+      // Copies complete in order, so checking the last one is enough
+      uint32_t last = CellCount;
+
+      while (last && !set.extents[last - 1].width)
+        last -= 1;
+
+      if (last) {
+        D3D11_MAPPED_SUBRESOURCE mapped = { };
+
+        if (m_context->Map(set.images[last - 1].ptr(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped) == DXGI_ERROR_WAS_STILL_DRAWING)
+          continue;
+
+        m_context->Unmap(set.images[last - 1].ptr(), 0);
+      }
+
+      m_verifyPassed = verifySet(index);
+      m_verifyDone = true;
+      return;
+    }
+  }
+
+
+  bool verifySet(uint32_t index) {
+    auto& set = m_verifyRing[index];
+    static const std::array<const char*, InputCount> s_inputNames = {{ "RGB", "NV12", "YUY2" }};
+
+    bool success = true;
+
+    std::cout << "Verification (min PSNR " << VerifyMinPsnr << " dB):" << std::endl;
+
+    for (uint32_t cell = 0; cell < CellCount; cell++) {
+      uint32_t row = cell % InputCount;
+      uint32_t column = cell / InputCount;
+
+      bool inputLimited = column & 1;
+      bool outputLimited = column & 2;
+
+      std::cout << "  " << std::left << std::setw(6) << s_inputNames[row]
+                << std::setw(18) << format(inputLimited ? "limited" : "full", "->", outputLimited ? "limited" : "full")
+                << std::right;
+
+      auto extent = set.extents[cell];
+
+      if (!extent.width || !extent.height) {
+        std::cout << "skipped" << std::endl;
+        continue;
+      }
+
+      D3D11_MAPPED_SUBRESOURCE mapped = { };
+
+      if (FAILED(m_context->Map(set.images[cell].ptr(), 0, D3D11_MAP_READ, 0, &mapped))) {
+        std::cout << "failed to map" << std::endl;
+        success = false;
+        continue;
+      }
+
+      std::vector<float> reference = computeReference(row, inputLimited, outputLimited);
+
+      double sumSq = 0.0;
+      double maxError = 0.0;
+
+      for (uint32_t y = 0; y < extent.height; y++) {
+        auto src = reinterpret_cast<const uint8_t*>(mapped.pData) + y * mapped.RowPitch;
+
+        for (uint32_t x = 0; x < extent.width; x++) {
+          const float* expected = &reference[3 * (y * VideoOutputSize + x)];
+
+          for (uint32_t c = 0; c < 3; c++) {
+            // Output is BGRA, reference is RGB
+            double error = double(src[4 * x + 2 - c]) - double(expected[c]);
+            sumSq += error * error;
+            maxError = std::max(maxError, std::abs(error));
+          }
+        }
+      }
+
+      m_context->Unmap(set.images[cell].ptr(), 0);
+
+      double mse = sumSq / double(3 * extent.width * extent.height);
+      double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+      bool passed = psnr >= VerifyMinPsnr;
+
+      std::cout << std::fixed << std::setprecision(2)
+                << "PSNR " << std::setw(6) << psnr << " dB, max error " << std::setw(6) << maxError
+                << std::defaultfloat << (passed ? "" : "  FAILED") << std::endl;
+
+      success &= passed;
+    }
+
+    std::cout << (success ? "Verification passed" : "Verification failed") << std::endl;
+    return success;
+  }
+
+
+  /**
+    * \brief Computes the expected output for a cell
+    *
+    * Decodes the source image as configured for the cell,
+    * scales it to the output size with a bilinear filter,
+    * and applies the output range. Scaler implementations
+    * differ, which is why results are compared via PSNR.
+    * \returns RGB values in the 0-255 range
+    */
+  std::vector<float> computeReference(uint32_t row, bool inputLimited, bool outputLimited) {
+    constexpr uint32_t Size = VideoInputSize;
+
+    auto range = inputLimited ? yuv::Range::Limited : yuv::Range::Full;
+    std::vector<float> decoded(3 * Size * Size);
+
+    for (uint32_t y = 0; y < Size; y++) {
+      for (uint32_t x = 0; x < Size; x++) {
+        float* rgb = &decoded[3 * (y * Size + x)];
+
+        switch (row) {
+          case 0: {
+            const uint8_t* pixel = &m_imgDataRgba[4 * (y * Size + x)];
+
+            for (uint32_t c = 0; c < 3; c++) {
+              float value = float(pixel[2 - c]);
+              rgb[c] = std::clamp(inputLimited ? (value - 16.0f) / 219.0f : value / 255.0f, 0.0f, 1.0f);
+            }
+          } break;
+
+          case 1: {
+            const uint8_t* uv = &m_imgDataNv12[Size * Size + (y / 2) * Size + 2 * (x / 2)];
+            yuv::toRgb(yuv::Matrix::BT601, range, 8, m_imgDataNv12[y * Size + x], uv[0], uv[1], rgb);
+          } break;
+
+          case 2: {
+            const uint8_t* pair = &m_imgDataYuy2[y * 2 * Size + 4 * (x / 2)];
+            yuv::toRgb(yuv::Matrix::BT601, range, 8, pair[2 * (x & 1)], pair[1], pair[3], rgb);
+          } break;
+        }
+      }
+    }
+
+    std::vector<float> result(3 * VideoOutputSize * VideoOutputSize);
+    float scale = float(Size) / float(VideoOutputSize);
+
+    for (uint32_t y = 0; y < VideoOutputSize; y++) {
+      float sy = std::clamp((float(y) + 0.5f) * scale - 0.5f, 0.0f, float(Size - 1));
+      uint32_t y0 = uint32_t(sy);
+      uint32_t y1 = std::min(y0 + 1, Size - 1);
+      float fy = sy - float(y0);
+
+      for (uint32_t x = 0; x < VideoOutputSize; x++) {
+        float sx = std::clamp((float(x) + 0.5f) * scale - 0.5f, 0.0f, float(Size - 1));
+        uint32_t x0 = uint32_t(sx);
+        uint32_t x1 = std::min(x0 + 1, Size - 1);
+        float fx = sx - float(x0);
+
+        for (uint32_t c = 0; c < 3; c++) {
+          float a = decoded[3 * (y0 * Size + x0) + c] * (1.0f - fx) + decoded[3 * (y0 * Size + x1) + c] * fx;
+          float b = decoded[3 * (y1 * Size + x0) + c] * (1.0f - fx) + decoded[3 * (y1 * Size + x1) + c] * fx;
+          float value = a * (1.0f - fy) + b * fy;
+
+          result[3 * (y * VideoOutputSize + x) + c] = outputLimited
+            ? 16.0f + 219.0f * value
+            : 255.0f * value;
+        }
+      }
+    }
+
+    return result;
+  }
+
+
+  bool verifyDone() const {
+    return m_verifyDone;
+  }
+
+
+  bool verifyPassed() const {
+    return m_verifyPassed;
   }
 
   
@@ -332,8 +992,11 @@ public:
       m_windowSizeX = windowRect.right - windowRect.left;
       m_windowSizeY = windowRect.bottom - windowRect.top;
 
+      bool hasOutputView = m_swapImageOutputView != nullptr;
+
       m_swapImage = nullptr;
       m_swapImageView = nullptr;
+      m_swapImageOutputView = nullptr;
 
       HRESULT hr = m_swapchain->ResizeBuffers(0,
         m_windowSizeX, m_windowSizeY, DXGI_FORMAT_UNKNOWN, 0);
@@ -352,14 +1015,64 @@ public:
         std::cerr << "Failed to create render target view" << std::endl;
         return;
       }
+
+      if (hasOutputView && !createSwapImageOutputView())
+        m_direct = false;
     }
   }
 
+
+  bool createSwapImageOutputView() {
+    UINT support = 0;
+
+    if (FAILED(m_venum->CheckVideoProcessorFormat(DXGI_FORMAT_B8G8R8A8_UNORM, &support))
+     || !(support & D3D11_VIDEO_PROCESSOR_FORMAT_SUPPORT_OUTPUT)) {
+      std::cerr << "Swap chain format not supported as video processor output" << std::endl;
+      return false;
+    }
+
+    D3D11_VIDEO_PROCESSOR_OUTPUT_VIEW_DESC outputDesc = { };
+    outputDesc.ViewDimension = D3D11_VPOV_DIMENSION_TEXTURE2D;
+    outputDesc.Texture2D.MipSlice = 0;
+
+    if (FAILED(m_vdevice->CreateVideoProcessorOutputView(m_swapImage.ptr(), m_venum.ptr(), &outputDesc, &m_swapImageOutputView))) {
+      std::cerr << "Failed to create video output view for swap chain image" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
   operator bool () const {
     return m_initialized;
   }
     
 private:
+
+  constexpr static uint32_t VideoInputSize        = 128;
+  constexpr static uint32_t VideoOutputSize       = 256;
+  constexpr static uint32_t InputCount            = 3;
+  constexpr static uint32_t RangeConfigCount      = 4;
+  constexpr static uint32_t CellCount             = InputCount * RangeConfigCount;
+  constexpr static uint32_t BlitsPerFrame         = CellCount;
+  constexpr static uint32_t VerifyRingSize        = 3;
+  constexpr static double   VerifyMinPsnr         = 30.0;
+
+  struct CellExtent {
+    uint32_t width;
+    uint32_t height;
+  };
+
+  struct VerifySet {
+    std::array<Com<ID3D11Texture2D>, CellCount> images;
+    std::array<CellExtent, CellCount>           extents = { };
+    bool                                        pending = false;
+  };
+
+  constexpr static uint32_t BenchmarkWarmupFrames = 60;
+  constexpr static uint32_t BenchmarkFrames       = 1000;
+  constexpr static uint32_t StreamRingSize        = 4;
+  constexpr static uint32_t StreamReportInterval  = 600;
   
   HWND                                m_window;
   uint32_t                            m_windowSizeX = 1280;
@@ -374,6 +1087,7 @@ private:
   Com<ID3D11VideoProcessor>           m_vprocessor;
   Com<ID3D11Texture2D>                m_swapImage;
   Com<ID3D11RenderTargetView>         m_swapImageView;
+  Com<ID3D11VideoProcessorOutputView> m_swapImageOutputView;
   Com<ID3D11Texture2D>                m_videoOutput;
   Com<ID3D11VideoProcessorOutputView> m_videoOutputView;
   Com<ID3D11RenderTargetView>         m_videoOutputRtv;
@@ -385,18 +1099,31 @@ private:
   Com<ID3D11VideoProcessorInputView>  m_videoInputViewNv12;
   Com<ID3D11VideoProcessorInputView>  m_videoInputViewYuy2;
 
+  std::vector<uint8_t>                m_imgDataRgba;
+  std::vector<uint8_t>                m_imgDataNv12;
+  std::vector<uint8_t>                m_imgDataYuy2;
+
+  std::array<VerifySet, VerifyRingSize> m_verifyRing;
+  VerifySet*                          m_captureSet = nullptr;
+  uint32_t                            m_verifyFrame = 0;
+  bool                                m_verifyDone = false;
+  bool                                m_verifyPassed = false;
+
+  std::unique_ptr<YuvSequence>        m_sequence;
+  Com<ID3D11Texture2D>                m_streamTexture;
+  Com<ID3D11VideoProcessorInputView>  m_streamInputView;
+  std::array<Com<ID3D11Texture2D>, StreamRingSize> m_streamRing;
+
+  uint32_t                            m_streamFrame = 0;
+  uint32_t                            m_streamFrameCount = 0;
+  uint32_t                            m_streamStalls = 0;
+  double                              m_streamUploadMs = 0.0;
+  Timer                               m_streamTimer;
+
+  bool                                m_direct = false;
+  bool                                m_benchmark = false;
   bool                                m_initialized = false;
 
-  static inline uint8_t y_coeff(const uint8_t* rgb, float r, float g, float b) {
-    float x = (rgb[0] * r + rgb[1] * g + rgb[2] * b) / 255.0f;
-    return 16 + uint8_t(std::roundf(219.0f * std::clamp(x, 0.0f, 1.0f)));
-  }
-
-  static inline uint8_t c_coeff(const uint8_t* rgb, float r, float g, float b) {
-    float x = ((rgb[0] * r + rgb[1] * g + rgb[2] * b) / 255.0f) + 0.5f;
-    return uint8_t(std::roundf(255.0f * std::clamp(x, 0.0f, 1.0f)));
-  }
-
 };
 
 LRESULT CALLBACK WindowProc(HWND hWnd,
@@ -408,6 +1135,41 @@ int WINAPI WinMain(HINSTANCE hInstance,
                    HINSTANCE hPrevInstance,
                    LPSTR lpCmdLine,
                    int nCmdShow) {
+  // Usage: d3d11-video [direct] [bench] [verify] [stream <file> <nv12|yuy2|p010> <width>x<height>]
+  bool direct = false;
+  bool benchmark = false;
+  bool verify = false;
+
+  YuvSequenceDesc stream;
+
+  if (lpCmdLine) {
+    std::stringstream args(lpCmdLine);
+    std::string arg;
+
+    while (args >> arg) {
+      if (arg == "bench")
+        benchmark = true;
+      else if (arg == "direct")
+        direct = true;
+      else if (arg == "verify")
+        verify = true;
+      else if (arg == "stream") {
+        std::string formatArg;
+        std::string sizeArg;
+
+        if (!(args >> stream.path >> formatArg >> sizeArg) || !stream.parse(formatArg, sizeArg)) {
+          std::cerr << "Usage: stream <file> <nv12|yuy2|p010> <width>x<height>" << std::endl;
+          return 1;
+        }
+      }
+    }
+  }
+
+  if (verify && (benchmark || !stream.path.empty())) {
+    std::cerr << "verify cannot be combined with bench or stream" << std::endl;
+    return 1;
+  }
+
   HWND hWnd;
   WNDCLASSEXW wc;
   ZeroMemory(&wc, sizeof(WNDCLASSEX));
@@ -433,7 +1195,32 @@ int WINAPI WinMain(HINSTANCE hInstance,
   ShowWindow(hWnd, nCmdShow);
 
   MSG msg;
-  VideoApp app(hInstance, hWnd);
+  VideoApp app(hInstance, hWnd, direct, stream);
+
+  if (benchmark) {
+    if (!app)
+      return 1;
+
+    app.runBenchmark();
+    return 0;
+  }
+
+  if (verify) {
+    // Exit code reports the result, for use as a CI gate
+    while (app && !app.verifyDone()) {
+      if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+
+        if (msg.message == WM_QUIT)
+          return 1;
+      } else {
+        app.run();
+      }
+    }
+
+    return app && app.verifyPassed() ? 0 : 1;
+  }
   
   while (app) {
     if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
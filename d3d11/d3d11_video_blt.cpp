@@ -0,0 +1,326 @@
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <d3d11_1.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/gpu_bench.h"
+#include "../common/str.h"
+#include "../common/test_pattern.h"
+
+struct InputFormat {
+  const char*     name;
+  DXGI_FORMAT     format;
+  pattern::Format patternFormat;
+};
+
+struct Resolution {
+  const char*   name;
+  uint32_t      width;
+  uint32_t      height;
+};
+
+struct RangeConfig {
+  const char*   name;
+  bool          inputLimited;
+  bool          outputLimited;
+};
+
+struct InputImage {
+  Com<ID3D11Texture2D>                texture;
+  Com<ID3D11VideoProcessorInputView>  view;
+};
+
+const std::array<InputFormat, 4> g_inputFormats = {{
+  { "RGBA", DXGI_FORMAT_R8G8B8A8_UNORM, pattern::Format::RGBA },
+  { "NV12", DXGI_FORMAT_NV12,           pattern::Format::NV12 },
+  { "YUY2", DXGI_FORMAT_YUY2,           pattern::Format::YUY2 },
+  { "P010", DXGI_FORMAT_P010,           pattern::Format::P010 },
+}};
+
+const std::array<Resolution, 4> g_resolutions = {{
+  { "720p",  1280,  720 },
+  { "1080p", 1920, 1080 },
+  { "4K",    3840, 2160 },
+  { "8K",    7680, 4320 },
+}};
+
+// Output size relative to the input, in percent
+const std::array<uint32_t, 4> g_scaleFactors = {{ 50, 75, 100, 150 }};
+
+// Same combinations as d3d11-video, input -> output
+const std::array<RangeConfig, 4> g_rangeConfigs = {{
+  { "full->full",       false, false },
+  { "limited->full",    true,  false },
+  { "full->limited",    false, true  },
+  { "limited->limited", true,  true  },
+}};
+
+class VideoBltApp {
+
+public:
+
+  VideoBltApp() {
+    std::array<D3D_FEATURE_LEVEL, 2> fl = {
+      D3D_FEATURE_LEVEL_11_1,
+      D3D_FEATURE_LEVEL_11_0,
+    };
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, D3D11_CREATE_DEVICE_VIDEO_SUPPORT,
+          fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &m_device, nullptr, &m_context))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    if (FAILED(m_device->QueryInterface(IID_PPV_ARGS(&m_vdevice)))) {
+      std::cerr << "Failed to query D3D11 video device" << std::endl;
+      return;
+    }
+
+    if (FAILED(m_context->QueryInterface(IID_PPV_ARGS(&m_vcontext)))) {
+      std::cerr << "Failed to query D3D11 video context" << std::endl;
+      return;
+    }
+
+    D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT };
+
+    if (FAILED(m_device->CreateQuery(&queryDesc, &m_query))) {
+      std::cerr << "Failed to create event query" << std::endl;
+      return;
+    }
+
+    m_initialized = true;
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    std::cout << std::left << std::setw(8) << "Format" << std::setw(8) << "Input"
+              << std::setw(12) << "Output" << std::setw(18) << "Range" << std::right
+              << std::setw(12) << "Blits/s" << std::setw(12) << "GPU ms" << std::endl;
+
+    for (const auto& res : g_resolutions) {
+      std::array<InputImage, g_inputFormats.size()> inputs;
+
+      for (uint32_t i = 0; i < g_inputFormats.size(); i++)
+        inputs[i].texture = createInputTexture(g_inputFormats[i], res.width, res.height);
+
+      for (uint32_t scale : g_scaleFactors) {
+        uint32_t dstWidth = (res.width * scale / 100) & ~1u;
+        uint32_t dstHeight = (res.height * scale / 100) & ~1u;
+
+        Com<ID3D11VideoProcessorEnumerator> venum;
+        Com<ID3D11VideoProcessor> vprocessor;
+        Com<ID3D11Texture2D> output;
+        Com<ID3D11VideoProcessorOutputView> outputView;
+
+        if (!createProcessor(res.width, res.height, dstWidth, dstHeight, venum, vprocessor, output, outputView))
+          continue;
+
+        for (uint32_t i = 0; i < g_inputFormats.size(); i++) {
+          const auto& fmt = g_inputFormats[i];
+          inputs[i].view = nullptr;
+
+          UINT support = 0;
+
+          if (inputs[i].texture != nullptr
+           && SUCCEEDED(venum->CheckVideoProcessorFormat(fmt.format, &support))
+           && (support & D3D11_VIDEO_PROCESSOR_FORMAT_SUPPORT_INPUT)) {
+            D3D11_VIDEO_PROCESSOR_INPUT_VIEW_DESC inputDesc = { };
+            inputDesc.ViewDimension = D3D11_VPIV_DIMENSION_TEXTURE2D;
+            inputDesc.Texture2D.MipSlice = 0;
+
+            m_vdevice->CreateVideoProcessorInputView(inputs[i].texture.ptr(), venum.ptr(), &inputDesc, &inputs[i].view);
+          }
+
+          for (const auto& range : g_rangeConfigs) {
+            std::cout << std::left << std::setw(8) << fmt.name << std::setw(8) << res.name
+                      << std::setw(12) << format(dstWidth, "x", dstHeight)
+                      << std::setw(18) << range.name << std::right;
+
+            if (inputs[i].view == nullptr) {
+              std::cout << std::setw(12) << "n/a" << std::endl;
+              continue;
+            }
+
+            double blitsPerSecond = 0.0;
+            double gpuMs = 0.0;
+
+            runTest(vprocessor.ptr(), outputView.ptr(), inputs[i].view.ptr(),
+              range, res.width, res.height, dstWidth, dstHeight, blitsPerSecond, gpuMs);
+
+            std::cout << std::fixed << std::setprecision(1) << std::setw(12) << blitsPerSecond
+                      << std::setprecision(3) << std::setw(12) << gpuMs
+                      << std::defaultfloat << std::endl;
+          }
+        }
+      }
+    }
+
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t WarmupBlits   = 10;
+  constexpr static uint32_t MeasuredBlits = 200;
+
+  Com<ID3D11Device>             m_device;
+  Com<ID3D11DeviceContext>      m_context;
+  Com<ID3D11VideoDevice>        m_vdevice;
+  Com<ID3D11VideoContext>       m_vcontext;
+  Com<ID3D11Query>              m_query;
+
+  bool m_initialized = false;
+
+  Com<ID3D11Texture2D> createInputTexture(const InputFormat& fmt, uint32_t width, uint32_t height) {
+    // A zone plate covers all frequencies up to Nyquist,
+    // so that scaling has detail to work with at any size
+    size_t pitch = pattern::getMinPitch(fmt.patternFormat, width);
+    std::vector<uint8_t> data(pattern::getImageSize(fmt.patternFormat, height, pitch));
+
+    pattern::GenerateArgs args;
+    args.type = pattern::Type::ZonePlate;
+    args.format = fmt.patternFormat;
+    args.matrix = yuv::Matrix::BT709;
+    args.range = yuv::Range::Limited;
+    args.width = width;
+    args.height = height;
+    args.dst = data.data();
+    args.dstPitch = pitch;
+    pattern::generate(args);
+
+    D3D11_TEXTURE2D_DESC desc = { };
+    desc.Width = width;
+    desc.Height = height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = fmt.format;
+    desc.SampleDesc = { 1, 0 };
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = 0;
+
+    D3D11_SUBRESOURCE_DATA initialData = { };
+    initialData.pSysMem = data.data();
+    initialData.SysMemPitch = pitch;
+
+    Com<ID3D11Texture2D> texture;
+
+    if (FAILED(m_device->CreateTexture2D(&desc, &initialData, &texture))) {
+      std::cerr << "Failed to create " << fmt.name << " input texture" << std::endl;
+      return nullptr;
+    }
+
+    return texture;
+  }
+
+  bool createProcessor(uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight,
+      Com<ID3D11VideoProcessorEnumerator>& venum, Com<ID3D11VideoProcessor>& vprocessor,
+      Com<ID3D11Texture2D>& output, Com<ID3D11VideoProcessorOutputView>& outputView) {
+    D3D11_VIDEO_PROCESSOR_CONTENT_DESC videoEnumDesc = { };
+    videoEnumDesc.InputFrameFormat = D3D11_VIDEO_FRAME_FORMAT_PROGRESSIVE;
+    videoEnumDesc.InputFrameRate = { 60, 1 };
+    videoEnumDesc.InputWidth = srcWidth;
+    videoEnumDesc.InputHeight = srcHeight;
+    videoEnumDesc.OutputFrameRate = { 60, 1 };
+    videoEnumDesc.OutputWidth = dstWidth;
+    videoEnumDesc.OutputHeight = dstHeight;
+    videoEnumDesc.Usage = D3D11_VIDEO_USAGE_OPTIMAL_SPEED;
+
+    if (FAILED(m_vdevice->CreateVideoProcessorEnumerator(&videoEnumDesc, &venum))) {
+      std::cerr << "Failed to create D3D11 video processor enumerator" << std::endl;
+      return false;
+    }
+
+    if (FAILED(m_vdevice->CreateVideoProcessor(venum.ptr(), 0, &vprocessor))) {
+      std::cerr << "Failed to create D3D11 video processor" << std::endl;
+      return false;
+    }
+
+    D3D11_TEXTURE2D_DESC desc = { };
+    desc.Width = dstWidth;
+    desc.Height = dstHeight;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    desc.SampleDesc = { 1, 0 };
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+    if (FAILED(m_device->CreateTexture2D(&desc, nullptr, &output))) {
+      std::cerr << "Failed to create D3D11 video output image" << std::endl;
+      return false;
+    }
+
+    D3D11_VIDEO_PROCESSOR_OUTPUT_VIEW_DESC outputDesc = { };
+    outputDesc.ViewDimension = D3D11_VPOV_DIMENSION_TEXTURE2D;
+    outputDesc.Texture2D.MipSlice = 0;
+
+    if (FAILED(m_vdevice->CreateVideoProcessorOutputView(output.ptr(), venum.ptr(), &outputDesc, &outputView))) {
+      std::cerr << "Failed to create D3D11 video output view" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  void runTest(ID3D11VideoProcessor* vprocessor, ID3D11VideoProcessorOutputView* outputView,
+      ID3D11VideoProcessorInputView* inputView, const RangeConfig& range,
+      uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight,
+      double& blitsPerSecond, double& gpuMs) {
+    D3D11_VIDEO_PROCESSOR_COLOR_SPACE csIn = { };
+    csIn.Usage = 0; // Present
+    csIn.RGB_Range = range.inputLimited ? 1 : 0;
+    csIn.YCbCr_Matrix = 1; // BT.709
+    csIn.Nominal_Range = range.inputLimited
+      ? D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_16_235
+      : D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_0_255;
+
+    D3D11_VIDEO_PROCESSOR_COLOR_SPACE csOut = { };
+    csOut.Usage = 0; // Present
+    csOut.RGB_Range = range.outputLimited ? 1 : 0;
+    csOut.YCbCr_Matrix = 1; // BT.709
+    csOut.Nominal_Range = range.outputLimited
+      ? D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_16_235
+      : D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_0_255;
+
+    RECT srcRect = { 0, 0, LONG(srcWidth), LONG(srcHeight) };
+    RECT dstRect = { 0, 0, LONG(dstWidth), LONG(dstHeight) };
+
+    m_vcontext->VideoProcessorSetStreamAutoProcessingMode(vprocessor, 0, false);
+    m_vcontext->VideoProcessorSetStreamFrameFormat(vprocessor, 0, D3D11_VIDEO_FRAME_FORMAT_PROGRESSIVE);
+    m_vcontext->VideoProcessorSetStreamSourceRect(vprocessor, 0, true, &srcRect);
+    m_vcontext->VideoProcessorSetStreamDestRect(vprocessor, 0, true, &dstRect);
+    m_vcontext->VideoProcessorSetOutputColorSpace(vprocessor, &csOut);
+    m_vcontext->VideoProcessorSetStreamColorSpace(vprocessor, 0, &csIn);
+
+    D3D11_VIDEO_PROCESSOR_STREAM stream = { };
+    stream.Enable = true;
+    stream.pInputSurface = inputView;
+
+    auto result = measureGpuWork(m_device.ptr(), m_context.ptr(), m_query.ptr(),
+      WarmupBlits, MeasuredBlits, [&] (uint32_t i) {
+        m_vcontext->VideoProcessorBlt(vprocessor, outputView, i, 1, &stream);
+      });
+
+    blitsPerSecond = result.callsPerSecond;
+    gpuMs = result.gpuMs;
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  VideoBltApp app;
+  return app.run();
+}
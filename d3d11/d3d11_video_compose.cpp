@@ -0,0 +1,422 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <d3d11_1.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/gpu_bench.h"
+#include "../common/str.h"
+#include "../common/test_pattern.h"
+
+struct InputFormat {
+  const char*     name;
+  DXGI_FORMAT     format;
+  pattern::Format patternFormat;
+};
+
+struct InputStream {
+  const InputFormat*                  format = nullptr;
+  Com<ID3D11Texture2D>                texture;
+  Com<ID3D11VideoProcessorInputView>  view;
+  RECT                                srcRect = { };
+  RECT                                dstRect = { };
+  float                               alpha = 1.0f;
+};
+
+// Streams cycle through these, so that every composition
+// with more than one stream mixes different input formats
+const std::array<InputFormat, 4> g_inputFormats = {{
+  { "NV12", DXGI_FORMAT_NV12,           pattern::Format::NV12 },
+  { "YUY2", DXGI_FORMAT_YUY2,           pattern::Format::YUY2 },
+  { "RGBA", DXGI_FORMAT_R8G8B8A8_UNORM, pattern::Format::RGBA },
+  { "P010", DXGI_FORMAT_P010,           pattern::Format::P010 },
+}};
+
+class VideoComposeApp {
+
+public:
+
+  VideoComposeApp() {
+    std::array<D3D_FEATURE_LEVEL, 2> fl = {
+      D3D_FEATURE_LEVEL_11_1,
+      D3D_FEATURE_LEVEL_11_0,
+    };
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, D3D11_CREATE_DEVICE_VIDEO_SUPPORT,
+          fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &m_device, nullptr, &m_context))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    if (FAILED(m_device->QueryInterface(IID_PPV_ARGS(&m_vdevice)))) {
+      std::cerr << "Failed to query D3D11 video device" << std::endl;
+      return;
+    }
+
+    if (FAILED(m_context->QueryInterface(IID_PPV_ARGS(&m_vcontext)))) {
+      std::cerr << "Failed to query D3D11 video context" << std::endl;
+      return;
+    }
+
+    D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT };
+
+    if (FAILED(m_device->CreateQuery(&queryDesc, &m_query))) {
+      std::cerr << "Failed to create event query" << std::endl;
+      return;
+    }
+
+    if (!createProcessor())
+      return;
+
+    m_initialized = true;
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    D3D11_VIDEO_PROCESSOR_CAPS caps = { };
+    m_venum->GetVideoProcessorCaps(&caps);
+
+    uint32_t maxStreams = std::min({ MaxStreamCount, caps.MaxInputStreams, caps.MaxStreamStates });
+    bool hasAlpha = caps.FeatureCaps & D3D11_VIDEO_PROCESSOR_FEATURE_CAPS_ALPHA_STREAM;
+
+    std::cout << "Output " << OutputWidth << "x" << OutputHeight
+              << ", inputs " << InputWidth << "x" << InputHeight
+              << ", max input streams " << caps.MaxInputStreams
+              << ", max stream states " << caps.MaxStreamStates
+              << (hasAlpha ? "" : ", no stream alpha") << std::endl;
+
+    if (!createStreams(maxStreams))
+      return 1;
+
+    std::cout << std::left << std::setw(9) << "Streams" << std::setw(32) << "Formats" << std::right
+              << std::setw(14) << "Composed/s" << std::setw(12) << "GPU ms"
+              << std::setw(14) << "Separate/s" << std::setw(12) << "GPU ms"
+              << std::setw(10) << "Speedup" << std::endl;
+
+    for (uint32_t count = 2; count <= MaxStreamCount; count++) {
+      std::string formats;
+
+      for (uint32_t i = 0; i < count; i++)
+        formats += format(i ? "," : "", m_streams[i].format->name);
+
+      std::cout << std::left << std::setw(9) << count << std::setw(32) << formats << std::right;
+
+      if (count > maxStreams) {
+        std::cout << std::setw(14) << "n/a" << std::endl;
+        continue;
+      }
+
+      layoutStreams(count, hasAlpha);
+
+      double composedPerSecond = 0.0;
+      double composedGpuMs = 0.0;
+      runTest(count, true, composedPerSecond, composedGpuMs);
+
+      double separatePerSecond = 0.0;
+      double separateGpuMs = 0.0;
+      runTest(count, false, separatePerSecond, separateGpuMs);
+
+      std::cout << std::fixed << std::setprecision(1)
+                << std::setw(14) << composedPerSecond
+                << std::setprecision(3) << std::setw(12) << composedGpuMs
+                << std::setprecision(1) << std::setw(14) << separatePerSecond
+                << std::setprecision(3) << std::setw(12) << separateGpuMs
+                << std::setprecision(2) << std::setw(9) << composedPerSecond / separatePerSecond << "x"
+                << std::defaultfloat << std::endl;
+    }
+
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t InputWidth      = 1280;
+  constexpr static uint32_t InputHeight     = 720;
+  constexpr static uint32_t OutputWidth     = 1920;
+  constexpr static uint32_t OutputHeight    = 1080;
+  constexpr static uint32_t MaxStreamCount  = 8;
+  constexpr static uint32_t WarmupFrames    = 10;
+  constexpr static uint32_t MeasuredFrames  = 200;
+
+  Com<ID3D11Device>                     m_device;
+  Com<ID3D11DeviceContext>              m_context;
+  Com<ID3D11VideoDevice>                m_vdevice;
+  Com<ID3D11VideoContext>               m_vcontext;
+  Com<ID3D11Query>                      m_query;
+
+  Com<ID3D11VideoProcessorEnumerator>   m_venum;
+  Com<ID3D11VideoProcessor>             m_vprocessor;
+  Com<ID3D11Texture2D>                  m_output;
+  Com<ID3D11VideoProcessorOutputView>   m_outputView;
+
+  std::vector<InputStream>              m_streams;
+
+  bool m_initialized = false;
+
+  bool createProcessor() {
+    D3D11_VIDEO_PROCESSOR_CONTENT_DESC videoEnumDesc = { };
+    videoEnumDesc.InputFrameFormat = D3D11_VIDEO_FRAME_FORMAT_PROGRESSIVE;
+    videoEnumDesc.InputFrameRate = { 60, 1 };
+    videoEnumDesc.InputWidth = InputWidth;
+    videoEnumDesc.InputHeight = InputHeight;
+    videoEnumDesc.OutputFrameRate = { 60, 1 };
+    videoEnumDesc.OutputWidth = OutputWidth;
+    videoEnumDesc.OutputHeight = OutputHeight;
+    videoEnumDesc.Usage = D3D11_VIDEO_USAGE_OPTIMAL_SPEED;
+
+    if (FAILED(m_vdevice->CreateVideoProcessorEnumerator(&videoEnumDesc, &m_venum))) {
+      std::cerr << "Failed to create D3D11 video processor enumerator" << std::endl;
+      return false;
+    }
+
+    if (FAILED(m_vdevice->CreateVideoProcessor(m_venum.ptr(), 0, &m_vprocessor))) {
+      std::cerr << "Failed to create D3D11 video processor" << std::endl;
+      return false;
+    }
+
+    D3D11_TEXTURE2D_DESC desc = { };
+    desc.Width = OutputWidth;
+    desc.Height = OutputHeight;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    desc.SampleDesc = { 1, 0 };
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+    if (FAILED(m_device->CreateTexture2D(&desc, nullptr, &m_output))) {
+      std::cerr << "Failed to create D3D11 video output image" << std::endl;
+      return false;
+    }
+
+    D3D11_VIDEO_PROCESSOR_OUTPUT_VIEW_DESC outputDesc = { };
+    outputDesc.ViewDimension = D3D11_VPOV_DIMENSION_TEXTURE2D;
+    outputDesc.Texture2D.MipSlice = 0;
+
+    if (FAILED(m_vdevice->CreateVideoProcessorOutputView(m_output.ptr(), m_venum.ptr(), &outputDesc, &m_outputView))) {
+      std::cerr << "Failed to create D3D11 video output view" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool createStreams(uint32_t count) {
+    // Each stream gets its own texture, like separate camera
+    // feeds would. Formats the processor cannot read are
+    // skipped rather than failing the whole test.
+    std::vector<const InputFormat*> formats;
+
+    for (const auto& fmt : g_inputFormats) {
+      UINT support = 0;
+
+      if (SUCCEEDED(m_venum->CheckVideoProcessorFormat(fmt.format, &support))
+       && (support & D3D11_VIDEO_PROCESSOR_FORMAT_SUPPORT_INPUT))
+        formats.push_back(&fmt);
+      else
+        std::cout << fmt.name << " input not supported" << std::endl;
+    }
+
+    if (formats.empty()) {
+      std::cerr << "No supported input formats" << std::endl;
+      return false;
+    }
+
+    m_streams.resize(MaxStreamCount);
+
+    for (uint32_t i = 0; i < count; i++) {
+      auto& stream = m_streams[i];
+      stream.format = formats[i % formats.size()];
+      stream.texture = createInputTexture(*stream.format, i);
+
+      if (stream.texture == nullptr)
+        return false;
+
+      D3D11_VIDEO_PROCESSOR_INPUT_VIEW_DESC inputDesc = { };
+      inputDesc.ViewDimension = D3D11_VPIV_DIMENSION_TEXTURE2D;
+      inputDesc.Texture2D.MipSlice = 0;
+
+      if (FAILED(m_vdevice->CreateVideoProcessorInputView(stream.texture.ptr(), m_venum.ptr(), &inputDesc, &stream.view))) {
+        std::cerr << "Failed to create " << stream.format->name << " input view" << std::endl;
+        return false;
+      }
+    }
+
+    // Streams beyond the supported count only print their format
+    for (uint32_t i = count; i < MaxStreamCount; i++)
+      m_streams[i].format = formats[i % formats.size()];
+
+    return true;
+  }
+
+  Com<ID3D11Texture2D> createInputTexture(const InputFormat& fmt, uint32_t index) {
+    // Cycle through pattern types and seeds so that feeds differ
+    static const std::array<pattern::Type, 4> s_types = {{
+      pattern::Type::ZonePlate, pattern::Type::ColorBars,
+      pattern::Type::Gradient,  pattern::Type::Noise,
+    }};
+
+    size_t pitch = pattern::getMinPitch(fmt.patternFormat, InputWidth);
+    std::vector<uint8_t> data(pattern::getImageSize(fmt.patternFormat, InputHeight, pitch));
+
+    pattern::GenerateArgs args;
+    args.type = s_types[index % s_types.size()];
+    args.format = fmt.patternFormat;
+    args.matrix = yuv::Matrix::BT709;
+    args.range = yuv::Range::Limited;
+    args.width = InputWidth;
+    args.height = InputHeight;
+    args.seed = index;
+    args.dst = data.data();
+    args.dstPitch = pitch;
+    pattern::generate(args);
+
+    D3D11_TEXTURE2D_DESC desc = { };
+    desc.Width = InputWidth;
+    desc.Height = InputHeight;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = fmt.format;
+    desc.SampleDesc = { 1, 0 };
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = 0;
+
+    D3D11_SUBRESOURCE_DATA initialData = { };
+    initialData.pSysMem = data.data();
+    initialData.SysMemPitch = pitch;
+
+    Com<ID3D11Texture2D> texture;
+
+    if (FAILED(m_device->CreateTexture2D(&desc, &initialData, &texture))) {
+      std::cerr << "Failed to create " << fmt.name << " input texture" << std::endl;
+      return nullptr;
+    }
+
+    return texture;
+  }
+
+  /**
+    * \brief Arranges streams in a video wall grid
+    *
+    * Odd streams show a cropped region of their input,
+    * and with stream alpha support, every other stream
+    * is blended with the background.
+    */
+  void layoutStreams(uint32_t count, bool hasAlpha) {
+    uint32_t cols = uint32_t(std::ceil(std::sqrt(float(count))));
+    uint32_t rows = (count + cols - 1) / cols;
+
+    uint32_t tileWidth = OutputWidth / cols;
+    uint32_t tileHeight = OutputHeight / rows;
+
+    for (uint32_t i = 0; i < count; i++) {
+      auto& stream = m_streams[i];
+
+      uint32_t x = (i % cols) * tileWidth;
+      uint32_t y = (i / cols) * tileHeight;
+
+      stream.dstRect = { LONG(x + 4), LONG(y + 4), LONG(x + tileWidth - 4), LONG(y + tileHeight - 4) };
+
+      if (i & 1)
+        stream.srcRect = { InputWidth / 4, InputHeight / 4, 3 * InputWidth / 4, 3 * InputHeight / 4 };
+      else
+        stream.srcRect = { 0, 0, InputWidth, InputHeight };
+
+      stream.alpha = hasAlpha && (i & 2) ? 0.75f : 1.0f;
+    }
+  }
+
+  void setStreamState(uint32_t streamIndex, const InputStream& stream) {
+    D3D11_VIDEO_PROCESSOR_COLOR_SPACE csIn = { };
+    csIn.Usage = 0; // Present
+    csIn.RGB_Range = 0;
+    csIn.YCbCr_Matrix = 1; // BT.709
+    csIn.Nominal_Range = D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_16_235;
+
+    m_vcontext->VideoProcessorSetStreamAutoProcessingMode(m_vprocessor.ptr(), streamIndex, false);
+    m_vcontext->VideoProcessorSetStreamFrameFormat(m_vprocessor.ptr(), streamIndex, D3D11_VIDEO_FRAME_FORMAT_PROGRESSIVE);
+    m_vcontext->VideoProcessorSetStreamColorSpace(m_vprocessor.ptr(), streamIndex, &csIn);
+    m_vcontext->VideoProcessorSetStreamSourceRect(m_vprocessor.ptr(), streamIndex, true, &stream.srcRect);
+    m_vcontext->VideoProcessorSetStreamDestRect(m_vprocessor.ptr(), streamIndex, true, &stream.dstRect);
+    m_vcontext->VideoProcessorSetStreamAlpha(m_vprocessor.ptr(), streamIndex, stream.alpha < 1.0f, stream.alpha);
+  }
+
+  /**
+    * \brief Renders one frame of the video wall
+    *
+    * Either composites all streams with a single blit, or
+    * issues one blit per stream. Every blit fills its target
+    * rect with the background color, so separate blits are
+    * restricted to their stream's dest rect to preserve the
+    * results of previous blits.
+    */
+  void renderFrame(uint32_t count, bool composed, uint32_t frame) {
+    if (composed) {
+      std::array<D3D11_VIDEO_PROCESSOR_STREAM, MaxStreamCount> streams = { };
+
+      for (uint32_t i = 0; i < count; i++) {
+        setStreamState(i, m_streams[i]);
+
+        streams[i].Enable = true;
+        streams[i].pInputSurface = m_streams[i].view.ptr();
+      }
+
+      m_vcontext->VideoProcessorSetOutputTargetRect(m_vprocessor.ptr(), false, nullptr);
+      m_vcontext->VideoProcessorBlt(m_vprocessor.ptr(), m_outputView.ptr(), frame, count, streams.data());
+    } else {
+      for (uint32_t i = 0; i < count; i++) {
+        setStreamState(0, m_streams[i]);
+
+        D3D11_VIDEO_PROCESSOR_STREAM stream = { };
+        stream.Enable = true;
+        stream.pInputSurface = m_streams[i].view.ptr();
+
+        m_vcontext->VideoProcessorSetOutputTargetRect(m_vprocessor.ptr(), true, &m_streams[i].dstRect);
+        m_vcontext->VideoProcessorBlt(m_vprocessor.ptr(), m_outputView.ptr(), frame, 1, &stream);
+      }
+    }
+  }
+
+  void runTest(uint32_t count, bool composed, double& framesPerSecond, double& gpuMs) {
+    D3D11_VIDEO_PROCESSOR_COLOR_SPACE csOut = { };
+    csOut.Usage = 0; // Present
+    csOut.RGB_Range = 0;
+    csOut.Nominal_Range = D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_0_255;
+
+    D3D11_VIDEO_COLOR background = { };
+    background.RGBA = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+    m_vcontext->VideoProcessorSetOutputColorSpace(m_vprocessor.ptr(), &csOut);
+    m_vcontext->VideoProcessorSetOutputBackgroundColor(m_vprocessor.ptr(), false, &background);
+
+    // Time entire frames, since the separate path
+    // needs multiple blits for the same result
+    auto result = measureGpuWork(m_device.ptr(), m_context.ptr(), m_query.ptr(),
+      WarmupFrames, MeasuredFrames, [&] (uint32_t i) {
+        renderFrame(count, composed, i);
+      });
+
+    framesPerSecond = result.callsPerSecond;
+    gpuMs = result.gpuMs;
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  VideoComposeApp app;
+  return app.run();
+}
@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <d3d11_1.h>
+
+#include <windows.h>
+
+#include "../common/com.h"
+#include "../common/gpu_bench.h"
+#include "../common/str.h"
+#include "../common/test_pattern.h"
+
+struct VideoPath {
+  const char*           name;
+  DXGI_FORMAT           inputFormat;
+  DXGI_COLOR_SPACE_TYPE inputColorSpace;
+  DXGI_FORMAT           outputFormat;
+  DXGI_COLOR_SPACE_TYPE outputColorSpace;
+  yuv::Matrix           matrix;
+  // Whether input and output share transfer function and primaries,
+  // so that the output only differs from the input by the matrix.
+  // Anything else involves tone mapping, which is up to the driver.
+  bool                  hasReference;
+};
+
+struct Resolution {
+  const char*   name;
+  uint32_t      width;
+  uint32_t      height;
+};
+
+struct InputImage {
+  DXGI_FORMAT             format = DXGI_FORMAT_UNKNOWN;
+  Com<ID3D11Texture2D>    texture;
+  std::vector<uint8_t>    data;
+  size_t                  pitch = 0;
+};
+
+const std::array<VideoPath, 9> g_paths = {{
+  { "NV12 709 -> RGB10 709",
+    DXGI_FORMAT_NV12, DXGI_COLOR_SPACE_YCBCR_STUDIO_G22_LEFT_P709,
+    DXGI_FORMAT_R10G10B10A2_UNORM, DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709,
+    yuv::Matrix::BT709, true },
+  { "P010 709 -> BGRA8 709",
+    DXGI_FORMAT_P010, DXGI_COLOR_SPACE_YCBCR_STUDIO_G22_LEFT_P709,
+    DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709,
+    yuv::Matrix::BT709, true },
+  { "P010 709 -> RGB10 709",
+    DXGI_FORMAT_P010, DXGI_COLOR_SPACE_YCBCR_STUDIO_G22_LEFT_P709,
+    DXGI_FORMAT_R10G10B10A2_UNORM, DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709,
+    yuv::Matrix::BT709, true },
+  { "P010 PQ -> RGB10 PQ",
+    DXGI_FORMAT_P010, DXGI_COLOR_SPACE_YCBCR_STUDIO_G2084_LEFT_P2020,
+    DXGI_FORMAT_R10G10B10A2_UNORM, DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020,
+    yuv::Matrix::BT2020, true },
+  { "P010 PQ -> RGB10 709",
+    DXGI_FORMAT_P010, DXGI_COLOR_SPACE_YCBCR_STUDIO_G2084_LEFT_P2020,
+    DXGI_FORMAT_R10G10B10A2_UNORM, DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709,
+    yuv::Matrix::BT2020, false },
+  { "P010 PQ -> FP16 scRGB",
+    DXGI_FORMAT_P010, DXGI_COLOR_SPACE_YCBCR_STUDIO_G2084_LEFT_P2020,
+    DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_COLOR_SPACE_RGB_FULL_G10_NONE_P709,
+    yuv::Matrix::BT2020, false },
+  { "P016 709 -> RGB10 709",
+    DXGI_FORMAT_P016, DXGI_COLOR_SPACE_YCBCR_STUDIO_G22_LEFT_P709,
+    DXGI_FORMAT_R10G10B10A2_UNORM, DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709,
+    yuv::Matrix::BT709, true },
+  { "P016 PQ -> RGB10 PQ",
+    DXGI_FORMAT_P016, DXGI_COLOR_SPACE_YCBCR_STUDIO_G2084_LEFT_P2020,
+    DXGI_FORMAT_R10G10B10A2_UNORM, DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020,
+    yuv::Matrix::BT2020, true },
+  { "P016 PQ -> FP16 scRGB",
+    DXGI_FORMAT_P016, DXGI_COLOR_SPACE_YCBCR_STUDIO_G2084_LEFT_P2020,
+    DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_COLOR_SPACE_RGB_FULL_G10_NONE_P709,
+    yuv::Matrix::BT2020, false },
+}};
+
+const std::array<Resolution, 2> g_resolutions = {{
+  { "1080p", 1920, 1080 },
+  { "4K",    3840, 2160 },
+}};
+
+const std::array<DXGI_FORMAT, 3> g_inputFormats = {{
+  DXGI_FORMAT_NV12,
+  DXGI_FORMAT_P010,
+  DXGI_FORMAT_P016,
+}};
+
+class VideoHdrApp {
+
+public:
+
+  VideoHdrApp() {
+    std::array<D3D_FEATURE_LEVEL, 2> fl = {
+      D3D_FEATURE_LEVEL_11_1,
+      D3D_FEATURE_LEVEL_11_0,
+    };
+
+    if (FAILED(D3D11CreateDevice(
+          nullptr, D3D_DRIVER_TYPE_HARDWARE,
+          nullptr, D3D11_CREATE_DEVICE_VIDEO_SUPPORT,
+          fl.data(), fl.size(), D3D11_SDK_VERSION,
+          &m_device, nullptr, &m_context))) {
+      std::cerr << "Failed to create D3D11 device" << std::endl;
+      return;
+    }
+
+    if (FAILED(m_device->QueryInterface(IID_PPV_ARGS(&m_vdevice)))) {
+      std::cerr << "Failed to query D3D11 video device" << std::endl;
+      return;
+    }
+
+    // Color spaces beyond BT.601/709 require the newer interfaces
+    if (FAILED(m_context->QueryInterface(IID_PPV_ARGS(&m_vcontext)))) {
+      std::cerr << "Failed to query ID3D11VideoContext1" << std::endl;
+      return;
+    }
+
+    D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT };
+
+    if (FAILED(m_device->CreateQuery(&queryDesc, &m_query))) {
+      std::cerr << "Failed to create event query" << std::endl;
+      return;
+    }
+
+    m_initialized = true;
+  }
+
+  int run() {
+    if (!m_initialized)
+      return 1;
+
+    std::cout << std::left << std::setw(26) << "Path" << std::setw(8) << "Size" << std::right
+              << std::setw(12) << "Blits/s" << std::setw(10) << "GPU ms"
+              << std::setw(10) << "PSNR" << std::setw(10) << "Max err" << std::endl;
+
+    for (const auto& res : g_resolutions) {
+      Com<ID3D11VideoProcessorEnumerator1> venum;
+      Com<ID3D11VideoProcessor> vprocessor;
+
+      if (!createProcessor(res.width, res.height, venum, vprocessor))
+        continue;
+
+      std::array<InputImage, g_inputFormats.size()> inputs;
+
+      for (uint32_t i = 0; i < g_inputFormats.size(); i++)
+        createInputImage(g_inputFormats[i], res.width, res.height, inputs[i]);
+
+      for (const auto& path : g_paths) {
+        std::cout << std::left << std::setw(26) << path.name << std::setw(8) << res.name << std::right;
+
+        auto input = std::find_if(inputs.begin(), inputs.end(),
+          [&path] (const InputImage& image) { return image.format == path.inputFormat; });
+
+        BOOL supported = FALSE;
+
+        if (input == inputs.end() || input->texture == nullptr
+         || FAILED(venum->CheckVideoProcessorFormatConversion(
+              path.inputFormat, path.inputColorSpace,
+              path.outputFormat, path.outputColorSpace, &supported))
+         || !supported) {
+          std::cout << std::setw(12) << "n/a" << std::endl;
+          continue;
+        }
+
+        Com<ID3D11VideoProcessorInputView> inputView;
+        Com<ID3D11Texture2D> output;
+        Com<ID3D11VideoProcessorOutputView> outputView;
+
+        if (!createViews(venum.ptr(), *input, path.outputFormat, res.width, res.height, inputView, output, outputView)) {
+          std::cout << std::setw(12) << "n/a" << std::endl;
+          continue;
+        }
+
+        double blitsPerSecond = 0.0;
+        double gpuMs = 0.0;
+
+        runTest(vprocessor.ptr(), outputView.ptr(), inputView.ptr(), path,
+          res.width, res.height, blitsPerSecond, gpuMs);
+
+        std::cout << std::fixed << std::setprecision(1) << std::setw(12) << blitsPerSecond
+                  << std::setprecision(3) << std::setw(10) << gpuMs;
+
+        double psnr = 0.0;
+        double maxError = 0.0;
+
+        if (path.hasReference && compareReference(output.ptr(), *input, path, res.width, res.height, psnr, maxError)) {
+          std::cout << std::setprecision(2) << std::setw(10) << psnr
+                    << std::setprecision(1) << std::setw(10) << maxError;
+        } else {
+          std::cout << std::setw(10) << "-" << std::setw(10) << "-";
+        }
+
+        std::cout << std::defaultfloat << std::endl;
+      }
+    }
+
+    return 0;
+  }
+
+private:
+
+  constexpr static uint32_t WarmupBlits   = 10;
+  constexpr static uint32_t MeasuredBlits = 200;
+
+  Com<ID3D11Device>             m_device;
+  Com<ID3D11DeviceContext>      m_context;
+  Com<ID3D11VideoDevice>        m_vdevice;
+  Com<ID3D11VideoContext1>      m_vcontext;
+  Com<ID3D11Query>              m_query;
+
+  bool m_initialized = false;
+
+  void createInputImage(DXGI_FORMAT format, uint32_t width, uint32_t height, InputImage& image) {
+    // Smooth gradients only, so that differences in chroma
+    // upsampling between drivers barely affect the results.
+    // P016 uses the full 16 bits, but P010 data is MSB-aligned,
+    // so the same bytes are valid P016 data at 10-bit precision.
+    // Paths decode with their own matrix, so the one used here
+    // only affects the content, not the expected results.
+    bool is8Bit = format == DXGI_FORMAT_NV12;
+
+    pattern::Format patternFormat = is8Bit ? pattern::Format::NV12 : pattern::Format::P010;
+
+    image.format = format;
+    image.pitch = pattern::getMinPitch(patternFormat, width);
+    image.data.resize(pattern::getImageSize(patternFormat, height, image.pitch));
+
+    pattern::GenerateArgs args;
+    args.type = pattern::Type::Gradient;
+    args.format = patternFormat;
+    args.matrix = is8Bit ? yuv::Matrix::BT709 : yuv::Matrix::BT2020;
+    args.range = yuv::Range::Limited;
+    args.width = width;
+    args.height = height;
+    args.dst = image.data.data();
+    args.dstPitch = image.pitch;
+    pattern::generate(args);
+
+    D3D11_TEXTURE2D_DESC desc = { };
+    desc.Width = width;
+    desc.Height = height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = format;
+    desc.SampleDesc = { 1, 0 };
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = 0;
+
+    D3D11_SUBRESOURCE_DATA initialData = { };
+    initialData.pSysMem = image.data.data();
+    initialData.SysMemPitch = image.pitch;
+
+    if (FAILED(m_device->CreateTexture2D(&desc, &initialData, &image.texture)))
+      image.texture = nullptr;
+  }
+
+  bool createProcessor(uint32_t width, uint32_t height,
+      Com<ID3D11VideoProcessorEnumerator1>& venum, Com<ID3D11VideoProcessor>& vprocessor) {
+    D3D11_VIDEO_PROCESSOR_CONTENT_DESC videoEnumDesc = { };
+    videoEnumDesc.InputFrameFormat = D3D11_VIDEO_FRAME_FORMAT_PROGRESSIVE;
+    videoEnumDesc.InputFrameRate = { 60, 1 };
+    videoEnumDesc.InputWidth = width;
+    videoEnumDesc.InputHeight = height;
+    videoEnumDesc.OutputFrameRate = { 60, 1 };
+    videoEnumDesc.OutputWidth = width;
+    videoEnumDesc.OutputHeight = height;
+    videoEnumDesc.Usage = D3D11_VIDEO_USAGE_OPTIMAL_SPEED;
+
+    Com<ID3D11VideoProcessorEnumerator> venum0;
+
+    if (FAILED(m_vdevice->CreateVideoProcessorEnumerator(&videoEnumDesc, &venum0))) {
+      std::cerr << "Failed to create D3D11 video processor enumerator" << std::endl;
+      return false;
+    }
+
+    if (FAILED(venum0->QueryInterface(IID_PPV_ARGS(&venum)))) {
+      std::cerr << "Failed to query ID3D11VideoProcessorEnumerator1" << std::endl;
+      return false;
+    }
+
+    if (FAILED(m_vdevice->CreateVideoProcessor(venum0.ptr(), 0, &vprocessor))) {
+      std::cerr << "Failed to create D3D11 video processor" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool createViews(ID3D11VideoProcessorEnumerator1* venum, const InputImage& input,
+      DXGI_FORMAT outputFormat, uint32_t width, uint32_t height,
+      Com<ID3D11VideoProcessorInputView>& inputView, Com<ID3D11Texture2D>& output,
+      Com<ID3D11VideoProcessorOutputView>& outputView) {
+    D3D11_VIDEO_PROCESSOR_INPUT_VIEW_DESC inputDesc = { };
+    inputDesc.ViewDimension = D3D11_VPIV_DIMENSION_TEXTURE2D;
+    inputDesc.Texture2D.MipSlice = 0;
+
+    if (FAILED(m_vdevice->CreateVideoProcessorInputView(input.texture.ptr(), venum, &inputDesc, &inputView)))
+      return false;
+
+    D3D11_TEXTURE2D_DESC desc = { };
+    desc.Width = width;
+    desc.Height = height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = outputFormat;
+    desc.SampleDesc = { 1, 0 };
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+    if (FAILED(m_device->CreateTexture2D(&desc, nullptr, &output)))
+      return false;
+
+    D3D11_VIDEO_PROCESSOR_OUTPUT_VIEW_DESC outputDesc = { };
+    outputDesc.ViewDimension = D3D11_VPOV_DIMENSION_TEXTURE2D;
+    outputDesc.Texture2D.MipSlice = 0;
+
+    return SUCCEEDED(m_vdevice->CreateVideoProcessorOutputView(output.ptr(), venum, &outputDesc, &outputView));
+  }
+
+  void runTest(ID3D11VideoProcessor* vprocessor, ID3D11VideoProcessorOutputView* outputView,
+      ID3D11VideoProcessorInputView* inputView, const VideoPath& path,
+      uint32_t width, uint32_t height, double& blitsPerSecond, double& gpuMs) {
+    RECT rect = { 0, 0, LONG(width), LONG(height) };
+
+    m_vcontext->VideoProcessorSetStreamAutoProcessingMode(vprocessor, 0, false);
+    m_vcontext->VideoProcessorSetStreamFrameFormat(vprocessor, 0, D3D11_VIDEO_FRAME_FORMAT_PROGRESSIVE);
+    m_vcontext->VideoProcessorSetStreamSourceRect(vprocessor, 0, true, &rect);
+    m_vcontext->VideoProcessorSetStreamDestRect(vprocessor, 0, true, &rect);
+    m_vcontext->VideoProcessorSetStreamColorSpace1(vprocessor, 0, path.inputColorSpace);
+    m_vcontext->VideoProcessorSetOutputColorSpace1(vprocessor, path.outputColorSpace);
+
+    D3D11_VIDEO_PROCESSOR_STREAM stream = { };
+    stream.Enable = true;
+    stream.pInputSurface = inputView;
+
+    auto result = measureGpuWork(m_device.ptr(), m_context.ptr(), m_query.ptr(),
+      WarmupBlits, MeasuredBlits, [&] (uint32_t i) {
+        m_vcontext->VideoProcessorBlt(vprocessor, outputView, i, 1, &stream);
+      });
+
+    blitsPerSecond = result.callsPerSecond;
+    gpuMs = result.gpuMs;
+  }
+
+  /**
+    * \brief Compares the output with a CPU reference
+    *
+    * Decodes the input with \ref yuv::toRgb, using the
+    * nearest chroma sample. Errors are measured in output
+    * code values, with PSNR relative to the output peak.
+    */
+  bool compareReference(ID3D11Texture2D* output, const InputImage& input, const VideoPath& path,
+      uint32_t width, uint32_t height, double& psnr, double& maxError) {
+    D3D11_TEXTURE2D_DESC desc;
+    output->GetDesc(&desc);
+
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    Com<ID3D11Texture2D> staging;
+
+    if (FAILED(m_device->CreateTexture2D(&desc, nullptr, &staging)))
+      return false;
+
+    m_context->CopyResource(staging.ptr(), output);
+
+    D3D11_MAPPED_SUBRESOURCE mapped = { };
+
+    if (FAILED(m_context->Map(staging.ptr(), 0, D3D11_MAP_READ, 0, &mapped)))
+      return false;
+
+    bool is8BitOutput = path.outputFormat == DXGI_FORMAT_B8G8R8A8_UNORM;
+    double peak = is8BitOutput ? 255.0 : 1023.0;
+
+    double sumSq = 0.0;
+    maxError = 0.0;
+
+    for (uint32_t y = 0; y < height; y++) {
+      auto row = reinterpret_cast<const uint8_t*>(mapped.pData) + y * mapped.RowPitch;
+
+      for (uint32_t x = 0; x < width; x++) {
+        float expected[3];
+        decodeInput(input, path.matrix, x, y, height, expected);
+
+        uint32_t pixel;
+        std::memcpy(&pixel, &row[4 * x], sizeof(pixel));
+
+        std::array<uint32_t, 3> actual;
+
+        if (is8BitOutput)
+          actual = {{ (pixel >> 16) & 0xFF, (pixel >> 8) & 0xFF, pixel & 0xFF }};
+        else
+          actual = {{ pixel & 0x3FF, (pixel >> 10) & 0x3FF, (pixel >> 20) & 0x3FF }};
+
+        for (uint32_t c = 0; c < 3; c++) {
+          double error = double(actual[c]) - double(expected[c]) * peak;
+          sumSq += error * error;
+          maxError = std::max(maxError, std::abs(error));
+        }
+      }
+    }
+
+    m_context->Unmap(staging.ptr(), 0);
+
+    double mse = sumSq / double(3 * width * height);
+    psnr = mse > 0.0 ? 10.0 * std::log10(peak * peak / mse) : 99.0;
+    return true;
+  }
+
+  void decodeInput(const InputImage& input, yuv::Matrix matrix,
+      uint32_t x, uint32_t y, uint32_t height, float rgb[3]) {
+    const uint8_t* luma = &input.data[y * input.pitch];
+    const uint8_t* chroma = &input.data[(height + y / 2) * input.pitch];
+
+    switch (input.format) {
+      case DXGI_FORMAT_NV12: {
+        const uint8_t* uv = &chroma[2 * (x / 2)];
+        yuv::toRgb(matrix, yuv::Range::Limited, 8, luma[x], uv[0], uv[1], rgb);
+      } break;
+
+      case DXGI_FORMAT_P010:
+      case DXGI_FORMAT_P016: {
+        uint16_t yv, uv[2];
+        std::memcpy(&yv, &luma[2 * x], sizeof(yv));
+        std::memcpy(uv, &chroma[4 * (x / 2)], sizeof(uv));
+
+        // P016 interprets all 16 bits, P010 only the upper 10
+        uint32_t shift = input.format == DXGI_FORMAT_P010 ? 6 : 0;
+        uint32_t bitDepth = input.format == DXGI_FORMAT_P010 ? 10 : 16;
+        yuv::toRgb(matrix, yuv::Range::Limited, bitDepth, yv >> shift, uv[0] >> shift, uv[1] >> shift, rgb);
+      } break;
+
+      default:
+        rgb[0] = rgb[1] = rgb[2] = 0.0f;
+    }
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  VideoHdrApp app;
+  return app.run();
+}
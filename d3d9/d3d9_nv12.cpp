@@ -1,6 +1,10 @@
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <d3d9.h>
@@ -8,7 +12,11 @@
 
 #include "../common/com.h"
 #include "../common/error.h"
+#include "../common/pitch_copy.h"
 #include "../common/str.h"
+#include "../common/test_pattern.h"
+#include "../common/timer.h"
+#include "../common/yuv_sequence.h"
 
 #include "d3d9_nv12.yuv.h"
 
@@ -66,8 +74,9 @@ class TriangleApp {
   
 public:
   
-  TriangleApp(HINSTANCE instance, HWND window)
-  : m_window(window) {
+  TriangleApp(HINSTANCE instance, HWND window, const YuvSequenceDesc& stream,
+      const pattern::PatternDesc& patternDesc, bool upload, PitchCopyMethod uploadMethod, bool benchmark)
+  : m_window(window), m_benchmark(benchmark), m_uploadMethod(uploadMethod) {
     HRESULT status = Direct3DCreate9Ex(D3D_SDK_VERSION, &m_d3d);
 
     if (FAILED(status))
@@ -188,17 +197,64 @@ public:
 
     m_device->SetVertexDeclaration(m_decl.ptr());
 
+    if (!stream.path.empty()) {
+      createStreamResources(stream);
+      return;
+    }
+
+    if (upload) {
+      createUploadResources(patternDesc);
+      return;
+    }
+
     const uint32_t imageSize = 320;
 
+    uint32_t imageWidth = patternDesc.width ? patternDesc.width : imageSize;
+    uint32_t imageHeight = patternDesc.height ? patternDesc.height : imageSize;
+
     Com<IDirect3DTexture9> texture;
     Com<IDirect3DSurface9> texSurf;
-    status = m_device->CreateTexture(imageSize, imageSize, 1, D3DUSAGE_RENDERTARGET, D3DFMT_X8R8G8B8, D3DPOOL_DEFAULT, &texture, nullptr);
+    status = m_device->CreateTexture(imageWidth, imageHeight, 1, D3DUSAGE_RENDERTARGET, D3DFMT_X8R8G8B8, D3DPOOL_DEFAULT, &texture, nullptr);
+
+    if (FAILED(status))
+      throw Error(format("Failed to create ", imageWidth, "x", imageHeight, " texture"));
+
     status = texture->GetSurfaceLevel(0, &texSurf);
 
     Com<IDirect3DSurface9> nv12Surf;
-    status = m_device->CreateOffscreenPlainSurface(imageSize, imageSize, (D3DFORMAT)MAKEFOURCC('N', 'V', '1', '2'), D3DPOOL_DEFAULT, &nv12Surf, nullptr);
+    status = m_device->CreateOffscreenPlainSurface(imageWidth, imageHeight, (D3DFORMAT)MAKEFOURCC('N', 'V', '1', '2'), D3DPOOL_DEFAULT, &nv12Surf, nullptr);
+
+    if (FAILED(status))
+      throw Error(format("Failed to create ", imageWidth, "x", imageHeight, " NV12 surface"));
+
     D3DLOCKED_RECT rect;
     nv12Surf->LockRect(&rect, nullptr, 0);
+
+    if (patternDesc.width) {
+      // The chroma plane of a locked NV12 surface follows the last
+      // luma row, which is the layout the generator writes.
+      Timer timer;
+
+      pattern::GenerateArgs args;
+      args.type = patternDesc.type;
+      args.format = pattern::Format::NV12;
+      args.matrix = yuv::Matrix::BT709;
+      args.range = yuv::Range::Limited;
+      args.width = imageWidth;
+      args.height = imageHeight;
+      args.dst = rect.pBits;
+      args.dstPitch = size_t(rect.Pitch);
+      pattern::generate(args);
+
+      std::cout << "Generated " << imageWidth << "x" << imageHeight << " pattern in "
+                << timer.ms() << " ms" << std::endl;
+
+      nv12Surf->UnlockRect();
+      status = m_device->StretchRect(nv12Surf.ptr(), nullptr, texSurf.ptr(), nullptr, D3DTEXF_LINEAR);
+      m_device->SetTexture(0, texture.ptr());
+      return;
+    }
+
     char* dst = (char*)rect.pBits;
     char* src = (char*)test_d3d9_nv12_yuv;
     for (uint32_t i = 0; i < imageSize; i++)
@@ -222,6 +278,11 @@ public:
   void run() {
     this->adjustBackBuffer();
 
+    if (m_sequence)
+      uploadStreamFrame();
+    else if (m_uploadSurface != nullptr)
+      uploadFrame();
+
     m_device->BeginScene();
 
     m_device->Clear(
@@ -250,6 +311,230 @@ public:
       nullptr,
       nullptr,
       0);
+
+    if (m_sequence && ++m_streamFrameCount == (m_benchmark ? m_streamBenchmarkFrames : StreamReportInterval)) {
+      printStreamStats();
+      resetStreamStats();
+    }
+
+    if (m_uploadSurface != nullptr && ++m_uploadFrameCount == (m_benchmark ? UploadBenchmarkFrames : StreamReportInterval)) {
+      printUploadStats();
+      resetUploadStats();
+
+      // Benchmark both copy methods back to back
+      if (m_benchmark) {
+        if (m_uploadMethod == PitchCopyMethod::Memcpy)
+          m_uploadMethod = PitchCopyMethod::Streaming;
+        else
+          m_uploadDone = true;
+      }
+    }
+  }
+
+  /**
+    * \brief Whether the benchmark has finished
+    */
+  bool done() const {
+    if (m_uploadSurface != nullptr)
+      return m_uploadDone;
+
+    return m_benchmark && m_streamFrame >= m_streamBenchmarkFrames;
+  }
+
+  void createStreamResources(const YuvSequenceDesc& stream) {
+    static const std::array<D3DFORMAT, 4> s_formats = {{
+      D3DFORMAT(MAKEFOURCC('N', 'V', '1', '2')),
+      D3DFORMAT(MAKEFOURCC('Y', 'U', 'Y', '2')),
+      D3DFORMAT(MAKEFOURCC('P', '0', '1', '0')),
+      D3DFORMAT(MAKEFOURCC('A', 'Y', 'U', 'V')),
+    }};
+
+    m_sequence = std::make_unique<YuvSequence>(stream);
+
+    if (!m_sequence->valid())
+      throw Error(format("Failed to open ", stream.path, " or file too small for one frame"));
+
+    HRESULT status = m_device->CreateTexture(stream.width, stream.height, 1,
+      D3DUSAGE_RENDERTARGET, D3DFMT_X8R8G8B8, D3DPOOL_DEFAULT, &m_streamTexture, nullptr);
+
+    if (FAILED(status))
+      throw Error("Failed to create video texture");
+
+    m_streamTexture->GetSurfaceLevel(0, &m_streamTarget);
+
+    for (auto& surface : m_streamRing) {
+      status = m_device->CreateOffscreenPlainSurface(stream.width, stream.height,
+        s_formats[uint32_t(stream.format)], D3DPOOL_DEFAULT, &surface, nullptr);
+
+      if (FAILED(status))
+        throw Error("Failed to create video surface, format may not be supported");
+    }
+
+    m_device->SetTexture(0, m_streamTexture.ptr());
+
+    // Play every frame at least once when benchmarking
+    m_streamBenchmarkFrames = std::max(m_sequence->frameCount(), StreamBenchmarkFrames);
+
+    std::cout << "Streaming " << stream.path << ": " << m_sequence->frameCount() << " frames, "
+              << stream.width << "x" << stream.height << std::endl;
+
+    resetStreamStats();
+  }
+
+  /**
+    * \brief Uploads the next sequence frame
+    *
+    * Writes the frame to the next surface in the ring with
+    * a non-blocking lock, then converts it to RGB with
+    * StretchRect. A lock that would block means that the
+    * GPU is more than a ring's worth of frames behind, and
+    * is counted as a stall.
+    */
+  void uploadStreamFrame() {
+    uint32_t frame = m_streamFrame++;
+    IDirect3DSurface9* surface = m_streamRing[frame % StreamRingSize].ptr();
+
+    Timer uploadTimer;
+    D3DLOCKED_RECT rect = { };
+    HRESULT status = surface->LockRect(&rect, nullptr, D3DLOCK_DONOTWAIT);
+
+    if (status == D3DERR_WASSTILLDRAWING) {
+      m_streamStalls += 1;
+
+      while ((status = surface->LockRect(&rect, nullptr, D3DLOCK_DONOTWAIT)) == D3DERR_WASSTILLDRAWING)
+        continue;
+    }
+
+    if (FAILED(status))
+      throw Error("Failed to lock video surface");
+
+    bool copied = m_sequence->copyFrame(frame, rect.pBits, rect.Pitch);
+    surface->UnlockRect();
+
+    if (!copied)
+      throw Error(format("Failed to read frame ", frame));
+
+    m_streamUploadMs += uploadTimer.ms();
+    m_device->StretchRect(surface, nullptr, m_streamTarget.ptr(), nullptr, D3DTEXF_LINEAR);
+  }
+
+  /**
+    * \brief Creates resources for dynamic uploads
+    *
+    * Generates a set of source frames in system memory, so
+    * that each frame copies different data, and a single
+    * dynamic NV12 texture that is locked with \c D3DLOCK_DISCARD
+    * every frame, like a video player without a ring would.
+    * Discard is only valid on dynamic textures, so a plain
+    * offscreen surface cannot be used here.
+    */
+  void createUploadResources(const pattern::PatternDesc& patternDesc) {
+    m_uploadWidth = patternDesc.width ? patternDesc.width : 1920;
+    m_uploadHeight = patternDesc.height ? patternDesc.height : 1080;
+
+    HRESULT status = m_device->CreateTexture(m_uploadWidth, m_uploadHeight, 1,
+      D3DUSAGE_RENDERTARGET, D3DFMT_X8R8G8B8, D3DPOOL_DEFAULT, &m_streamTexture, nullptr);
+
+    if (FAILED(status))
+      throw Error("Failed to create video texture");
+
+    m_streamTexture->GetSurfaceLevel(0, &m_streamTarget);
+
+    status = m_device->CreateTexture(m_uploadWidth, m_uploadHeight, 1, D3DUSAGE_DYNAMIC,
+      D3DFORMAT(MAKEFOURCC('N', 'V', '1', '2')), D3DPOOL_DEFAULT, &m_uploadTexture, nullptr);
+
+    if (FAILED(status))
+      throw Error("Failed to create dynamic NV12 upload texture");
+
+    m_uploadTexture->GetSurfaceLevel(0, &m_uploadSurface);
+
+    m_device->SetTexture(0, m_streamTexture.ptr());
+
+    // Noise by default, since it is the only pattern that
+    // differs between frames. Frames are tightly packed.
+    pattern::GenerateArgs args;
+    args.type = patternDesc.width ? patternDesc.type : pattern::Type::Noise;
+    args.format = pattern::Format::NV12;
+    args.width = m_uploadWidth;
+    args.height = m_uploadHeight;
+    args.dstPitch = pattern::getMinPitch(args.format, m_uploadWidth);
+
+    for (uint32_t i = 0; i < m_uploadFrames.size(); i++) {
+      m_uploadFrames[i].resize(pattern::getImageSize(args.format, m_uploadHeight, args.dstPitch));
+
+      args.seed = i;
+      args.dst = m_uploadFrames[i].data();
+      pattern::generate(args);
+    }
+
+    std::cout << "Uploading " << m_uploadWidth << "x" << m_uploadHeight << " NV12 frames" << std::endl;
+
+    resetUploadStats();
+  }
+
+  /**
+    * \brief Uploads the next generated frame
+    *
+    * Locks the dynamic upload texture with \c D3DLOCK_DISCARD,
+    * so that the driver can rename it instead of waiting for
+    * the previous StretchRect, and copies the frame with the
+    * current copy method before converting it to RGB. Only
+    * the copy is timed, so that lock overhead does not skew
+    * the comparison between copy methods.
+    */
+  void uploadFrame() {
+    const auto& frame = m_uploadFrames[m_uploadFrame++ % m_uploadFrames.size()];
+
+    D3DLOCKED_RECT rect = { };
+
+    if (FAILED(m_uploadTexture->LockRect(0, &rect, nullptr, D3DLOCK_DISCARD)))
+      throw Error("Failed to lock upload texture");
+
+    // Luma and chroma rows are contiguous on both sides
+    Timer uploadTimer;
+    copyPitchedRows(m_uploadMethod, rect.pBits, size_t(rect.Pitch),
+      frame.data(), m_uploadWidth, m_uploadWidth, m_uploadHeight + m_uploadHeight / 2);
+    m_uploadMs += uploadTimer.ms();
+
+    m_uploadTexture->UnlockRect(0);
+
+    m_device->StretchRect(m_uploadSurface.ptr(), nullptr, m_streamTarget.ptr(), nullptr, D3DTEXF_LINEAR);
+  }
+
+  void resetUploadStats() {
+    m_uploadTimer.reset();
+    m_uploadFrameCount = 0;
+    m_uploadMs = 0.0;
+  }
+
+  void printUploadStats() {
+    double seconds = m_uploadTimer.ms() / 1000.0;
+    double frameBytes = double(m_uploadWidth) * double(m_uploadHeight + m_uploadHeight / 2);
+    double bytes = frameBytes * double(m_uploadFrameCount);
+
+    std::cout << (m_uploadMethod == PitchCopyMethod::Memcpy ? "memcpy:    " : "streaming: ")
+              << m_uploadFrameCount << " frames, "
+              << 1000.0 * seconds / double(m_uploadFrameCount) << " ms per frame, "
+              << bytes / double(1u << 20) / (m_uploadMs / 1000.0) << " MB/s upload, "
+              << m_uploadMs / double(m_uploadFrameCount) << " ms CPU upload per frame" << std::endl;
+  }
+
+  void resetStreamStats() {
+    m_streamTimer.reset();
+    m_streamFrameCount = 0;
+    m_streamStalls = 0;
+    m_streamUploadMs = 0.0;
+  }
+
+  void printStreamStats() {
+    double seconds = m_streamTimer.ms() / 1000.0;
+    double bytes = double(m_sequence->frameSize()) * double(m_streamFrameCount);
+
+    std::cout << m_streamFrameCount << " frames: "
+              << double(m_streamFrameCount) / seconds << " fps, "
+              << bytes / double(1u << 20) / seconds << " MB/s uploaded, "
+              << m_streamUploadMs / double(m_streamFrameCount) << " ms CPU upload per frame, "
+              << m_streamStalls << " ring stall(s)" << std::endl;
   }
   
   void adjustBackBuffer() {
@@ -286,15 +571,22 @@ public:
     params.hDeviceWindow = m_window;
     params.MultiSampleQuality = 0;
     params.MultiSampleType = D3DMULTISAMPLE_NONE;
-    params.PresentationInterval = D3DPRESENT_INTERVAL_DEFAULT;
+    params.PresentationInterval = m_benchmark ? D3DPRESENT_INTERVAL_IMMEDIATE : D3DPRESENT_INTERVAL_DEFAULT;
     params.SwapEffect = D3DSWAPEFFECT_DISCARD;
     params.Windowed = TRUE;
   }
     
 private:
+
+  constexpr static uint32_t StreamRingSize        = 4;
+  constexpr static uint32_t StreamReportInterval  = 600;
+  constexpr static uint32_t StreamBenchmarkFrames = 1000;
+  constexpr static uint32_t UploadFrameCount      = 8;
+  constexpr static uint32_t UploadBenchmarkFrames = 1000;
   
   HWND                          m_window;
   Extent2D                      m_windowSize = { 1024, 600 };
+  bool                          m_benchmark = false;
   
   Com<IDirect3D9Ex>             m_d3d;
   Com<IDirect3DDevice9Ex>       m_device;
@@ -303,6 +595,30 @@ private:
   Com<IDirect3DPixelShader9>    m_ps;
   Com<IDirect3DVertexBuffer9>   m_vb;
   Com<IDirect3DVertexDeclaration9> m_decl;
+
+  std::unique_ptr<YuvSequence>  m_sequence;
+  Com<IDirect3DTexture9>        m_streamTexture;
+  Com<IDirect3DSurface9>        m_streamTarget;
+  std::array<Com<IDirect3DSurface9>, StreamRingSize> m_streamRing;
+
+  uint32_t                      m_streamFrame = 0;
+  uint32_t                      m_streamFrameCount = 0;
+  uint32_t                      m_streamBenchmarkFrames = 0;
+  uint32_t                      m_streamStalls = 0;
+  double                        m_streamUploadMs = 0.0;
+  Timer                         m_streamTimer;
+
+  Com<IDirect3DTexture9>        m_uploadTexture;
+  Com<IDirect3DSurface9>        m_uploadSurface;
+  std::array<std::vector<uint8_t>, UploadFrameCount> m_uploadFrames;
+  PitchCopyMethod               m_uploadMethod = PitchCopyMethod::Streaming;
+  uint32_t                      m_uploadWidth = 0;
+  uint32_t                      m_uploadHeight = 0;
+  uint32_t                      m_uploadFrame = 0;
+  uint32_t                      m_uploadFrameCount = 0;
+  bool                          m_uploadDone = false;
+  double                        m_uploadMs = 0.0;
+  Timer                         m_uploadTimer;
   
 };
 
@@ -315,6 +631,53 @@ int WINAPI WinMain(HINSTANCE hInstance,
                    HINSTANCE hPrevInstance,
                    LPSTR lpCmdLine,
                    int nCmdShow) {
+  // Usage: d3d9-nv12 [stream <file> <nv12|yuy2|p010> <width>x<height> [bench]]
+  //                  [pattern <bars|gradient|zoneplate|noise> <width>x<height>]
+  //                  [upload [memcpy] [bench]]
+  YuvSequenceDesc stream;
+  pattern::PatternDesc patternDesc;
+  PitchCopyMethod uploadMethod = PitchCopyMethod::Streaming;
+  bool upload = false;
+  bool benchmark = false;
+
+  if (lpCmdLine) {
+    std::stringstream args(lpCmdLine);
+    std::string arg;
+
+    while (args >> arg) {
+      if (arg == "bench")
+        benchmark = true;
+      else if (arg == "upload")
+        upload = true;
+      else if (arg == "memcpy")
+        uploadMethod = PitchCopyMethod::Memcpy;
+      else if (arg == "stream") {
+        std::string formatArg;
+        std::string sizeArg;
+
+        if (!(args >> stream.path >> formatArg >> sizeArg) || !stream.parse(formatArg, sizeArg)) {
+          std::cerr << "Usage: stream <file> <nv12|yuy2|p010> <width>x<height>" << std::endl;
+          return 1;
+        }
+      } else if (arg == "pattern") {
+        std::string typeArg;
+        std::string sizeArg;
+
+        if (!(args >> typeArg >> sizeArg) || !patternDesc.parse(typeArg, sizeArg)) {
+          std::cerr << "Usage: pattern <bars|gradient|zoneplate|noise> <width>x<height>" << std::endl;
+          return 1;
+        }
+      }
+    }
+  }
+
+  // Benchmarking only makes sense for streamed or uploaded input,
+  // and compares both copy methods in the latter case
+  benchmark &= !stream.path.empty() || upload;
+
+  if (upload && benchmark)
+    uploadMethod = PitchCopyMethod::Memcpy;
+
   HWND hWnd;
   WNDCLASSEXW wc;
   ZeroMemory(&wc, sizeof(WNDCLASSEX));
@@ -342,9 +705,9 @@ int WINAPI WinMain(HINSTANCE hInstance,
   MSG msg;
   
   try {
-    TriangleApp app(hInstance, hWnd);
+    TriangleApp app(hInstance, hWnd, stream, patternDesc, upload, uploadMethod, benchmark);
   
-    while (true) {
+    while (!app.done()) {
       if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
         TranslateMessage(&msg);
         DispatchMessage(&msg);
@@ -355,6 +718,8 @@ int WINAPI WinMain(HINSTANCE hInstance,
         app.run();
       }
     }
+
+    return 0;
   } catch (const Error& e) {
     std::cerr << e.message() << std::endl;
     return msg.wParam;
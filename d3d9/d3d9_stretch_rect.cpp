@@ -0,0 +1,354 @@
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <d3d9.h>
+
+#include "../common/com.h"
+#include "../common/error.h"
+#include "../common/str.h"
+#include "../common/test_pattern.h"
+#include "../common/timer.h"
+
+struct SourceFormat {
+  const char*     name;
+  D3DFORMAT       format;
+};
+
+struct TargetFormat {
+  const char*     name;
+  D3DFORMAT       format;
+};
+
+struct FilterType {
+  const char*           name;
+  D3DTEXTUREFILTERTYPE  filter;
+};
+
+const std::array<SourceFormat, 4> g_sourceFormats = {{
+  { "NV12", D3DFORMAT(MAKEFOURCC('N', 'V', '1', '2')) },
+  { "YUY2", D3DFORMAT(MAKEFOURCC('Y', 'U', 'Y', '2')) },
+  { "UYVY", D3DFORMAT(MAKEFOURCC('U', 'Y', 'V', 'Y')) },
+  { "YV12", D3DFORMAT(MAKEFOURCC('Y', 'V', '1', '2')) },
+}};
+
+const std::array<TargetFormat, 5> g_targetFormats = {{
+  { "X8R8G8B8",    D3DFMT_X8R8G8B8 },
+  { "A8R8G8B8",    D3DFMT_A8R8G8B8 },
+  { "R5G6B5",      D3DFMT_R5G6B5 },
+  { "X1R5G5B5",    D3DFMT_X1R5G5B5 },
+  { "A2R10G10B10", D3DFMT_A2R10G10B10 },
+}};
+
+const std::array<FilterType, 2> g_filters = {{
+  { "POINT",  D3DTEXF_POINT },
+  { "LINEAR", D3DTEXF_LINEAR },
+}};
+
+// Output size relative to the source, in percent
+const std::array<uint32_t, 4> g_scaleFactors = {{ 50, 75, 100, 150 }};
+
+class StretchRectApp {
+
+public:
+
+  StretchRectApp(HWND window)
+  : m_window(window) {
+    HRESULT status = Direct3DCreate9Ex(D3D_SDK_VERSION, &m_d3d);
+
+    if (FAILED(status))
+      throw Error("Failed to create D3D9 interface");
+
+    D3DADAPTER_IDENTIFIER9 adapterId;
+    m_d3d->GetAdapterIdentifier(D3DADAPTER_DEFAULT, 0, &adapterId);
+
+    std::cout << format("Using adapter: ", adapterId.Description) << std::endl;
+
+    D3DPRESENT_PARAMETERS params = { };
+    params.BackBufferCount = 1;
+    params.BackBufferFormat = D3DFMT_X8R8G8B8;
+    params.BackBufferWidth = 64;
+    params.BackBufferHeight = 64;
+    params.hDeviceWindow = m_window;
+    params.MultiSampleType = D3DMULTISAMPLE_NONE;
+    params.PresentationInterval = D3DPRESENT_INTERVAL_IMMEDIATE;
+    params.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    params.Windowed = TRUE;
+
+    status = m_d3d->CreateDeviceEx(
+      D3DADAPTER_DEFAULT,
+      D3DDEVTYPE_HAL,
+      m_window,
+      D3DCREATE_HARDWARE_VERTEXPROCESSING,
+      &params,
+      nullptr,
+      &m_device);
+
+    if (FAILED(status))
+      throw Error("Failed to create D3D9 device");
+
+    if (FAILED(m_device->CreateQuery(D3DQUERYTYPE_EVENT, &m_event)))
+      throw Error("Failed to create event query");
+
+    // Timestamps are optional, GPU times are reported as n/a without them
+    if (FAILED(m_device->CreateQuery(D3DQUERYTYPE_TIMESTAMP, &m_timestampStart))
+     || FAILED(m_device->CreateQuery(D3DQUERYTYPE_TIMESTAMP, &m_timestampEnd))
+     || FAILED(m_device->CreateQuery(D3DQUERYTYPE_TIMESTAMPDISJOINT, &m_timestampDisjoint))
+     || FAILED(m_device->CreateQuery(D3DQUERYTYPE_TIMESTAMPFREQ, &m_timestampFreq))) {
+      std::cout << "Timestamp queries not supported" << std::endl;
+      m_timestampStart = nullptr;
+    }
+  }
+
+  void run() {
+    std::cout << std::left << std::setw(8) << "Source" << std::setw(14) << "Target"
+              << std::setw(8) << "Filter" << std::setw(12) << "Output" << std::right
+              << std::setw(12) << "Calls/s" << std::setw(12) << "GPU ms" << std::endl;
+
+    for (const auto& src : g_sourceFormats) {
+      Com<IDirect3DSurface9> srcSurface;
+
+      HRESULT status = m_device->CreateOffscreenPlainSurface(SourceWidth, SourceHeight,
+        src.format, D3DPOOL_DEFAULT, &srcSurface, nullptr);
+
+      if (FAILED(status)) {
+        std::cout << std::left << std::setw(8) << src.name << "not supported" << std::endl;
+        continue;
+      }
+
+      fillSurface(srcSurface.ptr(), src.format);
+
+      for (const auto& dst : g_targetFormats) {
+        if (FAILED(m_d3d->CheckDeviceFormatConversion(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, src.format, dst.format))) {
+          std::cout << std::left << std::setw(8) << src.name << std::setw(14) << dst.name
+                    << "conversion not supported" << std::endl;
+          continue;
+        }
+
+        for (uint32_t scale : g_scaleFactors) {
+          uint32_t dstWidth = (SourceWidth * scale / 100) & ~1u;
+          uint32_t dstHeight = (SourceHeight * scale / 100) & ~1u;
+
+          Com<IDirect3DSurface9> dstSurface;
+
+          status = m_device->CreateRenderTarget(dstWidth, dstHeight, dst.format,
+            D3DMULTISAMPLE_NONE, 0, FALSE, &dstSurface, nullptr);
+
+          for (const auto& filter : g_filters) {
+            std::cout << std::left << std::setw(8) << src.name << std::setw(14) << dst.name
+                      << std::setw(8) << filter.name << std::setw(12) << format(dstWidth, "x", dstHeight)
+                      << std::right;
+
+            if (FAILED(status)) {
+              std::cout << std::setw(12) << "n/a" << std::endl;
+              continue;
+            }
+
+            double callsPerSecond = 0.0;
+            double gpuMs = 0.0;
+
+            if (!runTest(srcSurface.ptr(), dstSurface.ptr(), filter.filter, callsPerSecond, gpuMs)) {
+              std::cout << std::setw(12) << "failed" << std::endl;
+              continue;
+            }
+
+            std::cout << std::fixed << std::setprecision(1) << std::setw(12) << callsPerSecond;
+
+            if (gpuMs > 0.0)
+              std::cout << std::setprecision(3) << std::setw(12) << gpuMs;
+            else
+              std::cout << std::setw(12) << "n/a";
+
+            std::cout << std::defaultfloat << std::endl;
+          }
+        }
+      }
+    }
+  }
+
+private:
+
+  constexpr static uint32_t SourceWidth   = 1920;
+  constexpr static uint32_t SourceHeight  = 1080;
+  constexpr static uint32_t WarmupCalls   = 10;
+  constexpr static uint32_t MeasuredCalls = 200;
+
+  HWND                          m_window;
+
+  Com<IDirect3D9Ex>             m_d3d;
+  Com<IDirect3DDevice9Ex>       m_device;
+
+  Com<IDirect3DQuery9>          m_event;
+  Com<IDirect3DQuery9>          m_timestampStart;
+  Com<IDirect3DQuery9>          m_timestampEnd;
+  Com<IDirect3DQuery9>          m_timestampDisjoint;
+  Com<IDirect3DQuery9>          m_timestampFreq;
+
+  /**
+    * \brief Fills a source surface with color bars
+    *
+    * Generates NV12 or YUY2 data and rearranges it for
+    * formats the generator does not produce directly.
+    * YV12 stores a full-pitch Y plane, followed by the V
+    * and U planes at half the pitch.
+    */
+  void fillSurface(IDirect3DSurface9* surface, D3DFORMAT fourcc) {
+    bool isUyvy = fourcc == D3DFORMAT(MAKEFOURCC('U', 'Y', 'V', 'Y'));
+    bool isYv12 = fourcc == D3DFORMAT(MAKEFOURCC('Y', 'V', '1', '2'));
+    bool isPacked = isUyvy || fourcc == D3DFORMAT(MAKEFOURCC('Y', 'U', 'Y', '2'));
+
+    pattern::GenerateArgs args;
+    args.type = pattern::Type::ColorBars;
+    args.format = isPacked ? pattern::Format::YUY2 : pattern::Format::NV12;
+    args.width = SourceWidth;
+    args.height = SourceHeight;
+    args.dstPitch = pattern::getMinPitch(args.format, SourceWidth);
+
+    std::vector<uint8_t> data(pattern::getImageSize(args.format, SourceHeight, args.dstPitch));
+    args.dst = data.data();
+    pattern::generate(args);
+
+    D3DLOCKED_RECT rect = { };
+
+    if (FAILED(surface->LockRect(&rect, nullptr, 0)))
+      throw Error("Failed to lock source surface");
+
+    auto dst = reinterpret_cast<uint8_t*>(rect.pBits);
+    size_t pitch = size_t(rect.Pitch);
+
+    if (isUyvy) {
+      // UYVY swaps luma and chroma bytes within each pair
+      for (uint32_t y = 0; y < SourceHeight; y++) {
+        const uint8_t* srcRow = &data[y * args.dstPitch];
+        uint8_t* dstRow = &dst[y * pitch];
+
+        for (uint32_t x = 0; x < 2 * SourceWidth; x += 2) {
+          dstRow[x + 0] = srcRow[x + 1];
+          dstRow[x + 1] = srcRow[x + 0];
+        }
+      }
+    } else if (isYv12) {
+      for (uint32_t y = 0; y < SourceHeight; y++)
+        std::memcpy(&dst[y * pitch], &data[y * args.dstPitch], SourceWidth);
+
+      const uint8_t* chroma = &data[SourceHeight * args.dstPitch];
+      uint8_t* vPlane = &dst[SourceHeight * pitch];
+      uint8_t* uPlane = &vPlane[(SourceHeight / 2) * (pitch / 2)];
+
+      for (uint32_t y = 0; y < SourceHeight / 2; y++) {
+        for (uint32_t x = 0; x < SourceWidth / 2; x++) {
+          uPlane[y * (pitch / 2) + x] = chroma[y * args.dstPitch + 2 * x + 0];
+          vPlane[y * (pitch / 2) + x] = chroma[y * args.dstPitch + 2 * x + 1];
+        }
+      }
+    } else {
+      size_t rowSize = pattern::getMinPitch(args.format, SourceWidth);
+      size_t rowCount = data.size() / args.dstPitch;
+
+      for (size_t y = 0; y < rowCount; y++)
+        std::memcpy(&dst[y * pitch], &data[y * args.dstPitch], rowSize);
+    }
+
+    surface->UnlockRect();
+  }
+
+  void waitForIdle() {
+    m_event->Issue(D3DISSUE_END);
+
+    while (m_event->GetData(nullptr, 0, D3DGETDATA_FLUSH) == S_FALSE)
+      continue;
+  }
+
+  template<typename T>
+  bool getQueryData(IDirect3DQuery9* query, T& data) {
+    HRESULT status;
+
+    while ((status = query->GetData(&data, sizeof(data), D3DGETDATA_FLUSH)) == S_FALSE)
+      continue;
+
+    return status == S_OK;
+  }
+
+  bool runTest(IDirect3DSurface9* src, IDirect3DSurface9* dst, D3DTEXTUREFILTERTYPE filter,
+      double& callsPerSecond, double& gpuMs) {
+    for (uint32_t i = 0; i < WarmupCalls; i++) {
+      if (FAILED(m_device->StretchRect(src, nullptr, dst, nullptr, filter)))
+        return false;
+    }
+
+    waitForIdle();
+
+    Timer timer;
+
+    for (uint32_t i = 0; i < MeasuredCalls; i++)
+      m_device->StretchRect(src, nullptr, dst, nullptr, filter);
+
+    waitForIdle();
+    callsPerSecond = double(MeasuredCalls) / (timer.ms() / 1000.0);
+
+    gpuMs = 0.0;
+
+    if (m_timestampStart == nullptr)
+      return true;
+
+    // Time the whole batch, since timestamps around a single
+    // call would mostly measure pipeline bubbles
+    m_timestampDisjoint->Issue(D3DISSUE_BEGIN);
+    m_timestampStart->Issue(D3DISSUE_END);
+
+    for (uint32_t i = 0; i < MeasuredCalls; i++)
+      m_device->StretchRect(src, nullptr, dst, nullptr, filter);
+
+    m_timestampEnd->Issue(D3DISSUE_END);
+    m_timestampDisjoint->Issue(D3DISSUE_END);
+    m_timestampFreq->Issue(D3DISSUE_END);
+
+    UINT64 start = 0, end = 0, frequency = 0;
+    BOOL disjoint = TRUE;
+
+    if (getQueryData(m_timestampDisjoint.ptr(), disjoint) && !disjoint
+     && getQueryData(m_timestampStart.ptr(), start)
+     && getQueryData(m_timestampEnd.ptr(), end)
+     && getQueryData(m_timestampFreq.ptr(), frequency) && frequency)
+      gpuMs = 1000.0 * double(end - start) / double(frequency) / double(MeasuredCalls);
+
+    return true;
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  WNDCLASSEXW wc;
+  ZeroMemory(&wc, sizeof(WNDCLASSEX));
+  wc.cbSize = sizeof(WNDCLASSEX);
+  wc.lpfnWndProc = DefWindowProcW;
+  wc.hInstance = hInstance;
+  wc.lpszClassName = L"WindowClass1";
+  RegisterClassExW(&wc);
+
+  // The device needs a window, but nothing is ever presented
+  HWND hWnd = CreateWindowExW(0,
+    L"WindowClass1",
+    L"StretchRect benchmark",
+    WS_OVERLAPPEDWINDOW,
+    0, 0,
+    64, 64,
+    nullptr,
+    nullptr,
+    hInstance,
+    nullptr);
+
+  try {
+    StretchRectApp app(hWnd);
+    app.run();
+    return 0;
+  } catch (const Error& e) {
+    std::cerr << e.message() << std::endl;
+    return 1;
+  }
+}
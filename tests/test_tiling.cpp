@@ -0,0 +1,245 @@
+#include <iostream>
+#include <string>
+
+#include "../common/tiling.h"
+
+// Raw DXGI_FORMAT values, the header does not depend on dxgi
+constexpr uint32_t FormatR32G32B32A32 = 2;
+constexpr uint32_t FormatR32G32B32    = 6;
+constexpr uint32_t FormatR16G16B16A16 = 10;
+constexpr uint32_t FormatR8G8B8A8     = 28;
+constexpr uint32_t FormatR8G8         = 49;
+constexpr uint32_t FormatR8           = 61;
+constexpr uint32_t FormatBC1          = 71;
+constexpr uint32_t FormatBC7          = 98;
+
+class TestTilingApp {
+
+public:
+
+  int run() {
+    testTileShapes();
+    testBuffers();
+    testPackedMips();
+    testArrays();
+    testVolumes();
+    testMultisampled();
+
+    std::cout << (m_testCount - m_failures) << "/" << m_testCount << " tests passed" << std::endl;
+    return m_failures ? 1 : 0;
+  }
+
+private:
+
+  uint32_t m_testCount = 0;
+  uint32_t m_failures  = 0;
+
+  void check(bool success, const std::string& name) {
+    m_testCount += 1;
+
+    if (!success) {
+      std::cerr << "FAILED: " << name << std::endl;
+      m_failures += 1;
+    }
+  }
+
+  static bool isShape(const tiling::TileShape& shape, uint32_t w, uint32_t h, uint32_t d) {
+    return shape.widthInTexels == w
+        && shape.heightInTexels == h
+        && shape.depthInTexels == d;
+  }
+
+  static tiling::ResourceDesc make2D(uint32_t format, uint32_t w, uint32_t h, uint32_t mips, uint32_t layers = 1) {
+    tiling::ResourceDesc desc;
+    desc.dimension = tiling::Dimension::Texture2D;
+    desc.format = format;
+    desc.width = w;
+    desc.height = h;
+    desc.mipLevels = mips;
+    desc.arraySize = layers;
+    return desc;
+  }
+
+  void testTileShapes() {
+    struct ShapeCase {
+      uint32_t format;
+      uint32_t shapes[5][2];
+    };
+
+    // Expected 2D shapes for 1, 2, 4, 8 and 16 samples
+    static const ShapeCase s_cases[] = {
+      { FormatR8,           { { 256, 256 }, { 128, 256 }, { 128, 128 }, {  64, 128 }, {  64,  64 } } },
+      { FormatR8G8,         { { 256, 128 }, { 128, 128 }, { 128,  64 }, {  64,  64 }, {  64,  32 } } },
+      { FormatR8G8B8A8,     { { 128, 128 }, { 128,  64 }, {  64,  64 }, {  64,  32 }, {  32,  32 } } },
+      { FormatR16G16B16A16, { { 128,  64 }, {  64,  64 }, {  64,  32 }, {  32,  32 }, {  32,  16 } } },
+      { FormatR32G32B32A32, { {  64,  64 }, {  64,  32 }, {  32,  32 }, {  32,  16 }, {  16,  16 } } },
+    };
+
+    for (const auto& c : s_cases) {
+      for (uint32_t i = 0; i < 5; i++) {
+        auto shape = tiling::getStandardTileShape(tiling::Dimension::Texture2D, c.format, 1u << i);
+
+        check(isShape(shape, c.shapes[i][0], c.shapes[i][1], 1),
+          "2D shape, format " + std::to_string(c.format) + ", " + std::to_string(1u << i) + " samples");
+      }
+    }
+
+    check(isShape(tiling::getStandardTileShape(tiling::Dimension::Texture3D, FormatR8), 64, 32, 32), "3D shape, 8 bpp");
+    check(isShape(tiling::getStandardTileShape(tiling::Dimension::Texture3D, FormatR8G8B8A8), 32, 32, 16), "3D shape, 32 bpp");
+    check(isShape(tiling::getStandardTileShape(tiling::Dimension::Texture3D, FormatR32G32B32A32), 16, 16, 16), "3D shape, 128 bpp");
+
+    // Block-compressed shapes are scaled by the block size
+    check(isShape(tiling::getStandardTileShape(tiling::Dimension::Texture2D, FormatBC1), 512, 256, 1), "2D shape, BC1");
+    check(isShape(tiling::getStandardTileShape(tiling::Dimension::Texture2D, FormatBC7), 256, 256, 1), "2D shape, BC7");
+
+    // Unsupported formats and sample counts
+    check(isShape(tiling::getStandardTileShape(tiling::Dimension::Texture2D, FormatR32G32B32), 0, 0, 0), "96 bpp unsupported");
+    check(isShape(tiling::getStandardTileShape(tiling::Dimension::Texture2D, FormatR8G8B8A8, 3), 0, 0, 0), "3 samples unsupported");
+    check(isShape(tiling::getStandardTileShape(tiling::Dimension::Texture3D, FormatR8G8B8A8, 4), 0, 0, 0), "3D MSAA unsupported");
+  }
+
+  void testBuffers() {
+    tiling::ResourceDesc desc;
+    desc.dimension = tiling::Dimension::Buffer;
+
+    for (uint32_t size : { 1u, 65536u, 65537u, 100000u, 64u << 20 }) {
+      desc.width = size;
+
+      tiling::ResourceTiling result;
+      bool success = tiling::computeResourceTiling(desc, tiling::Options(), result);
+
+      check(success && result.tileCount == (size + 65535u) / 65536u
+        && result.subresources.size() == 1
+        && result.subresources[0].widthInTiles == result.tileCount,
+        "Buffer, " + std::to_string(size) + " bytes");
+    }
+  }
+
+  void testPackedMips() {
+    tiling::ResourceTiling result;
+
+    // 512x512 RGBA8: 512, 256 and 128 are standard, 64..1 are packed
+    // into 21844 bytes, i.e. a single tile after 16 + 4 + 1 tiles.
+    tiling::computeResourceTiling(make2D(FormatR8G8B8A8, 512, 512, 0), tiling::Options(), result);
+
+    check(result.packedMips.numStandardMips == 3
+       && result.packedMips.numPackedMips == 7
+       && result.packedMips.numTilesForPackedMips == 1
+       && result.packedMips.startTileIndexInOverallResource == 21
+       && result.tileCount == 22, "Packed mips, 512x512 RGBA8");
+
+    check(result.subresources.size() == 10
+       && result.subresources[2].widthInTiles == 1
+       && result.subresources[2].startTileIndexInOverallResource == 20
+       && result.subresources[3].startTileIndexInOverallResource == tiling::PackedTile,
+       "Packed mip subresources, 512x512 RGBA8");
+
+    // Exactly one tile in each dimension is still a standard mip
+    tiling::computeResourceTiling(make2D(FormatR8G8B8A8, 128, 128, 0), tiling::Options(), result);
+
+    check(result.packedMips.numStandardMips == 1
+       && result.packedMips.numPackedMips == 7, "Packed mips, 128x128 RGBA8");
+
+    // One texel short of a tile packs the entire chain
+    tiling::computeResourceTiling(make2D(FormatR8G8B8A8, 127, 128, 0), tiling::Options(), result);
+
+    check(result.packedMips.numStandardMips == 0
+       && result.packedMips.startTileIndexInOverallResource == 0, "Packed mips, 127x128 RGBA8");
+
+    // Extents that are not tile-aligned only get packed with aligned mip sizes
+    tiling::Options aligned;
+    aligned.alignedMipSize = true;
+
+    tiling::computeResourceTiling(make2D(FormatR8G8B8A8, 200, 200, 0), tiling::Options(), result);
+    check(result.packedMips.numStandardMips == 1, "Unaligned mips, 200x200 RGBA8");
+
+    tiling::computeResourceTiling(make2D(FormatR8G8B8A8, 200, 200, 0), aligned, result);
+    check(result.packedMips.numStandardMips == 0, "Aligned mips, 200x200 RGBA8");
+
+    // The packed mip tile count can be overridden
+    tiling::Options fixedTiles;
+    fixedTiles.packedMipTiles = 3;
+
+    tiling::computeResourceTiling(make2D(FormatR8G8B8A8, 512, 512, 0), fixedTiles, result);
+    check(result.packedMips.numTilesForPackedMips == 3 && result.tileCount == 24, "Packed mip tile override");
+
+    // BC1 uses 512x256 texel tiles, so 1024x1024 has two standard mips
+    tiling::computeResourceTiling(make2D(FormatBC1, 1024, 1024, 0), tiling::Options(), result);
+
+    check(result.packedMips.numStandardMips == 2
+       && result.subresources[0].widthInTiles == 2
+       && result.subresources[0].heightInTiles == 4
+       && result.tileCount == 8 + 2 + 1, "Packed mips, 1024x1024 BC1");
+
+    // No packed mips without a mip chain that gets small enough
+    tiling::computeResourceTiling(make2D(FormatR8G8B8A8, 1024, 512, 2), tiling::Options(), result);
+
+    check(result.packedMips.numPackedMips == 0
+       && result.packedMips.numTilesForPackedMips == 0
+       && result.tileCount == 32 + 8, "No packed mips, 1024x512 RGBA8");
+  }
+
+  void testArrays() {
+    tiling::ResourceTiling result;
+
+    // Each layer stores its standard mips followed by its packed mips
+    tiling::computeResourceTiling(make2D(FormatR8G8B8A8, 256, 256, 0, 2), tiling::Options(), result);
+
+    check(result.packedMips.numStandardMips == 2
+       && result.packedMips.startTileIndexInOverallResource == 5
+       && result.subresources.size() == 18
+       && result.subresources[9].startTileIndexInOverallResource == 6
+       && result.subresources[10].startTileIndexInOverallResource == 10
+       && result.tileCount == 12, "Array, 256x256x2 RGBA8");
+  }
+
+  void testVolumes() {
+    tiling::ResourceDesc desc;
+    desc.dimension = tiling::Dimension::Texture3D;
+    desc.format = FormatR8G8B8A8;
+    desc.width = 64;
+    desc.height = 64;
+    desc.depth = 32;
+    desc.mipLevels = 0;
+
+    tiling::ResourceTiling result;
+    tiling::computeResourceTiling(desc, tiling::Options(), result);
+
+    // 32x32x16 tiles: 2x2x2, then 1x1x1, then 16x16x8 is packed
+    check(result.packedMips.numStandardMips == 2
+       && result.subresources[0].depthInTiles == 2
+       && result.subresources[1].startTileIndexInOverallResource == 8
+       && result.packedMips.startTileIndexInOverallResource == 9
+       && result.tileCount == 10, "Volume, 64x64x32 RGBA8");
+  }
+
+  void testMultisampled() {
+    tiling::ResourceTiling result;
+
+    auto desc = make2D(FormatR8G8B8A8, 256, 256, 1);
+    desc.sampleCount = 4;
+
+    tiling::computeResourceTiling(desc, tiling::Options(), result);
+
+    check(result.tileShape.widthInTexels == 64
+       && result.tileShape.heightInTexels == 64
+       && result.packedMips.numStandardMips == 1
+       && result.tileCount == 16, "MSAA 4x, 256x256 RGBA8");
+
+    // Too small for a single 8x tile, so the only mip is packed
+    desc = make2D(FormatR8G8B8A8, 32, 32, 1);
+    desc.sampleCount = 8;
+
+    tiling::computeResourceTiling(desc, tiling::Options(), result);
+
+    check(result.packedMips.numStandardMips == 0
+       && result.packedMips.numPackedMips == 1
+       && result.packedMips.numTilesForPackedMips == 1, "MSAA 8x, 32x32 RGBA8");
+  }
+
+};
+
+int main() {
+  TestTilingApp app;
+  return app.run();
+}
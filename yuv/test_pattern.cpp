@@ -0,0 +1,185 @@
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../common/test_pattern.h"
+
+#include "yuv_test.h"
+
+static const std::array<const char*, 4> s_typeNames   = {{ "bars", "gradient", "zoneplate", "noise" }};
+static const std::array<const char*, 5> s_formatNames = {{ "RGBA", "BGRA", "NV12", "YUY2", "P010" }};
+
+class TestPatternApp {
+
+public:
+
+  int run(bool benchmark) {
+    if (benchmark) {
+      runBenchmark();
+      return 0;
+    }
+
+    return runTests() ? 0 : 1;
+  }
+
+private:
+
+  constexpr static uint32_t BenchWidth  = 7680;
+  constexpr static uint32_t BenchHeight = 4320;
+
+  static std::vector<uint8_t> generateImage(pattern::Type type, pattern::Format format,
+      uint32_t width, uint32_t height, yuv::Kernel kernel, uint32_t threadCount, size_t& pitch) {
+    pitch = pattern::getMinPitch(format, width) + 32;
+
+    std::vector<uint8_t> result(pattern::getImageSize(format, height, pitch), 0xCD);
+
+    pattern::GenerateArgs args;
+    args.type = type;
+    args.format = format;
+    args.width = width;
+    args.height = height;
+    args.seed = 17;
+    args.dst = result.data();
+    args.dstPitch = pitch;
+    args.kernel = kernel;
+    args.threadCount = threadCount;
+
+    pattern::generate(args);
+    return result;
+  }
+
+  static bool compareOutputs(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b,
+      pattern::Format format, uint32_t width, uint32_t height, size_t pitch) {
+    return yuvtest::compareRows(a, b, pattern::getMinPitch(format, width),
+      pattern::getImageSize(format, height, pitch) / pitch, pitch);
+  }
+
+  /**
+    * \brief Checks YUV output against a single conversion
+    *
+    * YUV images are converted in batches of rows, so this
+    * verifies that batch and thread boundaries do not show
+    * up in the chroma plane.
+    */
+  static bool checkConversion(const std::vector<uint8_t>& rgba, size_t rgbaPitch,
+      const std::vector<uint8_t>& data, pattern::Format format, uint32_t width, uint32_t height, size_t pitch) {
+    std::vector<uint8_t> expected(data.size(), 0xCD);
+
+    yuv::ConvertArgs args;
+    args.format = pattern::getYuvFormat(format);
+    args.matrix = yuv::Matrix::BT709;
+    args.range = yuv::Range::Limited;
+    args.width = width;
+    args.height = height;
+    args.src = rgba.data();
+    args.srcPitch = rgbaPitch;
+    args.dst = expected.data();
+    args.dstPitch = pitch;
+    args.kernel = yuv::Kernel::Scalar;
+    args.threadCount = 1;
+
+    yuv::convert(args);
+    return compareOutputs(expected, data, format, width, height, pitch);
+  }
+
+  bool runTests() {
+    auto kernels = yuvtest::getSupportedKernels();
+
+    uint32_t failures = 0;
+    uint32_t testCount = 0;
+
+    // Known values, so that changes to the patterns do not go unnoticed
+    if (pattern::hash(0u) != 0u || pattern::hash(1u) != 0x688990c0u) {
+      std::cerr << "FAILED: noise hash" << std::endl;
+      failures += 1;
+    }
+
+    testCount += 1;
+
+    for (auto size : yuvtest::TestSizes) {
+      for (uint32_t t = 0; t < s_typeNames.size(); t++) {
+        auto type = pattern::Type(t);
+
+        size_t rgbaPitch = 0;
+        auto rgba = generateImage(type, pattern::Format::RGBA, size.first, size.second,
+          yuv::Kernel::Scalar, 1, rgbaPitch);
+
+        for (uint32_t f = 0; f < s_formatNames.size(); f++) {
+          auto format = pattern::Format(f);
+
+          size_t pitch = 0;
+          auto reference = generateImage(type, format, size.first, size.second, yuv::Kernel::Scalar, 1, pitch);
+
+          bool success = true;
+
+          if (pattern::isYuv(format))
+            success = checkConversion(rgba, rgbaPitch, reference, format, size.first, size.second, pitch);
+
+          // SIMD kernels and threading must not change the result
+          for (auto kernel : kernels) {
+            for (uint32_t threads : { 1u, 3u, 8u }) {
+              auto result = generateImage(type, format, size.first, size.second, kernel, threads, pitch);
+
+              if (!compareOutputs(reference, result, format, size.first, size.second, pitch)) {
+                std::cerr << "  Kernel " << yuvtest::getKernelName(kernel)
+                          << ", " << threads << " thread(s)" << std::endl;
+                success = false;
+              }
+            }
+          }
+
+          testCount += 1;
+
+          if (!success) {
+            std::cerr << "FAILED: " << s_typeNames[t] << " " << s_formatNames[f] << " "
+                      << size.first << "x" << size.second << std::endl;
+            failures += 1;
+          }
+        }
+      }
+    }
+
+    std::cout << (testCount - failures) << "/" << testCount << " tests passed" << std::endl;
+    return !failures;
+  }
+
+  void runBenchmark() {
+    std::cout << BenchWidth << "x" << BenchHeight << ", "
+              << Thread::hardwareConcurrency() << " hardware threads" << std::endl;
+
+    yuvtest::BenchmarkTable table({ { "Pattern", 11 }, { "Format", 8 } }, uint64_t(BenchWidth) * BenchHeight);
+    table.printHeader();
+
+    for (uint32_t t = 0; t < s_typeNames.size(); t++) {
+      for (uint32_t f = 0; f < s_formatNames.size(); f++) {
+        for (uint32_t threads : yuvtest::getBenchmarkThreadCounts()) {
+          auto format = pattern::Format(f);
+          size_t pitch = pattern::getMinPitch(format, BenchWidth);
+
+          std::vector<uint8_t> dst(pattern::getImageSize(format, BenchHeight, pitch));
+
+          pattern::GenerateArgs args;
+          args.type = pattern::Type(t);
+          args.format = format;
+          args.width = BenchWidth;
+          args.height = BenchHeight;
+          args.dst = dst.data();
+          args.dstPitch = pitch;
+          args.threadCount = threads;
+
+          table.measure({ s_typeNames[t], s_formatNames[f] }, threads, 5,
+            [&args] { pattern::generate(args); });
+        }
+      }
+    }
+  }
+
+};
+
+int main(int argc, char** argv) {
+  bool benchmark = argc > 1 && std::string(argv[1]) == "bench";
+
+  TestPatternApp app;
+  return app.run(benchmark);
+}
@@ -0,0 +1,306 @@
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../common/yuv_convert.h"
+
+#include "yuv_test.h"
+
+struct TestImage {
+  uint32_t             width;
+  uint32_t             height;
+  size_t               pitch;
+  std::vector<uint8_t> data;
+};
+
+static const std::array<const char*, 4> s_formatNames = {{ "NV12", "YUY2", "P010", "AYUV" }};
+static const std::array<const char*, 3> s_matrixNames = {{ "BT.601", "BT.709", "BT.2020" }};
+static const std::array<const char*, 2> s_rangeNames  = {{ "full", "limited" }};
+
+class YuvConvertApp {
+
+public:
+
+  int run(bool benchmark) {
+    if (benchmark) {
+      runBenchmark();
+      return 0;
+    }
+
+    return runTests() ? 0 : 1;
+  }
+
+private:
+
+  constexpr static uint32_t BenchWidth  = 3840;
+  constexpr static uint32_t BenchHeight = 2160;
+
+  static TestImage createImage(uint32_t width, uint32_t height, uint32_t seed) {
+    TestImage image;
+    image.width = width;
+    image.height = height;
+    image.pitch = 4 * width + 12;
+    image.data.resize(image.pitch * height);
+
+    // Mix random noise with saturated colors so that
+    // clamping at both ends of the range is covered
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        uint8_t* pixel = &image.data[y * image.pitch + 4 * x];
+
+        for (uint32_t c = 0; c < 4; c++) {
+          seed = seed * 1664525u + 1013904223u;
+          pixel[c] = uint8_t(seed >> 24);
+
+          if ((x + y) % 7 == 0)
+            pixel[c] = (seed >> 8) & 1 ? 0xFF : 0x00;
+        }
+      }
+    }
+
+    return image;
+  }
+
+  static std::vector<uint8_t> convertImage(const TestImage& image, yuv::Format format,
+      yuv::Matrix matrix, yuv::Range range, yuv::RgbOrder order, yuv::Kernel kernel, uint32_t threadCount,
+      size_t& dstPitch) {
+    dstPitch = yuv::getMinPitch(format, image.width) + 32;
+
+    std::vector<uint8_t> result(yuv::getImageSize(format, image.height, dstPitch), 0xCD);
+
+    yuv::ConvertArgs args;
+    args.format = format;
+    args.matrix = matrix;
+    args.range = range;
+    args.rgbOrder = order;
+    args.width = image.width;
+    args.height = image.height;
+    args.src = image.data.data();
+    args.srcPitch = image.pitch;
+    args.dst = result.data();
+    args.dstPitch = dstPitch;
+    args.kernel = kernel;
+    args.threadCount = threadCount;
+
+    yuv::convert(args);
+    return result;
+  }
+
+  /**
+    * \brief Floating point reference
+    *
+    * Computes the expected output for a single value. Chroma
+    * is the average of all pixels in the block, with edge
+    * pixels replicated for odd image dimensions.
+    */
+  static int32_t referenceValue(const TestImage& image, yuv::Format format,
+      yuv::Matrix matrix, yuv::Range range, yuv::RgbOrder order,
+      uint32_t x, uint32_t y, uint32_t component) {
+    float k[3][4];
+    yuv::getFactors(matrix, range, yuv::getBitDepth(format), k[0], k[1], k[2]);
+
+    uint32_t bw = component && yuv::isSubsampledX(format) ? 2 : 1;
+    uint32_t bh = component && yuv::isSubsampledY(format) ? 2 : 1;
+
+    float rgb[3] = { };
+
+    for (uint32_t j = 0; j < bh; j++) {
+      for (uint32_t i = 0; i < bw; i++) {
+        uint32_t px = std::min(x * bw + i, image.width - 1);
+        uint32_t py = std::min(y * bh + j, image.height - 1);
+
+        const uint8_t* pixel = &image.data[py * image.pitch + 4 * px];
+
+        rgb[0] += pixel[order == yuv::RgbOrder::RGBA ? 0 : 2];
+        rgb[1] += pixel[1];
+        rgb[2] += pixel[order == yuv::RgbOrder::RGBA ? 2 : 0];
+      }
+    }
+
+    const float* c = k[component];
+    float n = float(bw * bh);
+    float value = (c[0] * rgb[0] + c[1] * rgb[1] + c[2] * rgb[2]) / n + c[3];
+
+    int32_t maxValue = (1 << yuv::getBitDepth(format)) - 1;
+    return std::clamp(int32_t(std::floor(value + 0.5f)), 0, maxValue);
+  }
+
+  /**
+    * \brief Reads back a converted value
+    *
+    * Component 0 is Y, 1 is U and 2 is V. Returns -1 if the
+    * value does not exist at the given coordinates.
+    */
+  static int32_t readValue(const std::vector<uint8_t>& data, yuv::Format format,
+      uint32_t height, size_t pitch, uint32_t x, uint32_t y, uint32_t component) {
+    switch (format) {
+      case yuv::Format::NV12:
+        return component
+          ? data[pitch * height + y * pitch + 2 * x + component - 1]
+          : data[y * pitch + x];
+
+      case yuv::Format::P010: {
+        uint16_t value;
+        size_t offset = component
+          ? pitch * height + y * pitch + 2 * (2 * x + component - 1)
+          : y * pitch + 2 * x;
+
+        std::memcpy(&value, &data[offset], sizeof(value));
+        return (value & 0x3F) ? -1 : (value >> 6);
+      }
+
+      case yuv::Format::YUY2:
+        return component
+          ? data[y * pitch + 4 * x + (component == 1 ? 1 : 3)]
+          : data[y * pitch + 2 * x];
+
+      case yuv::Format::AYUV:
+        return data[y * pitch + 4 * x + (component ? 2 - component : 2)];
+    }
+
+    return -1;
+  }
+
+  static bool checkReference(const TestImage& image, const std::vector<uint8_t>& data, size_t pitch,
+      yuv::Format format, yuv::Matrix matrix, yuv::Range range, yuv::RgbOrder order) {
+    uint32_t chromaW = yuv::isSubsampledX(format) ? (image.width + 1) / 2 : image.width;
+    uint32_t chromaH = yuv::isSubsampledY(format) ? (image.height + 1) / 2 : image.height;
+
+    for (uint32_t c = 0; c < 3; c++) {
+      uint32_t w = c ? chromaW : image.width;
+      uint32_t h = c ? chromaH : image.height;
+
+      for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+          int32_t expected = referenceValue(image, format, matrix, range, order, x, y, c);
+          int32_t actual = readValue(data, format, image.height, pitch, x, y, c);
+
+          if (actual < 0 || std::abs(actual - expected) > 1) {
+            std::cerr << "  Mismatch at (" << x << "," << y << "), component " << c
+                      << ": expected " << expected << ", got " << actual << std::endl;
+            return false;
+          }
+        }
+      }
+    }
+
+    if (format == yuv::Format::AYUV) {
+      for (uint32_t y = 0; y < image.height; y++) {
+        for (uint32_t x = 0; x < image.width; x++) {
+          if (data[y * pitch + 4 * x + 3] != 0xFF) {
+            std::cerr << "  Alpha not opaque at (" << x << "," << y << ")" << std::endl;
+            return false;
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+  static bool compareOutputs(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b,
+      yuv::Format format, uint32_t width, uint32_t height, size_t pitch) {
+    return yuvtest::compareRows(a, b, yuv::getMinPitch(format, width),
+      yuv::getImageSize(format, height, pitch) / pitch, pitch);
+  }
+
+  bool runTests() {
+    auto kernels = yuvtest::getSupportedKernels();
+
+    uint32_t failures = 0;
+    uint32_t testCount = 0;
+
+    for (auto size : yuvtest::TestSizes) {
+      TestImage image = createImage(size.first, size.second, size.first * 31 + size.second);
+
+      for (uint32_t f = 0; f < s_formatNames.size(); f++) {
+        for (uint32_t m = 0; m < s_matrixNames.size(); m++) {
+          for (uint32_t r = 0; r < s_rangeNames.size(); r++) {
+            for (auto order : { yuv::RgbOrder::RGBA, yuv::RgbOrder::BGRA }) {
+              auto yuvFormat = yuv::Format(f);
+              auto matrix = yuv::Matrix(m);
+              auto range = yuv::Range(r);
+
+              size_t pitch = 0;
+              auto reference = convertImage(image, yuvFormat, matrix, range, order, yuv::Kernel::Scalar, 1, pitch);
+
+              bool success = checkReference(image, reference, pitch, yuvFormat, matrix, range, order);
+
+              // SIMD kernels and threading must not change the result
+              for (auto kernel : kernels) {
+                for (uint32_t threads : { 1u, 4u }) {
+                  auto result = convertImage(image, yuvFormat, matrix, range, order, kernel, threads, pitch);
+
+                  if (!compareOutputs(reference, result, yuvFormat, image.width, image.height, pitch)) {
+                    std::cerr << "  Kernel " << yuvtest::getKernelName(kernel)
+                              << ", " << threads << " thread(s)" << std::endl;
+                    success = false;
+                  }
+                }
+              }
+
+              testCount += 1;
+
+              if (!success) {
+                std::cerr << "FAILED: " << s_formatNames[f] << " " << s_matrixNames[m] << " " << s_rangeNames[r]
+                          << (order == yuv::RgbOrder::RGBA ? " RGBA " : " BGRA ")
+                          << size.first << "x" << size.second << std::endl;
+                failures += 1;
+              }
+            }
+          }
+        }
+      }
+    }
+
+    std::cout << (testCount - failures) << "/" << testCount << " tests passed" << std::endl;
+    return !failures;
+  }
+
+  void runBenchmark() {
+    TestImage image = createImage(BenchWidth, BenchHeight, 1);
+
+    std::cout << BenchWidth << "x" << BenchHeight << ", BT.709 limited, "
+              << Thread::hardwareConcurrency() << " hardware threads" << std::endl;
+
+    yuvtest::BenchmarkTable table({ { "Format", 8 }, { "Kernel", 10 } }, uint64_t(BenchWidth) * BenchHeight);
+    table.printHeader();
+
+    for (uint32_t f = 0; f < s_formatNames.size(); f++) {
+      for (auto kernel : yuvtest::getSupportedKernels()) {
+        for (uint32_t threads : yuvtest::getBenchmarkThreadCounts()) {
+          auto yuvFormat = yuv::Format(f);
+          size_t pitch = yuv::getMinPitch(yuvFormat, BenchWidth);
+
+          std::vector<uint8_t> dst(yuv::getImageSize(yuvFormat, BenchHeight, pitch));
+
+          yuv::ConvertArgs args;
+          args.format = yuvFormat;
+          args.matrix = yuv::Matrix::BT709;
+          args.range = yuv::Range::Limited;
+          args.width = BenchWidth;
+          args.height = BenchHeight;
+          args.src = image.data.data();
+          args.srcPitch = image.pitch;
+          args.dst = dst.data();
+          args.dstPitch = pitch;
+          args.kernel = kernel;
+          args.threadCount = threads;
+
+          table.measure({ s_formatNames[f], yuvtest::getKernelName(kernel) }, threads, 10,
+            [&args] { yuv::convert(args); });
+        }
+      }
+    }
+  }
+
+};
+
+int main(int argc, char** argv) {
+  bool benchmark = argc > 1 && std::string(argv[1]) == "bench";
+
+  YuvConvertApp app;
+  return app.run(benchmark);
+}
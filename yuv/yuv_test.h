@@ -0,0 +1,160 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "../common/thread.h"
+#include "../common/timer.h"
+#include "../common/yuv_convert.h"
+
+namespace yuvtest {
+
+/// Image sizes used for correctness tests. Odd sizes cover
+/// partial SIMD vectors and chroma subsampling edge cases.
+constexpr std::array<std::pair<uint32_t, uint32_t>, 5> TestSizes = {{
+  { 1, 1 }, { 2, 2 }, { 37, 19 }, { 128, 128 }, { 333, 270 },
+}};
+
+
+inline const char* getKernelName(yuv::Kernel kernel) {
+  static const std::array<const char*, 4> s_kernelNames = {{ "scalar", "SSE2", "AVX2", "auto" }};
+  return s_kernelNames[uint32_t(kernel)];
+}
+
+
+/**
+  * \brief Queries kernels supported by the host
+  *
+  * Always includes the scalar kernel, which is
+  * used as the reference for all others.
+  * \returns Supported kernels, scalar first
+  */
+inline std::vector<yuv::Kernel> getSupportedKernels() {
+  std::vector<yuv::Kernel> kernels = { yuv::Kernel::Scalar };
+
+#if YUV_HAS_X86
+  kernels.push_back(yuv::Kernel::SSE2);
+
+  if (yuv::isAvx2Supported())
+    kernels.push_back(yuv::Kernel::AVX2);
+#endif
+
+  return kernels;
+}
+
+
+/**
+  * \brief Compares two pitched images
+  *
+  * Only compares the first \c rowSize bytes of each
+  * row, so that padding does not affect the result.
+  * \param [in] a First image
+  * \param [in] b Second image
+  * \param [in] rowSize Bytes per row to compare
+  * \param [in] rowCount Number of rows, over all planes
+  * \param [in] pitch Row pitch of both images
+  * \returns \c true if all rows are equal
+  */
+inline bool compareRows(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b,
+    size_t rowSize, size_t rowCount, size_t pitch) {
+  for (size_t y = 0; y < rowCount; y++) {
+    if (std::memcmp(&a[y * pitch], &b[y * pitch], rowSize)) {
+      std::cerr << "  Output differs in row " << y << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+/**
+  * \brief Thread counts to benchmark
+  * \returns One thread and, if different, all hardware threads
+  */
+inline std::vector<uint32_t> getBenchmarkThreadCounts() {
+  uint32_t maxThreads = Thread::hardwareConcurrency();
+
+  if (maxThreads == 1)
+    return { 1u };
+
+  return { 1u, maxThreads };
+}
+
+
+/**
+  * \brief Benchmark result table
+  *
+  * Prints one row per measured configuration, with the
+  * median frame time and resulting pixel throughput.
+  */
+class BenchmarkTable {
+
+public:
+
+  struct Column {
+    const char* name;
+    int         width;
+  };
+
+  BenchmarkTable(std::vector<Column> labels, uint64_t pixelCount)
+  : m_labels(std::move(labels)), m_pixelCount(pixelCount) { }
+
+  void printHeader() const {
+    std::cout << std::left;
+
+    for (const auto& label : m_labels)
+      std::cout << std::setw(label.width) << label.name;
+
+    std::cout << std::setw(10) << "Threads" << std::right << std::setw(12) << "ms/frame"
+              << std::setw(12) << "MPix/s" << std::endl;
+  }
+
+  /**
+    * \brief Measures and prints one configuration
+    *
+    * Runs the workload once to fault in destination
+    * pages, then reports the median of the given
+    * number of timed runs.
+    * \param [in] labels Label column values
+    * \param [in] threads Thread count
+    * \param [in] iterations Number of timed runs
+    * \param [in] run Workload to measure
+    */
+  template<typename Fn>
+  void measure(const std::vector<const char*>& labels, uint32_t threads, uint32_t iterations, const Fn& run) const {
+    run();
+
+    Stats stats;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+      Timer timer;
+      run();
+      stats.add(timer.ms());
+    }
+
+    double ms = stats.percentile(50.0);
+
+    std::cout << std::left;
+
+    for (size_t i = 0; i < labels.size(); i++)
+      std::cout << std::setw(m_labels[i].width) << labels[i];
+
+    std::cout << std::setw(10) << threads << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << ms << std::setprecision(1)
+              << std::setw(12) << double(m_pixelCount) / (ms * 1000.0)
+              << std::defaultfloat << std::endl;
+  }
+
+private:
+
+  std::vector<Column> m_labels;
+  uint64_t            m_pixelCount;
+
+};
+
+}